@@ -69,6 +69,7 @@ case "$1" in # note use of ;;& meaning that each case is re-tested (can hit mult
         git -C "$LW_SRC/kernel" am < "$LW_ROOT/patches/kernel/0010-Add-Wasm-console-support.patch"
         git -C "$LW_SRC/kernel" am < "$LW_ROOT/patches/kernel/0011-Add-wasm_defconfig.patch"
         git -C "$LW_SRC/kernel" am < "$LW_ROOT/patches/kernel/0012-HACK-Workaround-broken-wq_worker_comm.patch"
+        git -C "$LW_SRC/kernel" am < "$LW_ROOT/patches/kernel/0013-Add-interrupt-driven-Wasm-console-input.patch"
     handled=1;;&
 
     "fetch-musl"|"all-musl"|"fetch"|"all")
@@ -312,6 +313,42 @@ case "$1" in # note use of ;;& meaning that each case is re-tested (can hit mult
             fi
         fi
         
+        # Compile example-stream.c
+        if [ -f "$LW_ROOT/runtime/examples/example-stream.c" ]; then
+            "$LW_INSTALL/llvm/bin/clang" \
+                --target=wasm32-unknown-unknown \
+                "--sysroot=$LW_INSTALL/musl" \
+                -fPIC -shared \
+                $LW_DEBUG_CFLAGS \
+                -o "$LW_INSTALL/graphics-examples/example-stream.wasm" \
+                "$LW_ROOT/runtime/examples/example-stream.c"
+            echo "Built example-stream.wasm"
+            
+            # Copy to busybox for inclusion in initramfs (if busybox is built)
+            if [ -d "$LW_INSTALL/busybox/bin" ]; then
+                cp "$LW_INSTALL/graphics-examples/example-stream.wasm" "$LW_INSTALL/busybox/bin/"
+                echo "Copied example-stream.wasm to busybox/bin/"
+            fi
+        fi
+        
+        # Compile example-fbo.c
+        if [ -f "$LW_ROOT/runtime/examples/example-fbo.c" ]; then
+            "$LW_INSTALL/llvm/bin/clang" \
+                --target=wasm32-unknown-unknown \
+                "--sysroot=$LW_INSTALL/musl" \
+                -fPIC -shared \
+                $LW_DEBUG_CFLAGS \
+                -o "$LW_INSTALL/graphics-examples/example-fbo.wasm" \
+                "$LW_ROOT/runtime/examples/example-fbo.c"
+            echo "Built example-fbo.wasm"
+            
+            # Copy to busybox for inclusion in initramfs (if busybox is built)
+            if [ -d "$LW_INSTALL/busybox/bin" ]; then
+                cp "$LW_INSTALL/graphics-examples/example-fbo.wasm" "$LW_INSTALL/busybox/bin/"
+                echo "Copied example-fbo.wasm to busybox/bin/"
+            fi
+        fi
+        
         # Copy graphics header for reference
         cp "$LW_ROOT/runtime/wasm-graphics.h" "$LW_INSTALL/graphics-examples/"
         echo "Graphics examples built successfully!"
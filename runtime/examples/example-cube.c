@@ -9,12 +9,13 @@
 //   $LW_INSTALL/llvm/bin/clang --target=wasm32-unknown-unknown \
 //     --sysroot=$LW_INSTALL/musl -fPIC -shared \
 //     -o example-cube.wasm example-cube.c
+//
+// Run with --capture [frames] to record the first frames (120 by default) to example-cube.gltrace for gl-replay.html.
 
 #include "../wasm-graphics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 #include <math.h>
 
 // Vertex shader with MVP matrices
@@ -52,13 +53,14 @@ static void mat4_identity(mat4 m) {
     m[0] = m[5] = m[10] = m[15] = 1.0f;
 }
 
+// result = a * b, with matrices stored column by column as GL expects them
 static void mat4_multiply(mat4 result, const mat4 a, const mat4 b) {
     mat4 temp;
     for (int i = 0; i < 4; i++) {
         for (int j = 0; j < 4; j++) {
             temp[i * 4 + j] = 0.0f;
             for (int k = 0; k < 4; k++) {
-                temp[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+                temp[i * 4 + j] += a[k * 4 + j] * b[i * 4 + k];
             }
         }
     }
@@ -110,19 +112,10 @@ static GLuint compile_shader(GLenum type, const char* source) {
     
     glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
-    
-    GLint compiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        GLchar log[512];
-        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
-        fprintf(stderr, "Shader error: %s\n", log);
-        return 0;
-    }
     return shader;
 }
 
-static GLuint link_program(GLuint vs, GLuint fs) {
+static GLuint link_program(EGLDisplay display, EGLSurface surface, GLuint vs, GLuint fs) {
     GLuint program = glCreateProgram();
     if (program == 0) return 0;
     
@@ -130,12 +123,23 @@ static GLuint link_program(GLuint vs, GLuint fs) {
     glAttachShader(program, fs);
     glLinkProgram(program);
     
+    // Compiles and links run in the background: keep presenting frames until the program is ready, rather than
+    // stalling in glGetShaderiv(GL_COMPILE_STATUS). Compile errors show up as a failed link.
+    while (!wasm_gl_program_ready(program)) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        eglSwapBuffers(display, surface);
+    }
+
     GLint linked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
     if (!linked) {
         GLchar log[512];
         glGetProgramInfoLog(program, sizeof(log), NULL, log);
         fprintf(stderr, "Link error: %s\n", log);
+        glGetShaderInfoLog(vs, sizeof(log), NULL, log);
+        fprintf(stderr, "Vertex shader: %s\n", log);
+        glGetShaderInfoLog(fs, sizeof(log), NULL, log);
+        fprintf(stderr, "Fragment shader: %s\n", log);
         return 0;
     }
     return program;
@@ -166,7 +170,19 @@ static void create_cube_texture(GLubyte* data, int size) {
     }
 }
 
-int main(void) {
+// Frames to record with --capture (0 = no capture)
+static int capture_frames = 0;
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--capture") == 0) {
+            capture_frames = 120;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                capture_frames = atoi(argv[++i]);
+            }
+        }
+    }
+
     EGLDisplay display;
     EGLSurface surface;
     EGLContext context;
@@ -176,6 +192,9 @@ int main(void) {
     
     // Initialize graphics
     printf("Initializing graphics...\n");
+    if (capture_frames > 0) {
+        wasm_gl_capture_begin();
+    }
     if (graphics_initialize(&display, &surface, &context) != 0) {
         fprintf(stderr, "Failed to initialize graphics\n");
         return 1;
@@ -193,7 +212,7 @@ int main(void) {
     printf("✓ Compiling shaders...\n");
     GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
     GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
-    GLuint program = link_program(vs, fs);
+    GLuint program = link_program(display, surface, vs, fs);
     if (program == 0) return 1;
     
     // Get locations
@@ -348,6 +367,9 @@ int main(void) {
         
         // Present
         eglSwapBuffers(display, surface);
+        if (frame + 1 == capture_frames && wasm_gl_capture_end("example-cube.gltrace")) {
+            printf("Captured %d frames to example-cube.gltrace\n", capture_frames);
+        }
         
         // Update rotation
         rotation += 0.02f;
@@ -356,8 +378,6 @@ int main(void) {
         if (frame % 60 == 0) {
             printf("  Frame %d (rotation: %.1f°)\n", frame, rotation * 180.0f / 3.14159f);
         }
-        
-        usleep(16667);  // ~60 FPS
     }
     
     printf("\n✅ Demo complete! Spinning cube rendered successfully.\n");
@@ -9,12 +9,15 @@
 //   $LW_INSTALL/llvm/bin/clang --target=wasm32-unknown-unknown \
 //     --sysroot=$LW_INSTALL/musl -fPIC -shared \
 //     -o example-demo.wasm example-demo.c
+//
+// Run with --instanced [count] to draw a grid of cubes with one instanced draw call per frame instead.
+// Run with --no-shadowing to send redundant GL state changes to the host anyway (to compare the GL call counts).
+// Run with --capture [frames] to record the first frames (300 by default) to example-demo.gltrace for gl-replay.html.
 
 #include "../wasm-graphics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 #include <math.h>
 #include <time.h>
 
@@ -46,6 +49,40 @@ const char* fragment_shader_source =
     "  gl_FragColor = vec4(tinted * v_lighting, tex_color.a);\n"
     "}\n";
 
+// Instanced variant: the model matrix and tint come from per-instance attributes instead of uniforms
+const char* instanced_vertex_shader_source =
+    "attribute vec3 position;\n"
+    "attribute vec2 texcoord;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec4 i_model0;\n"
+    "attribute vec4 i_model1;\n"
+    "attribute vec4 i_model2;\n"
+    "attribute vec4 i_model3;\n"
+    "attribute vec3 i_tint;\n"
+    "varying vec2 v_texcoord;\n"
+    "varying float v_lighting;\n"
+    "varying vec3 v_tint;\n"
+    "uniform mat4 u_view_projection;\n"
+    "uniform vec3 u_light_dir;\n"
+    "void main() {\n"
+    "  mat4 model = mat4(i_model0, i_model1, i_model2, i_model3);\n"
+    "  gl_Position = u_view_projection * model * vec4(position, 1.0);\n"
+    "  v_texcoord = texcoord;\n"
+    "  v_lighting = max(dot(normal, u_light_dir), 0.3);\n"
+    "  v_tint = i_tint;\n"
+    "}\n";
+
+const char* instanced_fragment_shader_source =
+    "precision mediump float;\n"
+    "varying vec2 v_texcoord;\n"
+    "varying float v_lighting;\n"
+    "varying vec3 v_tint;\n"
+    "uniform sampler2D u_texture;\n"
+    "void main() {\n"
+    "  vec4 tex_color = texture2D(u_texture, v_texcoord);\n"
+    "  gl_FragColor = vec4(tex_color.rgb * v_tint * v_lighting, tex_color.a);\n"
+    "}\n";
+
 // Matrix math
 typedef float mat4[16];
 typedef float vec3[3];
@@ -55,13 +92,14 @@ static void mat4_identity(mat4 m) {
     m[0] = m[5] = m[10] = m[15] = 1.0f;
 }
 
+// Column-major (column i starts at [i * 4]), so that a * b applies b first
 static void mat4_multiply(mat4 result, const mat4 a, const mat4 b) {
     mat4 temp;
     for (int i = 0; i < 4; i++) {
         for (int j = 0; j < 4; j++) {
             temp[i * 4 + j] = 0.0f;
             for (int k = 0; k < 4; k++) {
-                temp[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+                temp[i * 4 + j] += a[k * 4 + j] * b[i * 4 + k];
             }
         }
     }
@@ -113,6 +151,14 @@ static void mat4_scale(mat4 m, float x, float y, float z) {
     m[10] = z;
 }
 
+// View from a camera circling the origin at distance (and bobbing up and down), turned to keep facing it
+static void mat4_orbit_view(mat4 m, float angle, float distance) {
+    mat4 yaw, position;
+    mat4_rotate_y(yaw, -angle);
+    mat4_translate(position, -sinf(angle) * distance, -sinf(angle * 0.5f) * 2.0f, -cosf(angle) * distance);
+    mat4_multiply(m, yaw, position);
+}
+
 // Shader helpers
 static GLuint compile_shader(GLenum type, const char* source) {
     GLuint shader = glCreateShader(type);
@@ -120,19 +166,10 @@ static GLuint compile_shader(GLenum type, const char* source) {
     
     glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
-    
-    GLint compiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        GLchar log[512];
-        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
-        fprintf(stderr, "Shader error: %s\n", log);
-        return 0;
-    }
     return shader;
 }
 
-static GLuint link_program(GLuint vs, GLuint fs) {
+static GLuint link_program(EGLDisplay display, EGLSurface surface, GLuint vs, GLuint fs) {
     GLuint program = glCreateProgram();
     if (program == 0) return 0;
     
@@ -140,12 +177,22 @@ static GLuint link_program(GLuint vs, GLuint fs) {
     glAttachShader(program, fs);
     glLinkProgram(program);
     
+    // Keep the display going while the program compiles and links in the background.
+    while (!wasm_gl_program_ready(program)) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        eglSwapBuffers(display, surface);
+    }
+
     GLint linked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
     if (!linked) {
         GLchar log[512];
         glGetProgramInfoLog(program, sizeof(log), NULL, log);
         fprintf(stderr, "Link error: %s\n", log);
+        glGetShaderInfoLog(vs, sizeof(log), NULL, log);
+        fprintf(stderr, "Vertex shader: %s\n", log);
+        glGetShaderInfoLog(fs, sizeof(log), NULL, log);
+        fprintf(stderr, "Fragment shader: %s\n", log);
         return 0;
     }
     return program;
@@ -180,6 +227,147 @@ static void create_cube_texture(GLubyte* data, int size, float hue) {
     }
 }
 
+// Per-instance vertex data for the instanced mode: model matrix (4 columns) and tint color
+typedef struct {
+    float model[16];
+    float tint[3];
+} CubeInstance;
+
+// Frames to record with --capture (0 = no capture)
+static int capture_frames = 0;
+
+// Called after each eglSwapBuffers: ends the capture once enough frames have been recorded
+static void capture_frame_done(int frame) {
+    if (frame + 1 == capture_frames && wasm_gl_capture_end("example-demo.gltrace")) {
+        printf("📼 Captured %d frames to example-demo.gltrace\n", capture_frames);
+    }
+}
+
+// Instanced mode: one draw call per frame for all cubes, laid out in a grid and sharing one texture
+static int run_instanced(EGLDisplay display, EGLSurface surface, GLuint vbo, GLuint ibo, GLuint texture,
+                         int num_instances) {
+    printf("🎨 Compiling instancing shaders...\n");
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, instanced_vertex_shader_source);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, instanced_fragment_shader_source);
+    GLuint program = link_program(display, surface, vs, fs);
+    if (program == 0) return 1;
+
+    GLint view_projection_loc = glGetUniformLocation(program, "u_view_projection");
+    GLint light_loc = glGetUniformLocation(program, "u_light_dir");
+    GLint texture_loc = glGetUniformLocation(program, "u_texture");
+    GLint pos_loc = glGetAttribLocation(program, "position");
+    GLint tex_loc = glGetAttribLocation(program, "texcoord");
+    GLint norm_loc = glGetAttribLocation(program, "normal");
+    GLint model_loc[4] = {
+        glGetAttribLocation(program, "i_model0"),
+        glGetAttribLocation(program, "i_model1"),
+        glGetAttribLocation(program, "i_model2"),
+        glGetAttribLocation(program, "i_model3"),
+    };
+    GLint tint_loc = glGetAttribLocation(program, "i_tint");
+
+    CubeInstance* instances = (CubeInstance*)malloc(num_instances * sizeof(CubeInstance));
+    if (!instances) return 1;
+
+    GLuint instance_vbo;
+    glGenBuffers(1, &instance_vbo);
+
+    glUseProgram(program);
+
+    // Record the attribute layout once in a vertex array object, so a frame is a single bind away from it
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    // Per-vertex attributes from the shared cube mesh
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glEnableVertexAttribArray(pos_loc);
+    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(tex_loc);
+    glVertexAttribPointer(tex_loc, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(norm_loc);
+    glVertexAttribPointer(norm_loc, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(5 * sizeof(GLfloat)));
+
+    // Per-instance attributes, advancing once per cube instead of once per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    for (int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(model_loc[i]);
+        glVertexAttribPointer(model_loc[i], 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance),
+                              (void*)(i * 4 * sizeof(GLfloat)));
+        glVertexAttribDivisor(model_loc[i], 1);
+    }
+    glEnableVertexAttribArray(tint_loc);
+    glVertexAttribPointer(tint_loc, 3, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)(16 * sizeof(GLfloat)));
+    glVertexAttribDivisor(tint_loc, 1);
+
+    glUniform3f(light_loc, 0.577f, 0.577f, 0.577f);
+    glUniform1i(texture_loc, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // Grid layout, centered around the origin
+    int side = (int)ceilf(cbrtf((float)num_instances));
+    float spacing = 1.5f;
+    float extent = (side - 1) * spacing * 0.5f;
+
+    printf("🎬 Drawing %d cubes with one instanced draw call per frame...\n\n", num_instances);
+
+    float camera_angle = 0.0f;
+    unsigned long start_time = time(NULL);
+
+    for (int frame = 0; frame < 900; frame++) {
+        glClearColor(0.05f, 0.05f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        camera_angle += 0.005f;
+        float distance = extent * 2.5f + 6.0f;
+        mat4 projection, view, view_projection;
+        mat4_perspective(projection, 45.0f, 800.0f / 600.0f, 0.1f, distance * 4.0f);
+        mat4_orbit_view(view, camera_angle, distance);
+        mat4_multiply(view_projection, projection, view);
+        glUniformMatrix4fv(view_projection_loc, 1, GL_FALSE, view_projection);
+
+        for (int i = 0; i < num_instances; i++) {
+            int x = i % side;
+            int y = (i / side) % side;
+            int z = i / (side * side);
+            float angle = frame * 0.02f + i * 0.1f;
+
+            mat4 translate_mat, rotate_x, rotate_y, scale_mat, temp, temp2;
+            mat4_translate(translate_mat, x * spacing - extent, y * spacing - extent, z * spacing - extent);
+            mat4_rotate_x(rotate_x, angle);
+            mat4_rotate_y(rotate_y, angle * 0.7f);
+            mat4_scale(scale_mat, 0.5f, 0.5f, 0.5f);
+            mat4_multiply(temp, rotate_y, rotate_x);
+            mat4_multiply(temp2, scale_mat, temp);
+            mat4_multiply(instances[i].model, translate_mat, temp2);
+
+            instances[i].tint[0] = sinf(i * 0.37f) * 0.5f + 0.5f;
+            instances[i].tint[1] = sinf(i * 0.37f + 2.094f) * 0.5f + 0.5f;
+            instances[i].tint[2] = sinf(i * 0.37f + 4.189f) * 0.5f + 0.5f;
+        }
+
+        glBufferData(GL_ARRAY_BUFFER, num_instances * sizeof(CubeInstance), instances, GL_DYNAMIC_DRAW);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, (void*)0, num_instances);
+
+        eglSwapBuffers(display, surface);
+        capture_frame_done(frame);
+
+        if (frame % 60 == 0) {
+            unsigned long elapsed = time(NULL) - start_time;
+            float fps = elapsed > 0 ? (float)frame / elapsed : 60.0f;
+            printf("  Frame %d | FPS: %.1f | Cubes: %d | Draw calls: 1\n", frame, fps, num_instances);
+        }
+    }
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    free(instances);
+    printf("\n✅ Instanced demo complete!\n\n");
+    return 0;
+}
+
 // Cube definition
 typedef struct {
     float position[3];
@@ -189,7 +377,26 @@ typedef struct {
     GLuint texture;
 } Cube;
 
-int main(void) {
+int main(int argc, char** argv) {
+    int instanced = 0;
+    int num_instances = 1000;
+    int shadowing = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--instanced") == 0) {
+            instanced = 1;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                num_instances = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--no-shadowing") == 0) {
+            shadowing = 0;
+        } else if (strcmp(argv[i], "--capture") == 0) {
+            capture_frames = 300;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                capture_frames = atoi(argv[++i]);
+            }
+        }
+    }
+
     EGLDisplay display;
     EGLSurface surface;
     EGLContext context;
@@ -201,11 +408,15 @@ int main(void) {
     
     // Initialize graphics
     printf("🚀 Initializing graphics system...\n");
+    if (capture_frames > 0) {
+        wasm_gl_capture_begin();
+    }
     if (graphics_initialize(&display, &surface, &context) != 0) {
         fprintf(stderr, "❌ Failed to initialize graphics\n");
         return 1;
     }
     printf("✅ Graphics initialized!\n\n");
+    wasm_gl_state_shadowing(shadowing);
     
     // Set viewport and enable depth testing
     glViewport(0, 0, 800, 600);
@@ -215,7 +426,7 @@ int main(void) {
     printf("🎨 Compiling shaders...\n");
     GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
     GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
-    GLuint program = link_program(vs, fs);
+    GLuint program = link_program(display, surface, vs, fs);
     if (program == 0) return 1;
     printf("✅ Shaders compiled and linked!\n\n");
     
@@ -345,6 +556,10 @@ int main(void) {
     
     free(tex_data);
     printf("\n");
+
+    if (instanced) {
+        return run_instanced(display, surface, vbo, ibo, cubes[0].texture, num_instances);
+    }
     
     // Setup rendering
     glUseProgram(program);
@@ -381,14 +596,11 @@ int main(void) {
         
         // Camera orbit
         camera_angle += 0.005f;
-        float cam_x = sinf(camera_angle) * 6.0f;
-        float cam_z = cosf(camera_angle) * 6.0f;
-        float cam_y = sinf(camera_angle * 0.5f) * 2.0f;
         
         // View matrix (camera looking at origin)
         mat4 projection, view, model, mvp, temp, temp2;
         mat4_perspective(projection, 45.0f, 800.0f / 600.0f, 0.1f, 100.0f);
-        mat4_translate(view, -cam_x, -cam_y, -cam_z);
+        mat4_orbit_view(view, camera_angle, 6.0f);
         
         // Render each cube
         for (int i = 0; i < num_cubes; i++) {
@@ -426,17 +638,18 @@ int main(void) {
         
         // Present
         eglSwapBuffers(display, surface);
+        capture_frame_done(frame);
         
         // FPS counter
         frame_count++;
         if (frame % 60 == 0) {
             unsigned long elapsed = time(NULL) - start_time;
             float fps = elapsed > 0 ? (float)frame_count / elapsed : 60.0f;
-            printf("  Frame %d | FPS: %.1f | Cubes: %d | Camera angle: %.1f°\n",
-                   frame, fps, num_cubes, camera_angle * 180.0f / 3.14159f);
+            GLuint issued, elided;
+            wasm_gl_get_call_counts(&issued, &elided);
+            printf("  Frame %d | FPS: %.1f | Cubes: %d | Camera angle: %.1f° | GL calls: %u issued, %u elided\n",
+                   frame, fps, num_cubes, camera_angle * 180.0f / 3.14159f, issued, elided);
         }
-        
-        usleep(16667);  // ~60 FPS
     }
     
     printf("\n✅ Demo complete!\n");
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0-only
+//
+// Render-to-Texture Example for Linux/Wasm
+// Renders a spinning, depth-tested scene into a texture through a framebuffer object (with a depth renderbuffer),
+// then draws that texture to the screen with a post-processing shader (wave distortion and vignette). Both passes
+// run on the GPU; no pixels are read back.
+//
+// Usage: example-fbo [scale]   (size of the offscreen texture relative to the canvas, 0.25 by default)
+//
+// Compile with:
+//   ./tools/compile-graphics.sh runtime/examples/example-fbo.c
+
+#include "../wasm-graphics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define CANVAS_WIDTH 800
+#define CANVAS_HEIGHT 600
+#define SEGMENTS 12
+
+// Pass 1: the scene, colored triangles around the center at two depths
+const char* scene_vertex_shader_source =
+    "attribute vec3 position;\n"
+    "attribute vec3 color;\n"
+    "uniform float u_angle;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  float c = cos(u_angle);\n"
+    "  float s = sin(u_angle);\n"
+    "  gl_Position = vec4(c * position.x - s * position.y, s * position.x + c * position.y, position.z, 1.0);\n"
+    "  v_color = color;\n"
+    "}\n";
+
+const char* scene_fragment_shader_source =
+    "precision mediump float;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color, 1.0);\n"
+    "}\n";
+
+// Pass 2: post-processing of the scene texture on a fullscreen quad
+const char* post_vertex_shader_source =
+    "attribute vec2 position;\n"
+    "varying vec2 v_texcoord;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(position, 0.0, 1.0);\n"
+    "  v_texcoord = position * 0.5 + 0.5;\n"
+    "}\n";
+
+const char* post_fragment_shader_source =
+    "precision mediump float;\n"
+    "varying vec2 v_texcoord;\n"
+    "uniform sampler2D u_scene;\n"
+    "uniform float u_time;\n"
+    "void main() {\n"
+    "  vec2 uv = v_texcoord + vec2(sin(v_texcoord.y * 20.0 + u_time * 3.0), 0.0) * 0.01;\n"
+    "  vec2 d = v_texcoord - 0.5;\n"
+    "  float vignette = 1.0 - dot(d, d) * 1.5;\n"
+    "  gl_FragColor = vec4(texture2D(u_scene, uv).rgb * vignette, 1.0);\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+static GLuint build_program(EGLDisplay display, EGLSurface surface, const char* vertex_source,
+                            const char* fragment_source) {
+    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+    if (vertex_shader == 0 || fragment_shader == 0) return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+
+    // Present blank frames until both shaders are compiled and the program is linked.
+    while (!wasm_gl_program_ready(program)) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        eglSwapBuffers(display, surface);
+    }
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        GLchar log[512];
+        GLsizei log_length;
+        glGetProgramInfoLog(program, sizeof(log), &log_length, log);
+        fprintf(stderr, "Program linking failed:\n%s\n", log);
+        glGetShaderInfoLog(vertex_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Vertex shader:\n%s\n", log);
+        glGetShaderInfoLog(fragment_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Fragment shader:\n%s\n", log);
+    }
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return linked ? program : 0;
+}
+
+static const char* framebuffer_status_name(GLenum status) {
+    switch (status) {
+        case GL_FRAMEBUFFER_COMPLETE: return "complete";
+        case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: return "incomplete attachment";
+        case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: return "missing attachment";
+        case GL_FRAMEBUFFER_INCOMPLETE_DIMENSIONS: return "incomplete dimensions";
+        case GL_FRAMEBUFFER_UNSUPPORTED: return "unsupported";
+        default: return "unknown";
+    }
+}
+
+// A fan of triangles: the even ones in front (z = -0.5), the odd ones larger but behind (z = 0.5), so that the depth
+// renderbuffer decides what is visible where they overlap.
+static void build_scene(GLfloat* vertices) {
+    for (int i = 0; i < SEGMENTS; i++) {
+        float radius = (i & 1) ? 0.9f : 0.6f;
+        float z = (i & 1) ? 0.5f : -0.5f;
+        float a0 = (float)i / SEGMENTS * 6.2831853f;
+        float a1 = (float)(i + 2) / SEGMENTS * 6.2831853f;
+        float r = 0.5f + 0.5f * cosf(a0);
+        float g = 0.5f + 0.5f * cosf(a0 + 2.094f);
+        float b = 0.5f + 0.5f * cosf(a0 + 4.189f);
+        GLfloat triangle[3][6] = {
+            { 0.0f, 0.0f, z, 1.0f, 1.0f, 1.0f },
+            { cosf(a0) * radius, sinf(a0) * radius, z, r, g, b },
+            { cosf(a1) * radius, sinf(a1) * radius, z, r, g, b },
+        };
+        for (int k = 0; k < 3; k++) {
+            for (int c = 0; c < 6; c++) {
+                vertices[(i * 3 + k) * 6 + c] = triangle[k][c];
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+
+    float scale = argc > 1 ? atof(argv[1]) : 0.25f;
+    if (scale <= 0.0f || scale > 4.0f) {
+        fprintf(stderr, "Usage: %s [scale]\n", argv[0]);
+        return 1;
+    }
+    int fbo_width = (int)(CANVAS_WIDTH * scale);
+    int fbo_height = (int)(CANVAS_HEIGHT * scale);
+
+    printf("Linux/Wasm Render-to-Texture Example\n");
+    printf("====================================\n\n");
+
+    if (graphics_initialize(&display, &surface, &context) != 0) {
+        fprintf(stderr, "Failed to initialize graphics\n");
+        return 1;
+    }
+
+    GLuint scene_program = build_program(display, surface, scene_vertex_shader_source, scene_fragment_shader_source);
+    GLuint post_program = build_program(display, surface, post_vertex_shader_source, post_fragment_shader_source);
+    if (scene_program == 0 || post_program == 0) return 1;
+
+    GLint scene_position = glGetAttribLocation(scene_program, "position");
+    GLint scene_color = glGetAttribLocation(scene_program, "color");
+    GLint angle_uniform = glGetUniformLocation(scene_program, "u_angle");
+    GLint post_position = glGetAttribLocation(post_program, "position");
+    GLint scene_uniform = glGetUniformLocation(post_program, "u_scene");
+    GLint time_uniform = glGetUniformLocation(post_program, "u_time");
+
+    // Geometry of both passes, each in its own vertex array object
+    static GLfloat scene_vertices[SEGMENTS * 3 * 6];
+    build_scene(scene_vertices);
+    static const GLfloat quad_vertices[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    GLuint vertex_arrays[2];
+    GLuint buffers[2];
+    glGenVertexArrays(2, vertex_arrays);
+    glGenBuffers(2, buffers);
+
+    glBindVertexArray(vertex_arrays[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(scene_vertices), scene_vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(scene_position);
+    glVertexAttribPointer(scene_position, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(scene_color);
+    glVertexAttribPointer(scene_color, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+
+    glBindVertexArray(vertex_arrays[1]);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(post_position);
+    glVertexAttribPointer(post_position, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
+
+    // The offscreen render target: a color texture and a depth renderbuffer
+    GLuint scene_texture;
+    glGenTextures(1, &scene_texture);
+    glBindTexture(GL_TEXTURE_2D, scene_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, fbo_width, fbo_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    GLuint depth_renderbuffer;
+    glGenRenderbuffers(1, &depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, fbo_width, fbo_height);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scene_texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    printf("Framebuffer %dx%d: %s\n", fbo_width, fbo_height, framebuffer_status_name(status));
+    if (status != GL_FRAMEBUFFER_COMPLETE) return 1;
+
+    glUseProgram(post_program);
+    glUniform1i(scene_uniform, 0);
+
+    printf("Rendering 600 frames...\n");
+    for (int frame = 0; frame < 600; frame++) {
+        float time = frame / 60.0f;
+
+        // Pass 1: the scene, into the texture
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, fbo_width, fbo_height);
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.05f, 0.05f, 0.15f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUseProgram(scene_program);
+        glUniform1f(angle_uniform, time * 0.8f);
+        glBindVertexArray(vertex_arrays[0]);
+        glDrawArrays(GL_TRIANGLES, 0, SEGMENTS * 3);
+
+        // Pass 2: the texture, post-processed onto the canvas
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, CANVAS_WIDTH, CANVAS_HEIGHT);
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(post_program);
+        glUniform1f(time_uniform, time);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, scene_texture);
+        glBindVertexArray(vertex_arrays[1]);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        eglSwapBuffers(display, surface);
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depth_renderbuffer);
+    glDeleteTextures(1, &scene_texture);
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(2, vertex_arrays);
+    glDeleteProgram(scene_program);
+    glDeleteProgram(post_program);
+
+    printf("\nDone!\n");
+    return 0;
+}
@@ -14,7 +14,6 @@
 
 #include "../wasm-graphics.h"
 #include <stdio.h>
-#include <unistd.h>
 #include <math.h>
 
 // Animation state
@@ -99,9 +98,6 @@ int main(void) {
             printf("Frame %d: RGB(%.2f, %.2f, %.2f) Hue=%.1f°\n", 
                    frame, r, g, b, hue);
         }
-
-        // Sleep to limit frame rate (~60 FPS)
-        usleep(16667);
     }
 
     printf("\nAnimation complete!\n");
@@ -11,7 +11,6 @@
 #include "../wasm-graphics.h"
 #include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 
 // Simple vertex shader
 const char* vertex_shader_source =
@@ -42,27 +41,15 @@ static GLuint compile_shader(GLenum type, const char* source) {
     // Set shader source
     glShaderSource(shader, 1, &source, NULL);
 
-    // Compile shader
+    // Compile shader (in the background, errors are reported when the program is linked)
     glCompileShader(shader);
 
-    // Check compilation status
-    GLint compiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-    
-    if (!compiled) {
-        GLchar log[512];
-        GLsizei log_length;
-        glGetShaderInfoLog(shader, sizeof(log), &log_length, log);
-        fprintf(stderr, "Shader compilation failed:\n%s\n", log);
-        return 0;
-    }
-
-    printf("Shader compiled successfully (ID: %u)\n", shader);
+    printf("Shader created (ID: %u)\n", shader);
     return shader;
 }
 
 // Helper function to link a program
-static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
+static GLuint link_program(EGLDisplay display, EGLSurface surface, GLuint vertex_shader, GLuint fragment_shader) {
     GLuint program = glCreateProgram();
     if (program == 0) {
         fprintf(stderr, "Failed to create program\n");
@@ -76,6 +63,12 @@ static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
     // Link program
     glLinkProgram(program);
 
+    // Wait for the link without blocking on it (the shaders are compiled along with it)
+    while (!wasm_gl_program_ready(program)) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        eglSwapBuffers(display, surface);
+    }
+
     // Check link status
     GLint linked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
@@ -85,6 +78,10 @@ static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
         GLsizei log_length;
         glGetProgramInfoLog(program, sizeof(log), &log_length, log);
         fprintf(stderr, "Program linking failed:\n%s\n", log);
+        glGetShaderInfoLog(vertex_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Vertex shader:\n%s\n", log);
+        glGetShaderInfoLog(fragment_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Fragment shader:\n%s\n", log);
         return 0;
     }
 
@@ -126,7 +123,7 @@ int main(void) {
 
     // Link program
     printf("Linking program...\n");
-    GLuint program = link_program(vertex_shader, fragment_shader);
+    GLuint program = link_program(display, surface, vertex_shader, fragment_shader);
     if (program == 0) {
         return 1;
     }
@@ -188,9 +185,6 @@ int main(void) {
         if (frame % 60 == 0) {
             printf("Frame %d rendered\n", frame);
         }
-
-        // ~60 FPS
-        usleep(16667);
     }
 
     printf("\nTest complete! Triangle rendered successfully.\n");
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0-only
+//
+// Streaming Upload Benchmark for Linux/Wasm
+// Animates a particle field whose vertices are regenerated every frame and compares upload paths:
+//   bufferdata - glBufferData on every frame (the buffer is reallocated each time)
+//   subdata    - glBufferSubData into a buffer allocated once
+//   stream     - the fenced streaming ring from wasm-graphics.h (wasm_gl_stream_*)
+//
+// Usage: example-stream [particles]
+//
+// Compile with:
+//   ./tools/compile-graphics.sh runtime/examples/example-stream.c
+
+#include "../wasm-graphics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define FRAMES_PER_MODE 300
+
+const char* vertex_shader_source =
+    "attribute vec2 position;\n"
+    "attribute vec3 color;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(position, 0.0, 1.0);\n"
+    "  gl_PointSize = 2.0;\n"
+    "  v_color = color;\n"
+    "}\n";
+
+const char* fragment_shader_source =
+    "precision mediump float;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "  gl_FragColor = vec4(v_color, 1.0);\n"
+    "}\n";
+
+typedef struct {
+    GLfloat position[2];
+    GLfloat color[3];
+} Particle;
+
+typedef enum {
+    MODE_BUFFER_DATA,
+    MODE_BUFFER_SUB_DATA,
+    MODE_STREAM,
+} UploadMode;
+
+static const char* mode_names[] = { "bufferdata", "subdata", "stream" };
+
+static GLuint compile_shader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+static GLuint link_program(EGLDisplay display, EGLSurface surface, GLuint vertex_shader, GLuint fragment_shader) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    // Poll rather than block in glGetProgramiv(GL_LINK_STATUS) while the program links.
+    while (!wasm_gl_program_ready(program)) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        eglSwapBuffers(display, surface);
+    }
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        GLchar log[512];
+        GLsizei log_length;
+        glGetProgramInfoLog(program, sizeof(log), &log_length, log);
+        fprintf(stderr, "Program linking failed:\n%s\n", log);
+        glGetShaderInfoLog(vertex_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Vertex shader:\n%s\n", log);
+        glGetShaderInfoLog(fragment_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Fragment shader:\n%s\n", log);
+        return 0;
+    }
+    return program;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Particles orbiting the center on rings of different radius and speed
+static void update_particles(Particle* particles, int count, int frame) {
+    for (int i = 0; i < count; i++) {
+        float radius = 0.1f + 0.85f * (float)i / count;
+        float angle = i * 2.399963f + frame * (0.02f / radius) * 0.05f;
+        particles[i].position[0] = cosf(angle) * radius * 0.75f;
+        particles[i].position[1] = sinf(angle) * radius;
+        particles[i].color[0] = 0.5f + 0.5f * sinf(angle);
+        particles[i].color[1] = 0.5f + 0.5f * sinf(angle + 2.094f);
+        particles[i].color[2] = 0.5f + 0.5f * sinf(angle + 4.189f);
+    }
+}
+
+static void set_attributes(GLint pos_loc, GLint color_loc, GLintptr offset) {
+    glVertexAttribPointer(pos_loc, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offset);
+    glVertexAttribPointer(color_loc, 3, GL_FLOAT, GL_FALSE, sizeof(Particle),
+                          (void*)(offset + 2 * sizeof(GLfloat)));
+}
+
+static int run_mode(EGLDisplay display, EGLSurface surface, UploadMode mode, int count,
+                    GLint pos_loc, GLint color_loc) {
+    GLsizeiptr frame_size = count * sizeof(Particle);
+    Particle* particles = NULL;
+    GLuint vbo = 0;
+    WasmGLStreamBuffer stream;
+
+    if (mode == MODE_STREAM) {
+        // Two frames per segment, so the ring holds eight frames in flight
+        if (wasm_gl_stream_init(&stream, GL_ARRAY_BUFFER, frame_size * 2 * WASM_GL_STREAM_SEGMENTS) != 0) {
+            return 1;
+        }
+    } else {
+        particles = (Particle*)malloc(frame_size);
+        if (!particles) return 1;
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (mode == MODE_BUFFER_SUB_DATA) {
+            glBufferData(GL_ARRAY_BUFFER, frame_size, NULL, GL_DYNAMIC_DRAW);
+        }
+        set_attributes(pos_loc, color_loc, 0);
+    }
+
+    double start = now_seconds();
+    for (int frame = 0; frame < FRAMES_PER_MODE; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        switch (mode) {
+            case MODE_BUFFER_DATA:
+                update_particles(particles, count, frame);
+                glBufferData(GL_ARRAY_BUFFER, frame_size, particles, GL_DYNAMIC_DRAW);
+                break;
+            case MODE_BUFFER_SUB_DATA:
+                update_particles(particles, count, frame);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, frame_size, particles);
+                break;
+            case MODE_STREAM: {
+                GLintptr offset;
+                Particle* mapped = (Particle*)wasm_gl_stream_map(&stream, frame_size, &offset);
+                update_particles(mapped, count, frame);
+                wasm_gl_stream_unmap(&stream);
+                set_attributes(pos_loc, color_loc, offset);
+                break;
+            }
+        }
+
+        glDrawArrays(GL_POINTS, 0, count);
+        eglSwapBuffers(display, surface);
+    }
+    double elapsed = now_seconds() - start;
+
+    double megabytes = (double)frame_size * FRAMES_PER_MODE / (1024.0 * 1024.0);
+    printf("  %-10s  %7.1f frames/s  %8.1f MB/s\n", mode_names[mode], FRAMES_PER_MODE / elapsed,
+           megabytes / elapsed);
+
+    if (mode == MODE_STREAM) {
+        wasm_gl_stream_destroy(&stream);
+    } else {
+        glDeleteBuffers(1, &vbo);
+        free(particles);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+
+    int count = argc > 1 ? atoi(argv[1]) : 50000;
+    if (count <= 0) {
+        fprintf(stderr, "Usage: %s [particles]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Linux/Wasm Streaming Upload Benchmark\n");
+    printf("=====================================\n\n");
+
+    if (graphics_initialize(&display, &surface, &context) != 0) {
+        fprintf(stderr, "Failed to initialize graphics\n");
+        return 1;
+    }
+
+    // Measure uploads, not the display refresh rate
+    eglSwapInterval(display, 0);
+
+    glViewport(0, 0, 800, 600);
+    glClearColor(0.0f, 0.0f, 0.05f, 1.0f);
+
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+    if (vs == 0 || fs == 0) return 1;
+    GLuint program = link_program(display, surface, vs, fs);
+    if (program == 0) return 1;
+    glUseProgram(program);
+
+    GLint pos_loc = glGetAttribLocation(program, "position");
+    GLint color_loc = glGetAttribLocation(program, "color");
+    glEnableVertexAttribArray(pos_loc);
+    glEnableVertexAttribArray(color_loc);
+
+    printf("%d particles, %.1f KB per frame, %d frames per mode:\n\n", count,
+           count * sizeof(Particle) / 1024.0, FRAMES_PER_MODE);
+
+    for (int mode = MODE_BUFFER_DATA; mode <= MODE_STREAM; mode++) {
+        if (run_mode(display, surface, (UploadMode)mode, count, pos_loc, color_loc) != 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    printf("\nBenchmark complete!\n");
+    return 0;
+}
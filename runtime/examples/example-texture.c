@@ -3,6 +3,11 @@
 // Texture Test Program for Linux/Wasm
 // Demonstrates textured quad rendering
 //
+// Usage: example-texture [--benchmark [size]]
+//   --benchmark  First compares uploading size x size textures (1024 by default) with a full mipmap chain as RGBA
+//                (glTexImage2D + glGenerateMipmap) and in each compressed format the browser supports
+//                (glCompressedTexImage2D per level): upload time and texture memory.
+//
 // Author: Kyros Koh
 //
 // Compile with:
@@ -12,9 +17,12 @@
 
 #include "../wasm-graphics.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 #include <math.h>
+#include <time.h>
+
+#define BENCHMARK_TEXTURES 16
 
 // Vertex shader with texture coordinates
 const char* vertex_shader_source =
@@ -45,23 +53,11 @@ static GLuint compile_shader(GLenum type, const char* source) {
 
     glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
-
-    GLint compiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-    
-    if (!compiled) {
-        GLchar log[512];
-        GLsizei log_length;
-        glGetShaderInfoLog(shader, sizeof(log), &log_length, log);
-        fprintf(stderr, "Shader compilation failed:\n%s\n", log);
-        return 0;
-    }
-
     return shader;
 }
 
 // Helper function to link a program
-static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
+static GLuint link_program(EGLDisplay display, EGLSurface surface, GLuint vertex_shader, GLuint fragment_shader) {
     GLuint program = glCreateProgram();
     if (program == 0) {
         fprintf(stderr, "Failed to create program\n");
@@ -72,6 +68,12 @@ static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
     glAttachShader(program, fragment_shader);
     glLinkProgram(program);
 
+    // A (blank) loading screen until the program has been linked in the background.
+    while (!wasm_gl_program_ready(program)) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        eglSwapBuffers(display, surface);
+    }
+
     GLint linked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
     
@@ -80,6 +82,10 @@ static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
         GLsizei log_length;
         glGetProgramInfoLog(program, sizeof(log), &log_length, log);
         fprintf(stderr, "Program linking failed:\n%s\n", log);
+        glGetShaderInfoLog(vertex_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Vertex shader:\n%s\n", log);
+        glGetShaderInfoLog(fragment_shader, sizeof(log), &log_length, log);
+        fprintf(stderr, "Fragment shader:\n%s\n", log);
         return 0;
     }
 
@@ -110,11 +116,170 @@ static void create_checkerboard_texture(GLubyte* data, int width, int height) {
     }
 }
 
-int main(void) {
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Compressed formats for the benchmark. The checkerboard squares are 16 texels wide, so every block lies within one
+// square and is simply encoded as a single color (its top-left texel), which is close enough for the gradient ones.
+typedef struct {
+    const char* name;
+    GLenum format;
+    int block_width;
+    int block_height;
+    int block_bytes;
+    void (*encode)(GLubyte* block, const GLubyte* rgba);
+} CompressedFormat;
+
+// S3TC/DXT1: two RGB565 endpoints (both the color) and 2-bit indices (all selecting endpoint 0).
+static void encode_dxt1(GLubyte* block, const GLubyte* rgba) {
+    GLushort color = ((rgba[0] >> 3) << 11) | ((rgba[1] >> 2) << 5) | (rgba[2] >> 3);
+    memset(block, 0, 8);
+    block[0] = block[2] = color & 0xFF;
+    block[1] = block[3] = color >> 8;
+}
+
+// ETC1 (also valid ETC2): differential mode, RGB555 base color with zero deltas, intensity table 0 (off by +2).
+static void encode_etc(GLubyte* block, const GLubyte* rgba) {
+    memset(block, 0, 8);
+    block[0] = (rgba[0] >> 3) << 3;
+    block[1] = (rgba[1] >> 3) << 3;
+    block[2] = (rgba[2] >> 3) << 3;
+    block[3] = 0x02;  // Differential mode, no flip
+}
+
+// ASTC: a void-extent block, which is one constant UNORM16 RGBA color.
+static void encode_astc(GLubyte* block, const GLubyte* rgba) {
+    static const GLubyte header[8] = { 0xFC, 0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    memcpy(block, header, 8);
+    for (int c = 0; c < 4; c++) {
+        block[8 + c * 2] = rgba[c];
+        block[9 + c * 2] = rgba[c];
+    }
+}
+
+static const CompressedFormat compressed_formats[] = {
+    { "DXT1 (S3TC)", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 4, 8, encode_dxt1 },
+    { "ETC2 RGB8", GL_COMPRESSED_RGB8_ETC2, 4, 4, 8, encode_etc },
+    { "ETC1", GL_ETC1_RGB8_OES, 4, 4, 8, encode_etc },
+    { "ASTC 4x4", GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 4, 16, encode_astc },
+    { "ASTC 8x8", GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 8, 8, 16, encode_astc },
+};
+
+static int mip_levels(int size) {
+    int levels = 1;
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+// Encode a width x height RGBA image into blocks (width and height need not be multiples of the block size).
+static GLsizei compress_image(const CompressedFormat* format, GLubyte* out, const GLubyte* rgba, int width,
+                              int height) {
+    int blocks_x = (width + format->block_width - 1) / format->block_width;
+    int blocks_y = (height + format->block_height - 1) / format->block_height;
+    for (int by = 0; by < blocks_y; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            const GLubyte* texel = rgba + ((by * format->block_height) * width + bx * format->block_width) * 4;
+            format->encode(out + (by * blocks_x + bx) * format->block_bytes, texel);
+        }
+    }
+    return blocks_x * blocks_y * format->block_bytes;
+}
+
+static void print_result(const char* name, double seconds, double bytes) {
+    double megabytes = bytes / (1024.0 * 1024.0);
+    printf("  %-12s  %8.2f ms  %8.1f MB/s  %8.1f KB\n", name, seconds * 1000.0 / BENCHMARK_TEXTURES,
+           megabytes * BENCHMARK_TEXTURES / seconds, bytes / 1024.0);
+}
+
+// Upload BENCHMARK_TEXTURES size x size textures with all mipmap levels per path, and report the time per texture, the
+// upload rate and the memory taken by one texture.
+static int run_benchmark(int size) {
+    int levels = mip_levels(size);
+    // All levels of a compressed texture take less than its RGBA base level, except for whole blocks at the small ones.
+    GLubyte* rgba = (GLubyte*)malloc((size_t)size * size * 4);
+    GLubyte* blocks = (GLubyte*)malloc((size_t)size * size * 4 + levels * 16);
+    if (!rgba || !blocks) {
+        free(rgba);
+        free(blocks);
+        return -1;
+    }
+    GLuint textures[BENCHMARK_TEXTURES];
+
+    printf("Upload benchmark: %d textures of %dx%d with %d mipmap levels\n", BENCHMARK_TEXTURES, size, size, levels);
+    printf("  %-12s  %11s  %13s  %11s\n", "format", "per texture", "upload rate", "memory");
+
+    create_checkerboard_texture(rgba, size, size);
+    glGenTextures(BENCHMARK_TEXTURES, textures);
+    double start = now_seconds();
+    for (int i = 0; i < BENCHMARK_TEXTURES; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    // Only the base level is uploaded, the GPU fills in the rest (4/3 of it, all told).
+    print_result("RGBA8", now_seconds() - start, size * (double)size * 4 * 4 / 3);
+    glDeleteTextures(BENCHMARK_TEXTURES, textures);
+
+    for (size_t f = 0; f < sizeof(compressed_formats) / sizeof(compressed_formats[0]); f++) {
+        const CompressedFormat* format = &compressed_formats[f];
+        if (!wasm_gl_compressed_format_supported(format->format)) {
+            printf("  %-12s  not supported by this browser\n", format->name);
+            continue;
+        }
+
+        // Compressed textures cannot be mipmapped by the GPU, the levels are encoded up front (as files would be).
+        GLubyte* level_data[32];
+        GLsizei level_sizes[32];
+        GLsizei bytes = 0;
+        for (int level = 0; level < levels; level++) {
+            int level_size = size >> level;
+            create_checkerboard_texture(rgba, level_size, level_size);
+            level_data[level] = blocks + bytes;
+            level_sizes[level] = compress_image(format, level_data[level], rgba, level_size, level_size);
+            bytes += level_sizes[level];
+        }
+
+        glGenTextures(BENCHMARK_TEXTURES, textures);
+        start = now_seconds();
+        for (int i = 0; i < BENCHMARK_TEXTURES; i++) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            for (int level = 0; level < levels; level++) {
+                int level_size = size >> level;
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, format->format, level_size, level_size, 0,
+                                       level_sizes[level], level_data[level]);
+            }
+        }
+        print_result(format->name, now_seconds() - start, bytes);
+        glDeleteTextures(BENCHMARK_TEXTURES, textures);
+    }
+    printf("\n");
+
+    free(rgba);
+    free(blocks);
+    return 0;
+}
+
+int main(int argc, char** argv) {
     EGLDisplay display;
     EGLSurface surface;
     EGLContext context;
 
+    int benchmark_size = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--benchmark") == 0) {
+            benchmark_size = 1024;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                benchmark_size = atoi(argv[++i]);
+            }
+        }
+    }
+
     printf("Linux/Wasm Texture Test\n");
     printf("=======================\n\n");
 
@@ -126,6 +291,11 @@ int main(void) {
     }
     printf("Graphics initialized!\n\n");
 
+    if (benchmark_size > 0 && run_benchmark(benchmark_size) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
     // Set viewport
     glViewport(0, 0, 800, 600);
 
@@ -138,7 +308,7 @@ int main(void) {
     if (fragment_shader == 0) return 1;
 
     // Link program
-    GLuint program = link_program(vertex_shader, fragment_shader);
+    GLuint program = link_program(display, surface, vertex_shader, fragment_shader);
     if (program == 0) return 1;
     
     printf("Shaders compiled and linked!\n\n");
@@ -201,12 +371,13 @@ int main(void) {
     create_checkerboard_texture(texture_data, tex_width, tex_height);
     printf("Generated %dx%d checkerboard texture\n", tex_width, tex_height);
 
-    // Upload texture data
+    // Upload texture data, and have the mipmaps generated from it to avoid aliasing where it is drawn smaller
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_width, tex_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
+    glGenerateMipmap(GL_TEXTURE_2D);
     free(texture_data);
     
     // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -247,9 +418,6 @@ int main(void) {
         if (frame % 60 == 0) {
             printf("Frame %d rendered\n", frame);
         }
-
-        // ~60 FPS
-        usleep(16667);
     }
 
     printf("\nTest complete! Textured quad rendered successfully.\n");
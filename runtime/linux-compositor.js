@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/**
+ * The compositor: shows the window surfaces of all tasks on the page canvas together, while each of them renders to a
+ * canvas of its own (see graphics_egl_create_surface in linux-graphics.js).
+ *
+ * linux_compositor(gl, log) takes the WebGL2 context of the page canvas. Each window surface is a layer. On
+ * eglSwapBuffers, present() takes the frame of the layer's canvas as an ImageBitmap (transferToImageBitmap() hands
+ * over the drawing buffer rather than copying it), and compose(), called once per display refresh, uploads the frames
+ * presented since then into the layers' textures and draws all layers, tiled in the order they were created. It all
+ * stays on the GPU, nothing goes through Wasm memory. Refreshes at which no layer has presented a frame (and none has
+ * come or gone) do nothing at all, so idle windows cost nothing.
+ *
+ * The page canvas is also that of the default GL context (used by tasks that have not made an EGL context current),
+ * so compose() puts back any GL state it changes. What such tasks draw is covered by the layers, though.
+ */
+const linux_compositor = (gl, log) => {
+  const VERTEX_SHADER = `#version 300 es
+    in vec2 a_corner;
+    uniform vec4 u_rect;  // Left, bottom, width and height in clip space
+    out vec2 v_texcoord;
+    void main() {
+      v_texcoord = vec2(a_corner.x, 1.0 - a_corner.y);  // Frames are uploaded top row first
+      gl_Position = vec4(u_rect.xy + a_corner * u_rect.zw, 0.0, 1.0);
+    }`;
+
+  const FRAGMENT_SHADER = `#version 300 es
+    precision mediump float;
+    uniform sampler2D u_frame;
+    in vec2 v_texcoord;
+    out vec4 color;
+    void main() {
+      color = texture(u_frame, v_texcoord);
+    }`;
+
+  /// GL state that compose() changes, as [save(), restore(value)] pairs.
+  const STATE = [
+    [() => gl.getParameter(gl.DRAW_FRAMEBUFFER_BINDING), (value) => gl.bindFramebuffer(gl.DRAW_FRAMEBUFFER, value)],
+    [() => gl.getParameter(gl.READ_FRAMEBUFFER_BINDING), (value) => gl.bindFramebuffer(gl.READ_FRAMEBUFFER, value)],
+    [() => gl.getParameter(gl.PIXEL_UNPACK_BUFFER_BINDING), (value) => gl.bindBuffer(gl.PIXEL_UNPACK_BUFFER, value)],
+    [() => gl.getParameter(gl.ARRAY_BUFFER_BINDING), (value) => gl.bindBuffer(gl.ARRAY_BUFFER, value)],
+    [() => gl.getParameter(gl.CURRENT_PROGRAM), (value) => gl.useProgram(value)],
+    [() => gl.getParameter(gl.VERTEX_ARRAY_BINDING), (value) => gl.bindVertexArray(value)],
+    [() => gl.getParameter(gl.VIEWPORT), (value) => gl.viewport(...value)],
+    [() => gl.getParameter(gl.COLOR_CLEAR_VALUE), (value) => gl.clearColor(...value)],
+    [() => gl.getParameter(gl.COLOR_WRITEMASK), (value) => gl.colorMask(...value)],
+    [() => [gl.BLEND_SRC_RGB, gl.BLEND_DST_RGB, gl.BLEND_SRC_ALPHA, gl.BLEND_DST_ALPHA].map((p) => gl.getParameter(p)),
+      (value) => gl.blendFuncSeparate(...value)],
+    [() => [gl.BLEND_EQUATION_RGB, gl.BLEND_EQUATION_ALPHA].map((p) => gl.getParameter(p)),
+      (value) => gl.blendEquationSeparate(...value)],
+    ...[gl.BLEND, gl.SCISSOR_TEST, gl.DEPTH_TEST, gl.STENCIL_TEST, gl.CULL_FACE, gl.RASTERIZER_DISCARD].map((cap) =>
+      [() => gl.isEnabled(cap), (value) => value ? gl.enable(cap) : gl.disable(cap)]),
+    ...[gl.UNPACK_FLIP_Y_WEBGL, gl.UNPACK_PREMULTIPLY_ALPHA_WEBGL, gl.UNPACK_ROW_LENGTH, gl.UNPACK_SKIP_ROWS,
+      gl.UNPACK_SKIP_PIXELS].map((pname) => [() => gl.getParameter(pname), (value) => gl.pixelStorei(pname, value)]),
+    // The texture bound to unit 0 (which compose() uses), then the active unit.
+    [() => {
+      const unit = gl.getParameter(gl.ACTIVE_TEXTURE);
+      gl.activeTexture(gl.TEXTURE0);
+      return [unit, gl.getParameter(gl.TEXTURE_BINDING_2D)];
+    }, ([unit, texture]) => {
+      gl.activeTexture(gl.TEXTURE0);
+      gl.bindTexture(gl.TEXTURE_2D, texture);
+      gl.activeTexture(unit);
+    }],
+  ];
+
+  /// The program and vertex array that draw a layer, created on the first compose().
+  let program = null;
+  let rect_location = null;
+  let vertex_array = null;
+
+  const setup = () => {
+    program = gl.createProgram();
+    for (const [type, source] of [[gl.VERTEX_SHADER, VERTEX_SHADER], [gl.FRAGMENT_SHADER, FRAGMENT_SHADER]]) {
+      const shader = gl.createShader(type);
+      gl.shaderSource(shader, source);
+      gl.compileShader(shader);
+      gl.attachShader(program, shader);
+      gl.deleteShader(shader);
+    }
+    gl.bindAttribLocation(program, 0, "a_corner");
+    gl.linkProgram(program);
+    if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+      log("[Graphics]: Compositor program failed to link: " + gl.getProgramInfoLog(program));
+    }
+    rect_location = gl.getUniformLocation(program, "u_rect");
+
+    vertex_array = gl.createVertexArray();
+    gl.bindVertexArray(vertex_array);
+    gl.bindBuffer(gl.ARRAY_BUFFER, gl.createBuffer());
+    gl.bufferData(gl.ARRAY_BUFFER, new Float32Array([0, 0, 1, 0, 0, 1, 1, 1]), gl.STATIC_DRAW);
+    gl.enableVertexAttribArray(0);
+    gl.vertexAttribPointer(0, 2, gl.FLOAT, false, 0, 0);
+  };
+
+  /// Layers ({ canvas, texture, width and height of the texture, frame presented but not uploaded yet }), bottom up.
+  const layers = [];
+
+  /// Whether anything changed since the last compose().
+  let damaged = false;
+
+  /// Upload the frame presented for a layer into its texture.
+  const upload = (layer) => {
+    gl.bindTexture(gl.TEXTURE_2D, layer.texture);
+    if (layer.width == layer.frame.width && layer.height == layer.frame.height) {
+      gl.texSubImage2D(gl.TEXTURE_2D, 0, 0, 0, gl.RGBA, gl.UNSIGNED_BYTE, layer.frame);
+    } else {
+      gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, gl.RGBA, gl.UNSIGNED_BYTE, layer.frame);
+      gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.LINEAR);
+      gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
+      gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
+      layer.width = layer.frame.width;
+      layer.height = layer.frame.height;
+    }
+    layer.frame.close();
+    layer.frame = null;
+  };
+
+  /// Draw the layers, each scaled to fit (keeping its aspect ratio) into its cell of a grid over the canvas.
+  const draw = () => {
+    const width = gl.drawingBufferWidth;
+    const height = gl.drawingBufferHeight;
+    const columns = Math.ceil(Math.sqrt(layers.length));
+    const rows = Math.ceil(layers.length / Math.max(columns, 1));
+
+    gl.viewport(0, 0, width, height);
+    gl.clearColor(0, 0, 0, 0);
+    gl.clear(gl.COLOR_BUFFER_BIT);
+    layers.forEach((layer, i) => {
+      if (!layer.width) return;  // Nothing presented yet.
+      const cell_width = width / columns;
+      const cell_height = height / rows;
+      const scale = Math.min(cell_width / layer.width, cell_height / layer.height);
+      const left = (i % columns) * cell_width + (cell_width - layer.width * scale) / 2;
+      const top = Math.floor(i / columns) * cell_height + (cell_height - layer.height * scale) / 2;
+      gl.uniform4f(rect_location, left / width * 2 - 1, 1 - (top + layer.height * scale) / height * 2,
+        layer.width * scale / width * 2, layer.height * scale / height * 2);
+      gl.bindTexture(gl.TEXTURE_2D, layer.texture);
+      gl.drawArrays(gl.TRIANGLE_STRIP, 0, 4);
+    });
+  };
+
+  return {
+    /// Add a layer on top, for a window surface that renders to canvas.
+    add: (canvas) => {
+      const layer = { canvas: canvas, texture: gl.createTexture(), width: 0, height: 0, frame: null };
+      layers.push(layer);
+      damaged = true;
+      return layer;
+    },
+
+    /// Remove a layer (its surface has been destroyed).
+    remove: (layer) => {
+      const index = layers.indexOf(layer);
+      if (index < 0) return;
+      layers.splice(index, 1);
+      if (layer.frame) {
+        layer.frame.close();
+      }
+      gl.deleteTexture(layer.texture);
+      damaged = true;
+    },
+
+    /// Take the frame just rendered to the canvas of a layer, to be shown at the next display refresh. A frame that
+    /// has not been shown yet is dropped for it.
+    present: (layer) => {
+      if (layer.frame) {
+        layer.frame.close();
+      }
+      layer.frame = layer.canvas.transferToImageBitmap();
+      damaged = true;
+    },
+
+    /// Update the page canvas, if anything changed. Called once per display refresh.
+    compose: () => {
+      if (!damaged) return;
+      damaged = false;
+
+      const saved = STATE.map(([save]) => save());
+      try {
+        if (!program) {
+          setup();
+        }
+        gl.bindFramebuffer(gl.FRAMEBUFFER, null);
+        gl.bindBuffer(gl.PIXEL_UNPACK_BUFFER, null);
+        gl.pixelStorei(gl.UNPACK_FLIP_Y_WEBGL, false);
+        gl.pixelStorei(gl.UNPACK_PREMULTIPLY_ALPHA_WEBGL, true);  // Canvases have premultiplied alpha.
+        gl.pixelStorei(gl.UNPACK_ROW_LENGTH, 0);
+        gl.pixelStorei(gl.UNPACK_SKIP_ROWS, 0);
+        gl.pixelStorei(gl.UNPACK_SKIP_PIXELS, 0);
+        for (const layer of layers) {
+          if (layer.frame) {
+            upload(layer);
+          }
+        }
+
+        gl.useProgram(program);
+        gl.bindVertexArray(vertex_array);
+        for (const cap of [gl.SCISSOR_TEST, gl.DEPTH_TEST, gl.STENCIL_TEST, gl.CULL_FACE, gl.RASTERIZER_DISCARD]) {
+          gl.disable(cap);
+        }
+        gl.enable(gl.BLEND);
+        gl.blendFuncSeparate(gl.ONE, gl.ONE_MINUS_SRC_ALPHA, gl.ONE, gl.ONE_MINUS_SRC_ALPHA);
+        gl.blendEquationSeparate(gl.FUNC_ADD, gl.FUNC_ADD);
+        gl.colorMask(true, true, true, true);
+        draw();
+      } catch (error) {
+        log("[Graphics]: Error in compositor: " + error.message);
+      }
+      STATE.forEach(([, restore], i) => restore(saved[i]));
+    },
+  };
+};
@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/// Playback of GL traces recorded by wasm_gl_capture_end() (see gl_capture in linux-worker.js), shared by
+/// gl-replay.html and tools/gl-replay.js. Needs linux-graphics.js (and linux-softgl.js for the software backend, and
+/// linux-compositor.js for traces with EGL window surfaces).
+
+/// GL trace format, as written by wasm_gl_capture_end().
+const GL_TRACE_MAGIC = "GLTRACE1";
+const GL_TRACE_COMMAND = 1;
+const GL_TRACE_FLUSH = 2;
+const GL_TRACE_MESSAGE = 3;
+
+const GL_TRACE_RING_WORDS = 256 * 1024;
+const GL_TRACE_RING_HEAD = 0;
+const GL_TRACE_RING_HEADER_WORDS = 4;
+const GL_TRACE_REPLY_HEADER_BYTES = 16;
+
+const gl_trace_text_decoder = new TextDecoder();
+
+/// Split a trace into its command table (gl_commands of the Worker that recorded it) and its records.
+const gl_trace_parse = (buffer) => {
+  const bytes = new Uint8Array(buffer);
+  const view = new DataView(buffer);
+  if (bytes.length < 12 || gl_trace_text_decoder.decode(bytes.subarray(0, 8)) != GL_TRACE_MAGIC) {
+    throw new Error("Not a GL trace");
+  }
+
+  const table_length = view.getUint32(8, true);
+  const commands = JSON.parse(gl_trace_text_decoder.decode(bytes.subarray(12, 12 + table_length)));
+  const records = [];
+  for (let pos = 12 + ((table_length + 3) & ~3); pos < bytes.length;) {
+    const type = view.getUint32(pos, true);
+    const length = view.getUint32(pos + 4, true);
+    records.push({ type: type, data: bytes.subarray(pos + 8, pos + 8 + length) });
+    pos += 8 + ((length + 3) & ~3);
+  }
+  return { commands: commands, records: records };
+};
+
+/**
+ * A graphics host (linux-graphics.js) on canvas for traces to be played to, with options.backend as the graphics
+ * backend ("webgl" or "software"). Playing several traces to the same host is like running their programs one after
+ * the other (each connects as a task of its own, and is disconnected at the end), e.g. to see what a program that is
+ * started again finds in the caches of the host.
+ */
+const gl_trace_host = (canvas, options, log) => {
+  const graphics = {
+    canvas: canvas,
+    gl_backend: options.backend || "webgl",
+    contexts: new Map(),
+    surfaces: new Map(),
+    shaders: new Map(),
+    programs: new Map(),
+    buffers: new Map(),
+    textures: new Map(),
+    vertexArrays: new Map(),
+    framebuffers: new Map(),
+    renderbuffers: new Map(),
+    uniformLocations: new Map(),
+    names: new Int32Array(8),
+    vblank: new Int32Array(1),
+  };
+  const memory = new WebAssembly.Memory({ initial: 16, maximum: 0x10000 });
+  return { graphics: graphics, memory: memory, host: linux_graphics(graphics, memory, log, () => { }), tasks: 0 };
+};
+
+/**
+ * Play a trace to the graphics host (options.host from gl_trace_host(), or a new one on canvas), just like a task
+ * Worker would: commands are written to a
+ * command ring that is drained on each flush, and messages are handed to the host as is. Data uploaded by the
+ * commands (m arguments) is copied to a scratch memory that stands in for the Wasm memory of the task. Memory written
+ * by the host (w arguments, e.g. pixel readbacks) is not needed afterwards, so all of it shares one area at the start.
+ *
+ * Frame times are measured from the end of one eglSwapBuffers to the end of the next, and only include the time
+ * spent here (unless finish is set, which waits for the GPU at the end of each frame). With present set, each frame is
+ * given a display refresh to show up, outside of the measured time. options.backend picks the graphics backend of a
+ * new host (see gl_trace_host()), and options.on_frame(index, gl), if set, is called after each frame
+ * (also outside of the measured time), e.g. to read back the rendered image.
+ */
+const gl_trace_replay = async (trace, canvas, options, log) => {
+  const target = options.host || gl_trace_host(canvas, options, log);
+  const { graphics, memory, host } = target;
+  const task = ++target.tasks;
+
+  // Stand in for the MessagePort of a task Worker. Messages are delivered synchronously, so no SharedArrayBuffers
+  // (and no cross-origin isolation) are needed for the ring and the reply mailbox.
+  const port = { postMessage: () => { }, close: () => { } };
+  host.connect(task, port);
+  const send = (message) => port.onmessage({ data: message });
+
+  const ring = new Int32Array(GL_TRACE_RING_HEADER_WORDS + GL_TRACE_RING_WORDS);
+  send({ method: "graphics_gl_ring_init", ring: ring, commands: trace.commands });
+  send({ method: "graphics_gl_reply_init", reply: new Int32Array(GL_TRACE_REPLY_HEADER_BYTES / 4 + 256 * 1024) });
+
+  let head = 0;
+  let discard = 0;  // Size of the area at the start of the scratch memory that the host writes to.
+  let scratch = 0;  // Scratch memory in use by commands not executed yet (after the discard area).
+  const flush = () => {
+    send({ method: "graphics_gl_flush" });
+    scratch = discard;
+  };
+  const reserve = (end) => {
+    if (end > memory.buffer.byteLength) {
+      memory.grow(Math.ceil((end - memory.buffer.byteLength) / 65536));
+    }
+  };
+
+  let draws = 0;
+  let uploaded = 0;
+  const write_command = (data) => {
+    const words = new Int32Array(data.buffer, data.byteOffset, data.byteLength / 4);
+    const command = trace.commands[words[0]];
+    const regions = [];
+    const discards = [];
+    let length = 1;
+    for (const type of command.args) {
+      if (type == "F") {
+        length += 1 + words[length];
+      } else if (type == "m") {
+        regions.push(length);
+        length += 2;
+      } else if (type == "w") {
+        const size = words[length + 1] >>> 0;
+        if (size > discard) {
+          // Grow the discard area over the scratch memory, once the commands reading from it have been executed.
+          flush();
+          discard = (size + 15) & ~15;
+          reserve(discard);
+          scratch = discard;
+        }
+        discards.push(length);
+        length += 2;
+      } else {
+        length++;
+      }
+    }
+    if (command.func_name.startsWith("draw")) {
+      draws++;
+    }
+
+    if (head + length >= GL_TRACE_RING_WORDS) {
+      // Drain the ring and continue from its start.
+      flush();
+      ring[GL_TRACE_RING_HEADER_WORDS + head] = 0;
+      head = 0;
+    }
+
+    const pos = GL_TRACE_RING_HEADER_WORDS + head;
+    ring.set(words.subarray(0, length), pos);
+    for (const region of discards) {
+      ring[pos + region] = 0;
+    }
+    let offset = length * 4;
+    for (const region of regions) {
+      const size = ring[pos + region + 1] >>> 0;
+      reserve(scratch + size);
+      new Uint8Array(memory.buffer, scratch, size).set(data.subarray(offset, offset + size));
+      ring[pos + region] = scratch;
+      scratch += (size + 15) & ~15;
+      offset += (size + 3) & ~3;
+      uploaded += size;
+    }
+    head += length;
+    ring[GL_TRACE_RING_HEAD] = head;
+  };
+
+  const frame_times = [];
+  let calls = 0;
+  let bytes = 0;
+  let busy = 0;
+  let start = performance.now();
+  for (const record of trace.records) {
+    if (record.type == GL_TRACE_COMMAND) {
+      write_command(record.data);
+      calls++;
+      bytes += record.data.length;
+    } else if (record.type == GL_TRACE_FLUSH) {
+      flush();
+    } else if (record.type == GL_TRACE_MESSAGE) {
+      const message = JSON.parse(gl_trace_text_decoder.decode(record.data));
+      send(message);
+      calls++;
+
+      if (message.method == "graphics_swap_buffers") {
+        if (options.finish && graphics.gl) {
+          graphics.gl.finish();
+        }
+        const now = performance.now();
+        frame_times.push(now - start);
+        busy += now - start;
+
+        if (options.on_frame) {
+          options.on_frame(frame_times.length - 1, graphics.gl);
+        }
+        if (options.present) {
+          await new Promise((resolve) => requestAnimationFrame(resolve));
+        } else if (frame_times.length % 60 == 0) {
+          await new Promise((resolve) => setTimeout(resolve, 0));  // Keep the page responsive.
+        }
+        start = performance.now();
+      }
+    }
+  }
+  flush();
+  busy += performance.now() - start;
+  host.disconnect(task);
+
+  return { frame_times: frame_times, calls: calls, draws: draws, bytes: bytes, uploaded: uploaded, busy: busy };
+};
+
+const gl_trace_report = (result) => {
+  const sorted = result.frame_times.slice().sort((a, b) => a - b);
+  const frames = sorted.length;
+  const percentile = (p) => frames ? sorted[Math.min(frames - 1, Math.floor(frames * p))] : 0;
+  const average = frames ? sorted.reduce((sum, time) => sum + time, 0) / frames : 0;
+
+  const megabytes = result.bytes / (1024 * 1024);
+  const seconds = result.busy / 1000;
+
+  return [
+    frames + " frames, " + result.calls + " calls, " + result.draws + " draw calls, " + megabytes.toFixed(1) +
+    " MB of commands",
+    "Frame time: " + average.toFixed(2) + " ms average, " + percentile(0.5).toFixed(2) + " ms median, " +
+    percentile(0.95).toFixed(2) + " ms 95th percentile, " + percentile(1).toFixed(2) + " ms max",
+    "Calls per second: " + Math.round(result.calls / seconds) + ", draw calls per second: " +
+    Math.round(result.draws / seconds),
+    "Uploads: " + (result.uploaded / (1024 * 1024)).toFixed(1) + " MB, " +
+    (result.uploaded / (1024 * 1024) / seconds).toFixed(1) + " MB/s",
+  ].join("\n");
+};
@@ -0,0 +1,1277 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/**
+ * Serve the graphics (EGL/OpenGL ES) requests of Linux/Wasm tasks with WebGL.
+ *
+ * This normally runs in a dedicated render worker (linux-render-worker.js) that owns the canvas as an OffscreenCanvas,
+ * so that heavy frames do not hold up the page's main thread, which has to service console I/O and task switches for
+ * the whole machine. If OffscreenCanvas is not available, it runs on the main thread instead (see linux.js). Either
+ * way, each task Worker talks to it over its own MessagePort, handed over with connect().
+ *
+ * graphics is the registry from index.html (null if there is no canvas), memory the shared Wasm memory, log() writes to
+ * the console, and show() makes the canvas visible (once a task initializes graphics). With graphics.gl_backend set to
+ * "software", WebGL is replaced by the CPU renderer in linux-softgl.js (e.g. to run without a GPU).
+ */
+const linux_graphics = (graphics, memory, log, show) => {
+  const text_encoder = new TextEncoder();
+
+  /// Create a WebGL context (or a software one, see above) on a canvas. Returns null if that is not possible.
+  const gl_create = (canvas) => {
+    const gl = graphics.gl_backend == "software"
+      ? linux_softgl(canvas) : canvas.getContext("webgl2") || canvas.getContext("webgl");
+    if (gl) {
+      // Compressed texture formats are only accepted (and listed in COMPRESSED_TEXTURE_FORMATS, where tasks look for
+      // them) once their extension has been enabled.
+      for (const name of ["WEBGL_compressed_texture_s3tc", "WEBGL_compressed_texture_s3tc_srgb",
+        "WEBGL_compressed_texture_etc", "WEBGL_compressed_texture_etc1", "WEBGL_compressed_texture_astc"]) {
+        gl.getExtension(name);
+      }
+    }
+    return gl;
+  };
+
+  if (graphics) {
+    graphics.gl = gl_create(graphics.canvas);
+    if (graphics.gl) {
+      log(graphics.gl_backend == "software"
+        ? "Software GL renderer initialized" : "WebGL context initialized successfully");
+    } else {
+      log("Warning: WebGL not available, graphics features disabled");
+    }
+  }
+
+  /**
+   * A GL device: a WebGL context and the canvas it is tied to, with what outlives the GL contexts that render with it,
+   * which is the program cache (see GL_PROGRAM_CACHE_SIZE) and the shaders known to compile. That of the page canvas
+   * lives as long as the page. Others are created for the surface a context is first made current with, and once
+   * neither is used any more, the device is kept for the next surface (up to GL_DEVICES_IDLE of them): WebGL objects
+   * can not be shared between WebGL contexts, so this is what lets a program that is started again, e.g. in a window
+   * of its own, find its programs in the cache.
+   */
+  const GL_DEVICES_IDLE = 2;
+  const gl_devices = new WeakMap();  // Canvas -> device
+  const gl_devices_idle = [];
+
+  const gl_device_new = (canvas, gl) => {
+    const device = {
+      canvas: canvas,
+      gl: gl,
+      shaders_compiled: new Set(),
+      program_cache: new Map(),
+      program_cache_size: 0,
+    };
+    gl_devices.set(canvas, device);
+    return device;
+  };
+
+  /// The device of a canvas, created (with a WebGL context) on first use. Returns null if that is not possible.
+  const gl_device_get = (canvas) => {
+    const device = gl_devices.get(canvas);
+    if (device) {
+      return device;
+    }
+    const gl = gl_create(canvas);
+    return gl ? gl_device_new(canvas, gl) : null;
+  };
+
+  /// Keep a device that is not used any more for the next surface, losing the oldest one beyond GL_DEVICES_IDLE.
+  const gl_device_park = (device) => {
+    if (device.gl === graphics.gl || gl_devices_idle.includes(device)) return;
+    gl_devices_idle.push(device);
+    if (gl_devices_idle.length > GL_DEVICES_IDLE) {
+      const lose_context = gl_devices_idle.shift().gl.getExtension("WEBGL_lose_context");
+      if (lose_context) {
+        lose_context.loseContext();  // Rather than waiting for garbage collection, browsers only allow a few.
+      }
+    }
+  };
+
+  /// Take an idle device for a new surface of the given size (null if there is none), its GL state back to the
+  /// defaults that a new context starts with. The cache and the objects in it are all that is left of its last use.
+  const gl_device_take = (width, height) => {
+    const device = gl_devices_idle.pop();
+    if (!device) {
+      return null;
+    }
+    const canvas = device.canvas;
+    const gl = device.gl;
+    canvas.width = width;
+    canvas.height = height;
+
+    gl.useProgram(null);
+    if (gl.bindVertexArray) {
+      gl.bindVertexArray(null);
+    }
+    for (let i = 0; i < gl.getParameter(gl.MAX_VERTEX_ATTRIBS); i++) {
+      gl.disableVertexAttribArray(i);
+    }
+    gl.bindBuffer(gl.ARRAY_BUFFER, null);
+    gl.bindBuffer(gl.ELEMENT_ARRAY_BUFFER, null);
+    gl.bindFramebuffer(gl.FRAMEBUFFER, null);
+    gl.bindRenderbuffer(gl.RENDERBUFFER, null);
+    gl.activeTexture(gl.TEXTURE0);
+    gl.bindTexture(gl.TEXTURE_2D, null);
+    gl.bindTexture(gl.TEXTURE_CUBE_MAP, null);
+    for (const cap of [gl.BLEND, gl.CULL_FACE, gl.DEPTH_TEST, gl.POLYGON_OFFSET_FILL, gl.SCISSOR_TEST, gl.STENCIL_TEST]) {
+      gl.disable(cap);
+    }
+    gl.blendFunc(gl.ONE, gl.ZERO);
+    gl.blendEquation(gl.FUNC_ADD);
+    gl.clearColor(0, 0, 0, 0);
+    gl.clearDepth(1);
+    gl.colorMask(true, true, true, true);
+    gl.depthFunc(gl.LESS);
+    gl.depthMask(true);
+    gl.cullFace(gl.BACK);
+    gl.frontFace(gl.CCW);
+    gl.pixelStorei(gl.PACK_ALIGNMENT, 4);
+    gl.pixelStorei(gl.UNPACK_ALIGNMENT, 4);
+    gl.viewport(0, 0, width, height);
+    return device;
+  };
+
+  /**
+   * A GL context: its WebGL context (of its device), the WebGL objects bound to the names used in it (shaders, programs, buffers, ...
+   * maps like those of the registry in index.html), and what we keep track of about them. Names are allocated from
+   * counters shared by all contexts, so a name is never used by two contexts, but each context only sees its own
+   * objects. Contexts created with eglCreateContext() get their WebGL context when they are first made current with a
+   * surface (and render to that surface only); tasks that never make one current use the default context, which is
+   * that of the page canvas and the object maps of the registry.
+   */
+  const gl_context_new = (device, objects) => {
+    const context = {
+      device: null,
+      gl: null,
+      surface: null,  // Surface the context renders to (see graphics_egl_make_current)
+      nextUniformLocationId: 1,
+      program_locations: new Map(),  // See gl_program_locations_get()
+      shader_state: new Map(),  // See GL_PROGRAM_CACHE_SIZE
+      program_state: new Map(),
+      parallel_compile: false,
+      instancing: undefined,  // See gl_instancing()
+      vertex_arrays: undefined,  // See gl_vertex_arrays()
+      readback_buffers: [],  // See gl_readbacks
+    };
+    for (const map of ["shaders", "programs", "buffers", "textures", "vertexArrays", "framebuffers", "renderbuffers",
+      "uniformLocations"]) {
+      context[map] = objects ? objects[map] : new Map();
+    }
+    gl_context_attach(context, device);
+    return context;
+  };
+
+  /// Give a context its device (and so its WebGL context).
+  const gl_context_attach = (context, device) => {
+    const gl = device && device.gl;
+    context.device = device;
+    context.gl = gl;
+    // With KHR_parallel_shader_compile, compiles and links run in the background, and COMPLETION_STATUS_KHR can be
+    // queried without waiting for them. Enabling the extension is all it takes.
+    context.parallel_compile = !!(gl && gl.getExtension("KHR_parallel_shader_compile"));
+  };
+
+  const gl_default_context = gl_context_new(graphics && graphics.gl && gl_device_new(graphics.canvas, graphics.gl),
+    graphics);
+
+  /// The context that GL commands and queries go to: that of the task being served (see connect()).
+  let gl_context = gl_default_context;
+
+  /// requestAnimationFrame is available in Workers that render to an OffscreenCanvas in most, but not all, browsers.
+  const animation_frame = globalThis.requestAnimationFrame
+    ? globalThis.requestAnimationFrame.bind(globalThis)
+    : (callback) => setTimeout(callback, 1000 / 60);
+
+  /// The compositor that shows the window surfaces on the page canvas (see linux-compositor.js). It needs WebGL2 and
+  /// OffscreenCanvas; without them (or with the software renderer), the first window surface is the page canvas itself
+  /// and others are not shown.
+  const compositor = graphics && graphics.gl_backend != "software" && graphics.gl && graphics.gl.createVertexArray &&
+    typeof OffscreenCanvas !== "undefined" ? linux_compositor(graphics.gl, log) : null;
+
+  /// Whether the requestAnimationFrame loop driving graphics.vblank (and the compositor) has been started, on the first
+  /// graphics_init or window surface.
+  let vblank_running = false;
+
+  const vblank_start = () => {
+    if (!graphics || vblank_running) return;
+    // Count display refreshes for the Workers to pace eglSwapBuffers on.
+    vblank_running = true;
+    const vblank = () => {
+      if (compositor) {
+        compositor.compose();
+      }
+      Atomics.add(graphics.vblank, 0, 1);
+      Atomics.notify(graphics.vblank, 0);
+      animation_frame(vblank);
+    };
+    animation_frame(vblank);
+  };
+
+  /// GL command rings of Workers that use graphics (task port -> ring state). See gl_ring_reserve() in linux-worker.js.
+  const gl_rings = new WeakMap();
+  const GL_RING_HEAD = 0;
+  const GL_RING_TAIL = 1;
+  const GL_RING_FENCE = 2;
+  const GL_RING_LINKED = 3;
+  const GL_RING_HEADER_WORDS = 4;
+
+  /// Reply mailboxes of Workers for blocking GL queries (task port -> Int32Array). See gl_query() in linux-worker.js.
+  const gl_replies = new WeakMap();
+  const GL_REPLY_STATUS = 0;
+  const GL_REPLY_SCALAR = 1;
+  const GL_REPLY_LENGTH = 2;
+  const GL_REPLY_HEADER_BYTES = 16;
+
+  /// Answer the pending query of a Worker with a scalar result and an optional payload (Uint8Array). A payload that
+  /// does not fit is only reported by its length, the Worker will provide a larger mailbox and ask again.
+  const gl_reply = (port, scalar, payload) => {
+    const reply = gl_replies.get(port);
+    const length = payload ? payload.length : 0;
+    if (length && length <= reply.byteLength - GL_REPLY_HEADER_BYTES) {
+      new Uint8Array(reply.buffer, GL_REPLY_HEADER_BYTES, length).set(payload);
+    }
+    reply[GL_REPLY_SCALAR] = scalar;
+    reply[GL_REPLY_LENGTH] = length;
+    Atomics.store(reply, GL_REPLY_STATUS, 1);
+    Atomics.notify(reply, GL_REPLY_STATUS, 1);
+  };
+
+  /// GL query results are GLint: booleans become 0/1, numbers are passed as is, anything else (objects, null) is 0.
+  const gl_reply_int = (result) => {
+    return typeof result === "number" ? result : (result ? 1 : 0);
+  };
+
+  /// Look up the WebGL object bound to a name allocated by a Worker. If there is none yet, it is created on the fly
+  /// with create() (if given), just like binding an unused name creates the object in GL.
+  const gl_object = (objects, name, create) => {
+    if (!name) return null;
+    let object = objects.get(name);
+    if (!object && create && gl_context.gl) {
+      object = create.call(gl_context.gl);
+      objects.set(name, object);
+    }
+    return object || null;
+  };
+
+  /// Map a GL object ID from a command ring argument to the WebGL object it names.
+  const gl_ring_object = (type, id) => {
+    switch (type) {
+      case "s": return gl_object(gl_context.shaders, id);
+      case "p": return gl_object(gl_context.programs, id);
+      case "b": return gl_object(gl_context.buffers, id, gl_context.gl && gl_context.gl.createBuffer);
+      case "t": return gl_object(gl_context.textures, id, gl_context.gl && gl_context.gl.createTexture);
+      case "u": return gl_object(gl_context.uniformLocations, id);
+      default: throw new Error("Unknown GL command argument type " + type);
+    }
+  };
+
+  /// Active uniform and attribute locations of linked programs (program ID -> { uniforms: {name: location ID},
+  /// attributes: {name: location} }), in gl_context.program_locations. Uniform location IDs stay stable until the
+  /// program is relinked or deleted.
+  const gl_program_locations_get = (program_id) => {
+    let locations = gl_context.program_locations.get(program_id);
+    if (locations) {
+      return locations;
+    }
+
+    locations = { uniforms: {}, attributes: {} };
+    const gl = gl_context.gl;
+    const program = gl_context.programs.get(program_id);
+    if (program && gl.getProgramParameter(program, gl.LINK_STATUS)) {
+      // Array uniforms are reported once as "name[0]", but each element has its own location, and "name" is an
+      // alias for "name[0]".
+      const uniform_count = gl.getProgramParameter(program, gl.ACTIVE_UNIFORMS);
+      for (let i = 0; i < uniform_count; i++) {
+        const info = gl.getActiveUniform(program, i);
+        if (!info) continue;
+        const is_array = info.name.endsWith("[0]");
+        const base = is_array ? info.name.slice(0, -3) : info.name;
+        for (let element = 0; element < (is_array ? info.size : 1); element++) {
+          const name = is_array ? base + "[" + element + "]" : base;
+          const location = gl.getUniformLocation(program, name);
+          if (!location) continue;
+          const id = gl_context.nextUniformLocationId++;
+          gl_context.uniformLocations.set(id, location);
+          locations.uniforms[name] = id;
+          if (is_array && element == 0) {
+            locations.uniforms[base] = id;
+          }
+        }
+      }
+
+      const attribute_count = gl.getProgramParameter(program, gl.ACTIVE_ATTRIBUTES);
+      for (let i = 0; i < attribute_count; i++) {
+        const info = gl.getActiveAttrib(program, i);
+        if (!info) continue;
+        locations.attributes[info.name] = gl.getAttribLocation(program, info.name);
+      }
+    }
+
+    gl_context.program_locations.set(program_id, locations);
+    return locations;
+  };
+
+  /// Forget the locations of a program (they become invalid when it is relinked or deleted).
+  const gl_program_locations_invalidate = (program_id) => {
+    const locations = gl_context.program_locations.get(program_id);
+    if (locations) {
+      for (const id of Object.values(locations.uniforms)) {
+        gl_context.uniformLocations.delete(id);
+      }
+      gl_context.program_locations.delete(program_id);
+    }
+  };
+
+  /// Shader and program state of a context:
+  /// - shader_state: shaders by name ({ object, type, source, pending, deleted }). Compiles are deferred until they are
+  ///   needed: by a link that misses the program cache, or by a status query. Shaders of a program found in the cache
+  ///   are never compiled. The WebGLShader of a deleted shader is kept until no program has it attached, as it can not
+  ///   be compiled any more.
+  /// - shaders_compiled (of the device): source keys (gl_source_key) of shaders known to compile, so that status
+  ///   queries need not compile them.
+  /// - program_state: programs by name ({ shaders, key, sources, placeholder }): the shaders (records from
+  ///   shader_state) attached to them, and what they were last linked from. placeholder is the program's own
+  ///   WebGLProgram while it uses one taken from the cache.
+  /// - program_cache (of the device): linked programs that no task uses any more, by the key of their sources (key ->
+  ///   [{ program, sources }]). A link of the same sources takes one instead of compiling and linking again, which
+  ///   mostly helps programs that are started again (their objects are released here when their task exits, and the
+  ///   device outlives their contexts).
+  const GL_PROGRAM_CACHE_SIZE = 64;
+
+  const GL_COMPILE_STATUS = 0x8B81;
+  const GL_COMPLETION_STATUS_KHR = 0x91B1;
+  const GL_NUM_COMPRESSED_TEXTURE_FORMATS = 0x86A2;  // Not in WebGL, which only has the list.
+  const GL_COMPRESSED_TEXTURE_FORMATS = 0x86A3;
+
+  /// Hash shader sources to a short string (two 32-bit FNV-1a style hashes). Cache hits still compare the sources.
+  const gl_source_key = (sources) => {
+    let a = 0x811C9DC5;
+    let b = 0x2C1B3C6D;
+    for (const source of sources) {
+      for (let i = 0; i < source.length; i++) {
+        const c = source.charCodeAt(i);
+        a = Math.imul(a ^ c, 0x01000193);
+        b = Math.imul(b ^ c, 0x5BD1E995);
+      }
+      a = Math.imul(a ^ 0xFFFF, 0x01000193);
+      b = Math.imul(b ^ 0xFFFF, 0x5BD1E995);
+    }
+    return (a >>> 0).toString(16).padStart(8, "0") + (b >>> 0).toString(16).padStart(8, "0");
+  };
+
+  /// Source of a shader as part of a program key.
+  const gl_shader_source = (shader) => shader.type + "\n" + shader.source;
+
+  const gl_shader_key = (shader) => gl_source_key([gl_shader_source(shader)]);
+
+  /// Run the compile of a shader that was asked for but deferred.
+  const gl_shader_compile = (shader) => {
+    if (shader && shader.pending) {
+      shader.pending = false;
+      gl_context.gl.compileShader(shader.object);
+    }
+  };
+
+  /// Whether a shader, compile pending, is known to compile (so that there is no need to compile it to say so).
+  const gl_shader_known_good = (shader) =>
+    shader && shader.pending && gl_context.device.shaders_compiled.has(gl_shader_key(shader));
+
+  /// Delete the WebGLShader of a deleted shader once no program has it attached.
+  const gl_shader_forget = (shader) => {
+    if (!shader.deleted) return;
+    for (const program of gl_context.program_state.values()) {
+      if (program.shaders.has(shader)) return;
+    }
+    gl_context.gl.deleteShader(shader.object);
+  };
+
+  const gl_program_state_get = (name) => {
+    let program = gl_context.program_state.get(name);
+    if (!program) {
+      program = { shaders: new Set(), key: null, sources: null, placeholder: null };
+      gl_context.program_state.set(name, program);
+    }
+    return program;
+  };
+
+  /// Take a linked program with exactly these sources from the cache (null if there is none). A deleted program that is
+  /// still current can still be drawn with, just like GL only deletes it once it is no longer in use.
+  const gl_program_cache_take = (key, sources) => {
+    const entries = gl_context.device.program_cache.get(key);
+    const current = gl_context.gl.getParameter(gl_context.gl.CURRENT_PROGRAM);
+    const index = entries ? entries.findIndex((entry) => entry.program !== current &&
+      entry.sources.length == sources.length && entry.sources.every((source, i) => source == sources[i])) : -1;
+    if (index < 0) {
+      return null;
+    }
+    const program = entries.splice(index, 1)[0].program;
+    if (!entries.length) {
+      gl_context.device.program_cache.delete(key);
+    }
+    gl_context.device.program_cache_size--;
+    return program;
+  };
+
+  /// Keep a linked program for a later link of the same sources. The oldest entries are deleted beyond the cache size.
+  const gl_program_cache_put = (key, sources, program) => {
+    const entries = gl_context.device.program_cache.get(key) || [];
+    entries.push({ program: program, sources: sources });
+    gl_context.device.program_cache.set(key, entries);
+    gl_context.device.program_cache_size++;
+
+    while (gl_context.device.program_cache_size > GL_PROGRAM_CACHE_SIZE) {
+      const [oldest_key, oldest] = gl_context.device.program_cache.entries().next().value;
+      gl_context.gl.deleteProgram(oldest.shift().program);
+      if (!oldest.length) {
+        gl_context.device.program_cache.delete(oldest_key);
+      }
+      gl_context.device.program_cache_size--;
+    }
+  };
+
+  /// A program taken from the cache keeps the uniform values of its last user, but a link resets them to zero.
+  const gl_program_reset_uniforms = (program) => {
+    const gl = gl_context.gl;
+    const current = gl.getParameter(gl.CURRENT_PROGRAM);
+    gl.useProgram(program);
+
+    const count = gl.getProgramParameter(program, gl.ACTIVE_UNIFORMS);
+    for (let i = 0; i < count; i++) {
+      const info = gl.getActiveUniform(program, i);
+      const location = info && gl.getUniformLocation(program, info.name);
+      if (!location) continue;
+      switch (info.type) {
+        case gl.FLOAT: gl.uniform1fv(location, new Float32Array(info.size)); break;
+        case gl.FLOAT_VEC2: gl.uniform2fv(location, new Float32Array(2 * info.size)); break;
+        case gl.FLOAT_VEC3: gl.uniform3fv(location, new Float32Array(3 * info.size)); break;
+        case gl.FLOAT_VEC4: gl.uniform4fv(location, new Float32Array(4 * info.size)); break;
+        case gl.INT_VEC2: case gl.BOOL_VEC2: gl.uniform2iv(location, new Int32Array(2 * info.size)); break;
+        case gl.INT_VEC3: case gl.BOOL_VEC3: gl.uniform3iv(location, new Int32Array(3 * info.size)); break;
+        case gl.INT_VEC4: case gl.BOOL_VEC4: gl.uniform4iv(location, new Int32Array(4 * info.size)); break;
+        case gl.FLOAT_MAT2: gl.uniformMatrix2fv(location, false, new Float32Array(4 * info.size)); break;
+        case gl.FLOAT_MAT3: gl.uniformMatrix3fv(location, false, new Float32Array(9 * info.size)); break;
+        case gl.FLOAT_MAT4: gl.uniformMatrix4fv(location, false, new Float32Array(16 * info.size)); break;
+        default: gl.uniform1iv(location, new Int32Array(info.size)); break;  // int, bool and samplers
+      }
+    }
+
+    gl.useProgram(current);
+  };
+
+  /// Link a program, or take a program linked from the same sources from the cache instead.
+  const gl_program_link = (name) => {
+    const gl = gl_context.gl;
+    const program = gl_program_state_get(name);
+
+    // A program taken from the cache goes back to it, and the program's own WebGLProgram is linked after all.
+    if (program.placeholder) {
+      const cached = gl_context.programs.get(name);
+      const current = gl.getParameter(gl.CURRENT_PROGRAM) === cached;
+      gl_context.programs.set(name, program.placeholder);
+      program.placeholder = null;
+      gl_program_cache_put(program.key, program.sources, cached);
+      if (current) {
+        gl.useProgram(gl_context.programs.get(name));
+      }
+    }
+
+    const shaders = [...program.shaders];
+    program.sources = shaders.sort((a, b) => a.type - b.type).map(gl_shader_source);
+    program.key = gl_source_key(program.sources);
+
+    const cached = gl_program_cache_take(program.key, program.sources);
+    if (cached) {
+      const own = gl_object(gl_context.programs, name);
+      const current = gl.getParameter(gl.CURRENT_PROGRAM) === own;
+      gl_program_reset_uniforms(cached);
+      program.placeholder = own;
+      gl_context.programs.set(name, cached);
+      if (current) {
+        gl.useProgram(cached);
+      }
+      return;
+    }
+
+    for (const shader of program.shaders) {
+      gl_shader_compile(shader);
+    }
+    gl.linkProgram(gl_object(gl_context.programs, name));
+  };
+
+  /// Release a program that is deleted, or whose task has exited: if it linked, it goes to the cache for a later link
+  /// of the same sources.
+  const gl_program_release = (name) => {
+    const gl = gl_context.gl;
+    const program = gl_context.program_state.get(name);
+    const object = gl_context.programs.get(name);
+    gl_program_locations_invalidate(name);
+    gl_context.program_state.delete(name);
+    gl_context.programs.delete(name);
+    if (program) {
+      program.shaders.forEach(gl_shader_forget);
+      if (program.placeholder) {
+        gl.deleteProgram(program.placeholder);
+      }
+    }
+    if (!object) return;
+
+    if (!program || !program.key || !gl.getProgramParameter(object, gl.LINK_STATUS)) {
+      gl.deleteProgram(object);
+      return;
+    }
+
+    for (const source of program.sources) {
+      gl_context.device.shaders_compiled.add(gl_source_key([source]));
+    }
+    gl_program_cache_put(program.key, program.sources, object);
+  };
+
+  /// Delete the WebGL object bound to a name (if any was ever created) and unbind the name.
+  const gl_object_delete = (objects, name, destroy) => {
+    const object = objects.get(name);
+    if (object) {
+      destroy.call(gl_context.gl, object);
+      objects.delete(name);
+    }
+  };
+
+  /// WebGL wants pixel data in a typed array matching the pixel type. Returns null for no data (allocation only).
+  const gl_pixel_view = (type, pixels) => {
+    if (!pixels.byteLength) {
+      return null;
+    }
+    switch (type) {
+      case 0x1406: // GL_FLOAT
+        return new Float32Array(pixels.buffer, pixels.byteOffset, pixels.byteLength / 4);
+      case 0x8363: // GL_UNSIGNED_SHORT_5_6_5
+      case 0x8033: // GL_UNSIGNED_SHORT_4_4_4_4
+      case 0x8034: // GL_UNSIGNED_SHORT_5_5_5_1
+      case 0x8D61: // GL_HALF_FLOAT_OES
+        return new Uint16Array(pixels.buffer, pixels.byteOffset, pixels.byteLength / 2);
+      default:
+        return pixels;
+    }
+  };
+
+  /// Instanced drawing entry points: WebGL2 has them built in, WebGL1 needs ANGLE_instanced_arrays. Null if neither.
+  const gl_instancing = () => {
+    if (gl_context.instancing === undefined) {
+      const gl = gl_context.gl;
+      const ext = gl.drawArraysInstanced ? null : gl.getExtension("ANGLE_instanced_arrays");
+      if (gl.drawArraysInstanced) {
+        gl_context.instancing = {
+          drawArraysInstanced: gl.drawArraysInstanced.bind(gl),
+          drawElementsInstanced: gl.drawElementsInstanced.bind(gl),
+          vertexAttribDivisor: gl.vertexAttribDivisor.bind(gl),
+        };
+      } else if (ext) {
+        gl_context.instancing = {
+          drawArraysInstanced: ext.drawArraysInstancedANGLE.bind(ext),
+          drawElementsInstanced: ext.drawElementsInstancedANGLE.bind(ext),
+          vertexAttribDivisor: ext.vertexAttribDivisorANGLE.bind(ext),
+        };
+      } else {
+        log("[Graphics]: Instanced drawing is not supported by this browser");
+        gl_context.instancing = null;
+      }
+    }
+    return gl_context.instancing;
+  };
+
+  /// Vertex array object entry points: WebGL2 has them built in, WebGL1 needs OES_vertex_array_object. Null if neither.
+  const gl_vertex_arrays = () => {
+    if (gl_context.vertex_arrays === undefined) {
+      const gl = gl_context.gl;
+      const ext = gl.createVertexArray ? null : gl.getExtension("OES_vertex_array_object");
+      if (gl.createVertexArray) {
+        gl_context.vertex_arrays = {
+          createVertexArray: gl.createVertexArray.bind(gl),
+          bindVertexArray: gl.bindVertexArray.bind(gl),
+          deleteVertexArray: gl.deleteVertexArray.bind(gl),
+        };
+      } else if (ext) {
+        gl_context.vertex_arrays = {
+          createVertexArray: ext.createVertexArrayOES.bind(ext),
+          bindVertexArray: ext.bindVertexArrayOES.bind(ext),
+          deleteVertexArray: ext.deleteVertexArrayOES.bind(ext),
+        };
+      } else {
+        log("[Graphics]: Vertex array objects are not supported by this browser");
+        gl_context.vertex_arrays = null;
+      }
+    }
+    return gl_context.vertex_arrays;
+  };
+
+  /// Asynchronous pixel readbacks (wasm_gl_read_pixels_async()) in flight, oldest first. On WebGL2, the pixels are
+  /// copied into a pixel buffer object on the GPU, and only fetched into Wasm memory once a fence after the copy has
+  /// been signaled, so that neither we nor the Worker wait for the GPU to catch up. Each readback is { state (of the
+  /// ring it came from), context, sync, buffer, start and size (of the pixels in Wasm memory), done (completion word
+  /// offset) }. Each context keeps a few pixel buffer objects for reuse ({ object, capacity } in readback_buffers).
+  const gl_readbacks = [];
+  const GL_READBACK_BUFFERS = 4;
+  let gl_readback_timer = null;
+
+  /// Tell the Worker that a readback has landed in Wasm memory, by setting its completion word.
+  const gl_readback_signal = (done) => {
+    const memory_i32 = new Int32Array(memory.buffer);
+    Atomics.store(memory_i32, done / 4, 1);
+    Atomics.notify(memory_i32, done / 4);
+  };
+
+  const gl_readback_release = (readback) => {
+    const gl = readback.context.gl;
+    gl.deleteSync(readback.sync);
+    if (readback.context.readback_buffers.length < GL_READBACK_BUFFERS) {
+      readback.context.readback_buffers.push(readback.buffer);
+    } else {
+      gl.deleteBuffer(readback.buffer.object);
+    }
+  };
+
+  /// Fetch the readbacks whose fences have been signaled (in order), and check again shortly if any are left.
+  const gl_readback_poll = () => {
+    gl_readback_timer = null;
+    while (gl_readbacks.length) {
+      const gl = gl_readbacks[0].context.gl;
+      if (gl.getSyncParameter(gl_readbacks[0].sync, gl.SYNC_STATUS) != gl.SIGNALED) break;
+      const readback = gl_readbacks.shift();
+      try {
+        gl.bindBuffer(gl.PIXEL_PACK_BUFFER, readback.buffer.object);
+        gl.getBufferSubData(gl.PIXEL_PACK_BUFFER, 0, new Uint8Array(memory.buffer, readback.start, readback.size));
+        gl.bindBuffer(gl.PIXEL_PACK_BUFFER, null);
+      } catch (error) {
+        log("[Graphics]: Error in readPixels: " + error.message);
+      }
+      gl_readback_release(readback);
+      gl_readback_signal(readback.done);
+    }
+    if (gl_readbacks.length && !gl_readback_timer) {
+      gl_readback_timer = setTimeout(gl_readback_poll, 1);
+    }
+  };
+
+  /// Ring commands that are handled here rather than forwarded to WebGL as is (looked up by command name).
+  const gl_ring_host_commands = {
+    fence: (state, fence) => {
+      // Everything before the fence has been executed (and any Wasm memory it referenced has been read).
+      Atomics.store(state.ring, GL_RING_FENCE, fence);
+      Atomics.notify(state.ring, GL_RING_FENCE);
+    },
+
+    texImage2D: (state, target, level, internalformat, width, height, border, format, type, pixels) => {
+      if (!gl_context.gl) return;
+      gl_context.gl.texImage2D(target, level, internalformat, width, height, border, format, type,
+        gl_pixel_view(type, pixels));
+    },
+
+    texSubImage2D: (state, target, level, xoffset, yoffset, width, height, format, type, pixels) => {
+      if (!gl_context.gl) return;
+      gl_context.gl.texSubImage2D(target, level, xoffset, yoffset, width, height, format, type,
+        gl_pixel_view(type, pixels));
+    },
+
+    readPixels: (state, x, y, width, height, format, type, pixels) => {
+      if (!gl_context.gl) return;
+      gl_context.gl.readPixels(x, y, width, height, format, type, gl_pixel_view(type, pixels));
+    },
+
+    readPixelsAsync: (state, x, y, width, height, format, type, pixels, done) => {
+      const gl = gl_context.gl;
+      try {
+        if (gl && gl.fenceSync && pixels.byteLength) {
+          const buffer = gl_context.readback_buffers.pop() || { object: gl.createBuffer(), capacity: 0 };
+          gl.bindBuffer(gl.PIXEL_PACK_BUFFER, buffer.object);
+          if (buffer.capacity < pixels.byteLength) {
+            gl.bufferData(gl.PIXEL_PACK_BUFFER, pixels.byteLength, gl.STREAM_READ);
+            buffer.capacity = pixels.byteLength;
+          }
+          gl.readPixels(x, y, width, height, format, type, 0);
+          gl.bindBuffer(gl.PIXEL_PACK_BUFFER, null);
+          gl_readbacks.push({
+            state: state,
+            context: gl_context,
+            sync: gl.fenceSync(gl.SYNC_GPU_COMMANDS_COMPLETE, 0),
+            buffer: buffer,
+            start: pixels.byteOffset,  // Not a view: memory.buffer changes when the memory grows.
+            size: pixels.byteLength,
+            done: done.byteOffset,
+          });
+          gl.flush();
+          gl_readback_poll();
+          return;
+        }
+
+        // WebGL1 (or the software renderer) has no fences to wait for, read the pixels right away.
+        if (gl) {
+          gl.readPixels(x, y, width, height, format, type, gl_pixel_view(type, pixels));
+        }
+      } catch (error) {
+        log("[Graphics]: Error in readPixels: " + error.message);
+      }
+      gl_readback_signal(done.byteOffset);  // Do not leave the Worker waiting, even if the readback failed.
+    },
+
+    drawArraysInstanced: (state, mode, first, count, instance_count) => {
+      if (!gl_context.gl || !gl_instancing()) return;
+      gl_instancing().drawArraysInstanced(mode, first, count, instance_count);
+    },
+
+    drawElementsInstanced: (state, mode, count, type, offset, instance_count) => {
+      if (!gl_context.gl || !gl_instancing()) return;
+      gl_instancing().drawElementsInstanced(mode, count, type, offset, instance_count);
+    },
+
+    vertexAttribDivisor: (state, index, divisor) => {
+      if (!gl_context.gl || !gl_instancing()) return;
+      gl_instancing().vertexAttribDivisor(index, divisor);
+    },
+
+    bindVertexArray: (state, array) => {
+      if (!gl_context.gl || !gl_vertex_arrays()) return;
+      const vao = gl_vertex_arrays();
+      vao.bindVertexArray(gl_object(gl_context.vertexArrays, array, vao.createVertexArray));
+    },
+
+    deleteVertexArray: (state, array) => {
+      if (!gl_context.gl || !gl_vertex_arrays()) return;
+      gl_object_delete(gl_context.vertexArrays, array, gl_vertex_arrays().deleteVertexArray);
+    },
+
+    bindFramebuffer: (state, target, framebuffer) => {
+      if (!gl_context.gl) return;
+      gl_context.gl.bindFramebuffer(target, gl_object(gl_context.framebuffers, framebuffer, gl_context.gl.createFramebuffer));
+    },
+
+    deleteFramebuffer: (state, framebuffer) => {
+      if (!gl_context.gl) return;
+      gl_object_delete(gl_context.framebuffers, framebuffer, gl_context.gl.deleteFramebuffer);
+    },
+
+    framebufferRenderbuffer: (state, target, attachment, renderbuffer_target, renderbuffer) => {
+      if (!gl_context.gl) return;
+      gl_context.gl.framebufferRenderbuffer(target, attachment, renderbuffer_target,
+        gl_object(gl_context.renderbuffers, renderbuffer, gl_context.gl.createRenderbuffer));
+    },
+
+    bindRenderbuffer: (state, target, renderbuffer) => {
+      if (!gl_context.gl) return;
+      gl_context.gl.bindRenderbuffer(target,
+        gl_object(gl_context.renderbuffers, renderbuffer, gl_context.gl.createRenderbuffer));
+    },
+
+    deleteRenderbuffer: (state, renderbuffer) => {
+      if (!gl_context.gl) return;
+      gl_object_delete(gl_context.renderbuffers, renderbuffer, gl_context.gl.deleteRenderbuffer);
+    },
+
+    renderbufferStorage: (state, target, internalformat, width, height) => {
+      if (!gl_context.gl) return;
+      // WebGL1 has no GL_DEPTH24_STENCIL8 (GLES 3, or OES_packed_depth_stencil), but an unsized GL_DEPTH_STENCIL.
+      if (internalformat == 0x88F0 && !gl_context.gl.renderbufferStorageMultisample) {
+        internalformat = 0x84F9;
+      }
+      gl_context.gl.renderbufferStorage(target, internalformat, width, height);
+    },
+
+    createShader: (state, shader, type) => {
+      if (!gl_context.gl) return;
+      const object = gl_context.gl.createShader(type);
+      gl_context.shaders.set(shader, object);
+      gl_context.shader_state.set(shader, { object: object, type: type, source: "", pending: false, deleted: false });
+    },
+
+    compileShader: (state, shader) => {
+      if (!gl_context.gl) return;
+      const shader_state = gl_context.shader_state.get(shader);
+      if (shader_state) {
+        shader_state.pending = true;  // See gl_shader_compile().
+      }
+    },
+
+    attachShader: (state, program, shader) => {
+      if (!gl_context.gl) return;
+      const program_state = gl_program_state_get(program);
+      const shader_state = gl_context.shader_state.get(shader);
+      if (shader_state) {
+        program_state.shaders.add(shader_state);
+      }
+      // Not to a program taken from the cache (see gl_program_link()).
+      gl_context.gl.attachShader(program_state.placeholder || gl_object(gl_context.programs, program),
+        gl_object(gl_context.shaders, shader));
+    },
+
+    createProgram: (state, program) => {
+      if (!gl_context.gl) return;
+      gl_context.programs.set(program, gl_context.gl.createProgram());
+      state.programs.set(program, gl_context);
+    },
+
+    deleteShader: (state, shader) => {
+      if (!gl_context.gl) return;
+      const shader_state = gl_context.shader_state.get(shader);
+      if (shader_state) {
+        shader_state.deleted = true;
+        gl_context.shader_state.delete(shader);
+        gl_context.shaders.delete(shader);
+        gl_shader_forget(shader_state);  // See gl_context.shader_state.
+      } else {
+        gl_object_delete(gl_context.shaders, shader, gl_context.gl.deleteShader);
+      }
+    },
+
+    linkProgram: (state, program, link) => {
+      if (!gl_context.gl) return;
+      gl_program_locations_invalidate(program);
+      gl_program_link(program);
+      if (link) {
+        // Without background compiles (or for a program from the cache), the link is done already.
+        const pending = gl_context.parallel_compile && !gl_program_state_get(program).placeholder;
+        state.links.push({ gl: gl_context.gl, program: pending ? gl_context.programs.get(program) : null, link: link });
+        gl_links_poll(state);
+      }
+    },
+
+    deleteProgram: (state, program) => {
+      if (!gl_context.gl) return;
+      state.programs.delete(program);
+      gl_program_release(program);
+    },
+
+    deleteBuffer: (state, buffer) => {
+      if (!gl_context.gl) return;
+      gl_object_delete(gl_context.buffers, buffer, gl_context.gl.deleteBuffer);
+    },
+
+    deleteTexture: (state, texture) => {
+      if (!gl_context.gl) return;
+      gl_object_delete(gl_context.textures, texture, gl_context.gl.deleteTexture);
+    },
+  };
+
+  /// Execute all GL commands that a Worker has written to its command ring, then hand the space back to it.
+  const gl_ring_drain = (port) => {
+    const state = gl_rings.get(port);
+    if (!state) return;
+
+    const ring = state.ring;
+    const ring_f32 = state.ring_f32;
+    const capacity = ring.length - GL_RING_HEADER_WORDS;
+    const head = Atomics.load(ring, GL_RING_HEAD);
+    let tail = ring[GL_RING_TAIL];
+
+    while (tail != head) {
+      let pos = GL_RING_HEADER_WORDS + tail;
+      const opcode = ring[pos++];
+      if (opcode == 0) {
+        // The writer did not have enough space at the end of the ring and continued from the start.
+        tail = 0;
+        continue;
+      }
+
+      const command = state.commands[opcode];
+      const args = [];
+      for (const type of command.args) {
+        if (type == "i") {
+          args.push(ring[pos++]);
+        } else if (type == "f") {
+          args.push(ring_f32[pos++]);
+        } else if (type == "F") {
+          const length = ring[pos++];
+          args.push(ring_f32.slice(pos, pos + length));
+          pos += length;
+        } else if (type == "m" || type == "w") {
+          // A view straight into Wasm memory, no copy. (memory.buffer changes when the memory grows.)
+          const start = ring[pos++] >>> 0;
+          const size = ring[pos++] >>> 0;
+          args.push(new Uint8Array(memory.buffer, start, size));
+        } else {
+          args.push(gl_ring_object(type, ring[pos++]));
+        }
+      }
+      tail = (pos - GL_RING_HEADER_WORDS) % capacity;
+
+      try {
+        const host_command = gl_ring_host_commands[command.name || command.func_name];
+        if (host_command) {
+          host_command(state, ...args);
+        } else if (gl_context.gl) {
+          gl_context.gl[command.func_name](...args);
+        }
+      } catch (error) {
+        log("[Graphics]: Error in " + command.func_name + ": " + error.message);
+      }
+    }
+
+    // Release the consumed space and wake the Worker in case it is waiting for room in a full ring.
+    Atomics.store(ring, GL_RING_TAIL, tail);
+    Atomics.notify(ring, GL_RING_TAIL);
+  };
+
+  /// Report the links of a Worker that have completed in the link word of its ring, for wasm_gl_program_ready() to read
+  /// without asking. Links are reported in order, so a link that completes early waits for those before it. Pending
+  /// links are checked again at every display refresh until they are all done.
+  const gl_links_poll = (state) => {
+    while (state.links.length) {
+      const { gl, program, link } = state.links[0];
+      // null for a program deleted meanwhile (or a lost context): nothing to wait for then either.
+      if (program && gl.getProgramParameter(program, GL_COMPLETION_STATUS_KHR) === false) {
+        break;
+      }
+      state.links.shift();
+      Atomics.store(state.ring, GL_RING_LINKED, link);
+    }
+
+    if (state.links.length && !state.links_polling) {
+      state.links_polling = true;
+      animation_frame(() => {
+        state.links_polling = false;
+        gl_links_poll(state);
+      });
+    }
+  };
+
+  /// EGL contexts and surfaces by ID (see the registry in index.html). IDs are allocated by the Workers, like GL names.
+  /// Surfaces are { canvas, context, layer (see linux-compositor.js), port }, contexts are as created by gl_context_new() (with the port they were created
+  /// over). Both are destroyed along with the task that created them, if it does not destroy them itself.
+  const egl_contexts = graphics ? graphics.contexts : new Map();
+  const egl_surfaces = graphics ? graphics.surfaces : new Map();
+
+  /// The context each task has made current (task port -> context), if not the default one.
+  const egl_current = new Map();
+
+  /// A canvas for a surface that is not the page canvas. Without a DOM (tools/gl-replay.js), only its size is used.
+  const egl_canvas_new = (width, height) => {
+    if (typeof OffscreenCanvas !== "undefined") {
+      return new OffscreenCanvas(width, height);
+    }
+    if (typeof document !== "undefined") {
+      return Object.assign(document.createElement("canvas"), { width: width, height: height });
+    }
+    return { width: width, height: height };
+  };
+
+  /// Destroy an EGL surface. A context that renders to it keeps doing so (see graphics_egl_make_current), to its
+  /// canvas, but it is not shown any more. Without such a context, the device of the canvas is free again.
+  const egl_surface_destroy = (id) => {
+    const surface = egl_surfaces.get(id);
+    if (surface) {
+      egl_surfaces.delete(id);
+      surface.destroyed = true;
+      if (surface.layer) {
+        compositor.remove(surface.layer);
+        surface.layer = null;
+      }
+      const device = gl_devices.get(surface.canvas);
+      if (device && !surface.context) {
+        gl_device_park(device);
+      }
+    }
+  };
+
+  /// Destroy an EGL context, along with its objects (but not the program cache of its device). Tasks that still have it
+  /// current fall back to the default context.
+  const gl_context_release = (context) => {
+    for (const [id, other] of egl_contexts) {
+      if (other === context) {
+        egl_contexts.delete(id);
+      }
+    }
+    for (const [port, other] of egl_current) {
+      if (other === context) {
+        egl_current.delete(port);
+      }
+    }
+    if (context.surface) {
+      context.surface.context = null;
+    }
+
+    const gl = context.gl;
+    if (!gl) return;
+    for (let i = gl_readbacks.length - 1; i >= 0; i--) {
+      if (gl_readbacks[i].context === context) {
+        const readback = gl_readbacks.splice(i, 1)[0];
+        gl_readback_release(readback);
+        gl_readback_signal(readback.done);
+      }
+    }
+
+    // The device keeps its WebGL context (for later surfaces, or the default context for that of the page canvas):
+    // only delete what was created in this context.
+    context.shaders.forEach((shader) => gl.deleteShader(shader));
+    context.programs.forEach((program) => gl.deleteProgram(program));
+    context.buffers.forEach((buffer) => gl.deleteBuffer(buffer));
+    context.textures.forEach((texture) => gl.deleteTexture(texture));
+    context.framebuffers.forEach((framebuffer) => gl.deleteFramebuffer(framebuffer));
+    context.renderbuffers.forEach((renderbuffer) => gl.deleteRenderbuffer(renderbuffer));
+    if (context.vertex_arrays) {
+      context.vertexArrays.forEach((array) => context.vertex_arrays.deleteVertexArray(array));
+    }
+    for (const program of context.program_state.values()) {
+      program.shaders.forEach((shader) => gl.deleteShader(shader.object));
+      if (program.placeholder) {
+        gl.deleteProgram(program.placeholder);
+      }
+    }
+
+    if (!context.surface || context.surface.destroyed) {
+      gl_device_park(context.device);
+    }
+  };
+
+  /// Callbacks from task Workers, over their ports.
+  const message_callbacks = {
+    graphics_init: (message) => {
+      if (graphics && graphics.canvas) {
+        show();
+        log("[Graphics]: Initialized");
+      }
+      vblank_start();
+    },
+
+    graphics_gl_ring_init: (message, port) => {
+      gl_rings.set(port, {
+        ring: message.ring,
+        ring_f32: new Float32Array(message.ring.buffer),
+        commands: message.commands,
+        programs: new Map(),  // Programs created by the task and not deleted yet, and their contexts (released when
+                              // it exits).
+        links: [],  // Links not seen complete yet, see gl_links_poll()
+        links_polling: false,
+      });
+    },
+
+    graphics_gl_reply_init: (message, port) => {
+      gl_replies.set(port, message.reply);
+    },
+
+    graphics_gl_flush: (message, port) => {
+      gl_ring_drain(port);
+    },
+
+    graphics_swap_buffers: (message) => {
+      // WebGL automatically swaps buffers, but we can trigger a flush here if needed
+      if (gl_context.gl) {
+        gl_context.gl.flush();
+      }
+      // Window surfaces are shown by the compositor, at the next display refresh.
+      const surface = gl_context.surface;
+      if (surface && surface.layer) {
+        compositor.present(surface.layer);
+      }
+    },
+
+    graphics_egl_create_surface: (message, port) => {
+      if (!graphics) return;
+      // Without a compositor, the first window surface is the page canvas. Any other surface gets a canvas of its own.
+      const page_canvas_free = message.window && !compositor &&
+        ![...egl_surfaces.values()].some((surface) => surface.canvas === graphics.canvas);
+      const width = message.window ? graphics.canvas.width : Math.max(message.width, 1);
+      const height = message.window ? graphics.canvas.height : Math.max(message.height, 1);
+      const device = page_canvas_free ? null : gl_device_take(width, height);
+      const canvas = page_canvas_free ? graphics.canvas : device ? device.canvas : egl_canvas_new(width, height);
+      egl_surfaces.set(message.surface, {
+        canvas: canvas,
+        context: null,  // Context rendering to the surface
+        layer: message.window && compositor ? compositor.add(canvas) : null,
+        port: port,
+      });
+      vblank_start();
+    },
+
+    graphics_egl_destroy_surface: (message) => {
+      egl_surface_destroy(message.surface);
+    },
+
+    graphics_egl_create_context: (message, port) => {
+      const context = gl_context_new(null, null);
+      context.port = port;
+      egl_contexts.set(message.context, context);
+    },
+
+    graphics_egl_destroy_context: (message) => {
+      const context = egl_contexts.get(message.context);
+      if (context) {
+        gl_context_release(context);
+      }
+    },
+
+    graphics_egl_make_current: (message, port) => {
+      if (!message.context) {
+        egl_current.delete(port);
+        gl_reply(port, 1);
+        return;
+      }
+
+      const context = egl_contexts.get(message.context);
+      const surface = egl_surfaces.get(message.surface);
+      if (!context || !surface) {
+        gl_reply(port, 0);
+        return;
+      }
+      if (!context.surface && !surface.context) {
+        // A WebGL context is tied to its canvas: the context renders to this surface from now on.
+        const device = gl_device_get(surface.canvas);
+        if (!device) {
+          log("[Graphics]: Could not create a WebGL context for EGL context " + message.context);
+          gl_reply(port, 0);
+          return;
+        }
+        gl_context_attach(context, device);
+        context.surface = surface;
+        surface.context = context;
+      } else if (context.surface !== surface) {
+        log("[Graphics]: EGL context " + message.context + " can only be made current with the surface it was first " +
+          "made current with");
+        gl_reply(port, 0);
+        return;
+      }
+      egl_current.set(port, context);
+      gl_reply(port, 1);
+    },
+
+    graphics_gl_shader_source: (message) => {
+      if (!gl_context.gl) return;
+      const shader = gl_context.shaders.get(message.shader);
+      if (shader) {
+        gl_context.gl.shaderSource(shader, message.source);
+      }
+      const shader_state = gl_context.shader_state.get(message.shader);
+      if (shader_state) {
+        shader_state.source = message.source;
+      }
+    },
+
+    graphics_gl_get_shaderiv: (message, port) => {
+      const shader = gl_context.gl && gl_context.shaders.get(message.shader);
+      if (!shader) {
+        gl_reply(port, 0);
+        return;
+      }
+
+      // A shader known to compile need not be compiled (yet) to say so.
+      const shader_state = gl_context.shader_state.get(message.shader);
+      if (message.pname == GL_COMPILE_STATUS && gl_shader_known_good(shader_state)) {
+        gl_reply(port, 1);
+        return;
+      }
+
+      gl_shader_compile(shader_state);
+      const result = gl_context.gl.getShaderParameter(shader, message.pname);
+      if (message.pname == GL_COMPILE_STATUS && result && shader_state) {
+        gl_context.device.shaders_compiled.add(gl_shader_key(shader_state));
+      }
+      gl_reply(port, gl_reply_int(result));
+    },
+
+    graphics_gl_get_shader_info_log: (message, port) => {
+      const shader = gl_context.gl && gl_context.shaders.get(message.shader);
+      const shader_state = gl_context.shader_state.get(message.shader);
+      if (!gl_shader_known_good(shader_state)) {
+        gl_shader_compile(shader_state);
+      }
+      gl_reply(port, 0, text_encoder.encode((shader && gl_context.gl.getShaderInfoLog(shader)) || ""));
+    },
+
+    graphics_gl_get_integerv: (message, port) => {
+      const gl = gl_context.gl;
+      let result = null;
+      if (gl && message.pname == GL_NUM_COMPRESSED_TEXTURE_FORMATS) {
+        result = gl.getParameter(GL_COMPRESSED_TEXTURE_FORMATS).length;
+      } else if (gl) {
+        result = gl.getParameter(message.pname);
+      }
+      const values = Int32Array.from(ArrayBuffer.isView(result) || Array.isArray(result)
+        ? result : [gl_reply_int(result)], gl_reply_int);
+      gl_reply(port, 0, new Uint8Array(values.buffer));
+    },
+
+    graphics_gl_finish: (message, port) => {
+      // Everything the Worker issued before has been executed by now, messages are handled in order.
+      if (gl_context.gl) {
+        gl_context.gl.finish();
+      }
+      gl_reply(port, 1);
+    },
+
+    graphics_gl_check_framebuffer_status: (message, port) => {
+      gl_reply(port, gl_context.gl ? gl_context.gl.checkFramebufferStatus(message.target) : 0);
+    },
+
+    graphics_gl_get_programiv: (message, port) => {
+      const program = gl_context.gl && gl_context.programs.get(message.program);
+      if (program && message.pname == GL_COMPLETION_STATUS_KHR && !gl_context.parallel_compile) {
+        gl_reply(port, 1);  // Without background compiles, a link is done by the time it can be asked about.
+        return;
+      }
+      gl_reply(port, program ? gl_reply_int(gl_context.gl.getProgramParameter(program, message.pname)) : 0);
+    },
+
+    graphics_gl_get_program_info_log: (message, port) => {
+      const program = gl_context.gl && gl_context.programs.get(message.program);
+      gl_reply(port, 0, text_encoder.encode((program && gl_context.gl.getProgramInfoLog(program)) || ""));
+    },
+
+    graphics_gl_get_program_locations: (message, port) => {
+      let locations = { uniforms: {}, attributes: {} };
+      if (gl_context.gl) {
+        locations = gl_program_locations_get(message.program);
+      }
+      gl_reply(port, 0, text_encoder.encode(JSON.stringify(locations)));
+    },
+  };
+
+  /// Connected task ports (connection ID -> MessagePort).
+  const ports = new Map();
+
+  return {
+    /// Serve the requests of a new task Worker, sent over port. id is used to disconnect() it again.
+    connect: (id, port) => {
+      ports.set(id, port);
+      port.onmessage = (message_event) => {
+        const data = message_event.data;
+        gl_context = egl_current.get(port) || gl_default_context;
+        message_callbacks[data.method](data, port);
+      };
+    },
+
+    /// Stop serving a task Worker (it has been terminated). Its ring and mailbox go away with its port.
+    disconnect: (id) => {
+      const port = ports.get(id);
+      if (port) {
+        const state = gl_rings.get(port);
+        if (state) {
+          // The task is gone, along with its uses of its programs: keep them for when it is started again.
+          for (const [program, context] of state.programs) {
+            gl_context = context;
+            const gl = context.gl;
+            if (gl && gl.getParameter(gl.CURRENT_PROGRAM) === context.programs.get(program)) {
+              gl.useProgram(null);  // Left current by the task: the cache does not hand out programs in use.
+            }
+            gl_program_release(program);
+          }
+
+          // Its memory may be handed to someone else, so readbacks still in flight must not write to it anymore.
+          for (let i = gl_readbacks.length - 1; i >= 0; i--) {
+            if (gl_readbacks[i].state == state) {
+              gl_readback_release(gl_readbacks.splice(i, 1)[0]);
+            }
+          }
+        }
+
+        for (const [surface_id, surface] of egl_surfaces) {
+          if (surface.port === port) {
+            egl_surface_destroy(surface_id);
+          }
+        }
+        for (const context of egl_contexts.values()) {
+          if (context.port === port) {
+            gl_context_release(context);
+          }
+        }
+        egl_current.delete(port);
+        port.close();
+        ports.delete(id);
+      }
+    },
+  };
+};
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/**
+ * The persistent module cache: keeps Wasm binaries (vmlinux and user executables) across page loads in the Cache API,
+ * keyed by the SHA-256 hash of their contents, and compiles them from there with WebAssembly.compileStreaming().
+ * Browsers keep the machine code of modules compiled from responses they have cached next to them (Chromium does for
+ * larger modules), so on a warm boot, "compiling" vmlinux and busybox just loads their machine code.
+ *
+ * MODULE_CACHE_VERSION is part of the name of the cache. Bump it when what is stored changes, and caches of other
+ * versions are deleted. At most MODULE_CACHE_ENTRIES binaries are kept, the ones stored first are evicted first.
+ *
+ * Used by index.html (for vmlinux, see linux_module_cache_compile_streaming) and linux-worker.js (for user executables,
+ * see executable_compile). Without the Cache API (e.g. outside a secure context), binaries are simply compiled.
+ */
+const MODULE_CACHE_VERSION = 1;
+const MODULE_CACHE_PREFIX = "linux-wasm-modules-";
+const MODULE_CACHE_ENTRIES = 64;
+
+/// The cache, opened (and older versions deleted) on first use. Resolves to null without the Cache API.
+let module_cache_open = null;
+
+/// Get the key of a Wasm binary (ArrayBuffer or typed array, not shared): the SHA-256 hash of it, in hex.
+const linux_module_cache_key = async (binary) => {
+  const digest = new Uint8Array(await crypto.subtle.digest("SHA-256", binary));
+  return Array.from(digest, (byte) => byte.toString(16).padStart(2, "0")).join("");
+};
+
+/// Open the cache (deleting those of other versions) on first use. Resolves to null without the Cache API.
+const module_cache_get = () => {
+  if (!module_cache_open) {
+    module_cache_open = (async () => {
+      if (!self.caches || !self.crypto || !crypto.subtle) return null;
+      for (const name of await caches.keys()) {
+        if (name.startsWith(MODULE_CACHE_PREFIX) && name != MODULE_CACHE_PREFIX + MODULE_CACHE_VERSION) {
+          await caches.delete(name);
+        }
+      }
+      return caches.open(MODULE_CACHE_PREFIX + MODULE_CACHE_VERSION);
+    })().catch(() => null);  // E.g. storage disabled by the user.
+  }
+  return module_cache_open;
+};
+
+/// The URL that a binary is stored under in the cache. It is only a name, it is never fetched.
+const module_cache_url = (key) => new URL("module-cache/" + key + ".wasm", self.location.href);
+
+/// Store a binary under url, evicting the oldest entries beyond MODULE_CACHE_ENTRIES. Returns false if it failed.
+const module_cache_put = async (cache, url, binary) => {
+  try {
+    await cache.put(url, new Response(binary, { headers: { "Content-Type": "application/wasm" } }));
+    const urls = await cache.keys();
+    for (const old of urls.slice(0, Math.max(urls.length - MODULE_CACHE_ENTRIES, 0))) {
+      await cache.delete(old);
+    }
+    return true;
+  } catch (error) {
+    return false;  // Over quota, most likely.
+  }
+};
+
+/// Compile a Wasm binary (ArrayBuffer or typed array, not shared) through the cache. key is from
+/// linux_module_cache_key(), if already known.
+const linux_module_cache_compile = async (binary, key) => {
+  const cache = await module_cache_get();
+  if (!cache) {
+    return WebAssembly.compile(binary);
+  }
+
+  const url = module_cache_url(key || await linux_module_cache_key(binary));
+  let response = await cache.match(url);
+  if (!response && await module_cache_put(cache, url, binary)) {
+    response = await cache.match(url);
+  }
+  return response ? WebAssembly.compileStreaming(response) : WebAssembly.compile(binary);
+};
+
+/**
+ * Compile a Wasm binary fetched from the server (e.g. vmlinux) through the cache, without giving up on compiling it
+ * while it downloads. Its hash is only known once it has been downloaded, so the cache also remembers which hash the
+ * response for its URL had, along with the validators of that response (ETag, or Last-Modified and Content-Length).
+ * If they match, the binary is compiled from the cache, and the download is cancelled. Otherwise it is compiled as it
+ * streams in, while a copy of it is read, hashed and stored in the cache, for the next time.
+ */
+const linux_module_cache_compile_streaming = async (response) => {
+  response = await response;
+  const cache = await module_cache_get();
+  const validator = response.headers.get("ETag") ||
+    [response.headers.get("Last-Modified"), response.headers.get("Content-Length")].join(" ");
+  if (!cache || !response.ok || validator == " ") {
+    return WebAssembly.compileStreaming(response);
+  }
+
+  const hint_url = new URL("module-cache/url/" + encodeURIComponent(response.url), self.location.href);
+  const hint = await cache.match(hint_url).then((hint) => hint && hint.json()).catch(() => null);
+  const cached = hint && hint.validator == validator && await cache.match(module_cache_url(hint.key));
+  if (cached) {
+    response.body.cancel().catch(() => { });
+    return WebAssembly.compileStreaming(cached);
+  }
+
+  const copy = response.clone();
+  const module = WebAssembly.compileStreaming(response);
+  (async () => {
+    const binary = await copy.arrayBuffer();
+    const key = await linux_module_cache_key(binary);
+    if (await module_cache_put(cache, module_cache_url(key), binary)) {
+      await cache.put(hint_url, new Response(JSON.stringify({ validator: validator, key: key })));
+    }
+  })().catch(() => { });  // Only a miss next time.
+  return module;
+};
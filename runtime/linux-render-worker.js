@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/// The render worker: owns the canvas (as an OffscreenCanvas) and executes the GL requests of all tasks, which talk to
+/// it directly over MessagePorts. See linux-graphics.js for the actual work and linux.js for how it is set up.
+(function () {
+  // Same cache-busting version as ours.
+  importScripts("linux-graphics.js" + self.location.search, "linux-softgl.js" + self.location.search,
+    "linux-compositor.js" + self.location.search);
+
+  let host = null;
+
+  const log = (text) => {
+    self.postMessage({ method: "log", message: text });
+  };
+
+  /// Callbacks from the main thread.
+  const message_callbacks = {
+    init: (message) => {
+      host = linux_graphics(message.graphics, message.memory, log, () => {
+        self.postMessage({ method: "graphics_show" });
+      });
+    },
+
+    connect: (message) => {
+      host.connect(message.id, message.port);
+    },
+
+    disconnect: (message) => {
+      host.disconnect(message.id);
+    },
+  };
+
+  self.onmessage = (message_event) => {
+    const data = message_event.data;
+    message_callbacks[data.method](data);
+  };
+
+  self.onmessageerror = (error) => {
+    throw error;
+  };
+})();
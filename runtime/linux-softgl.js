@@ -0,0 +1,2434 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/**
+ * A software (CPU) implementation of the part of WebGL that the graphics host uses, so that GL programs can run
+ * without a GPU: headless, e.g. in CI (see tools/gl-replay.js), or in a browser with ?gl=software in the URL.
+ *
+ * linux_softgl(canvas) returns an object that stands in for a WebGL2 context. If canvas has a 2D context (a real
+ * canvas or OffscreenCanvas), frames are shown in it on flush(); otherwise only its width and height are used.
+ *
+ * Supported: GLSL ES 1.0 shaders (compiled to JavaScript, no structs and no out/inout parameters), buffers, vertex
+ * array objects, instancing, 2D textures (level 0, with the magnification filter), framebuffer objects (one color
+ * attachment, a texture or renderbuffer, and a depth renderbuffer; no stencil), depth test, blending, culling, scissor
+ * test, and points, lines and triangles. Rendering is meant to be deterministic rather than fast.
+ */
+const linux_softgl = (() => {
+  /// WebGL constants (the ones used below, plus a few commonly queried ones).
+  const GL = {
+    DEPTH_BUFFER_BIT: 0x100, STENCIL_BUFFER_BIT: 0x400, COLOR_BUFFER_BIT: 0x4000,
+    POINTS: 0, LINES: 1, LINE_LOOP: 2, LINE_STRIP: 3, TRIANGLES: 4, TRIANGLE_STRIP: 5, TRIANGLE_FAN: 6,
+    ZERO: 0, ONE: 1, SRC_COLOR: 0x300, ONE_MINUS_SRC_COLOR: 0x301, SRC_ALPHA: 0x302, ONE_MINUS_SRC_ALPHA: 0x303,
+    DST_ALPHA: 0x304, ONE_MINUS_DST_ALPHA: 0x305, DST_COLOR: 0x306, ONE_MINUS_DST_COLOR: 0x307,
+    SRC_ALPHA_SATURATE: 0x308, CONSTANT_COLOR: 0x8001, ONE_MINUS_CONSTANT_COLOR: 0x8002, CONSTANT_ALPHA: 0x8003,
+    ONE_MINUS_CONSTANT_ALPHA: 0x8004,
+    FUNC_ADD: 0x8006, MIN: 0x8007, MAX: 0x8008, FUNC_SUBTRACT: 0x800A, FUNC_REVERSE_SUBTRACT: 0x800B,
+    ARRAY_BUFFER: 0x8892, ELEMENT_ARRAY_BUFFER: 0x8893, STREAM_DRAW: 0x88E0, STATIC_DRAW: 0x88E4,
+    DYNAMIC_DRAW: 0x88E8,
+    FRONT: 0x404, BACK: 0x405, FRONT_AND_BACK: 0x408, CW: 0x900, CCW: 0x901,
+    CULL_FACE: 0xB44, DEPTH_TEST: 0xB71, STENCIL_TEST: 0xB90, DITHER: 0xBD0, BLEND: 0xBE2, SCISSOR_TEST: 0xC11,
+    POLYGON_OFFSET_FILL: 0x8037, SAMPLE_ALPHA_TO_COVERAGE: 0x809E, SAMPLE_COVERAGE: 0x80A0,
+    NO_ERROR: 0, INVALID_ENUM: 0x500, INVALID_VALUE: 0x501, INVALID_OPERATION: 0x502, OUT_OF_MEMORY: 0x505,
+    VIEWPORT: 0xBA2, SCISSOR_BOX: 0xC10, COLOR_CLEAR_VALUE: 0xC22, DEPTH_CLEAR_VALUE: 0xB73,
+    MAX_TEXTURE_SIZE: 0xD33, MAX_VIEWPORT_DIMS: 0xD3A, DEPTH_BITS: 0xD56, MAX_VERTEX_ATTRIBS: 0x8869,
+    MAX_TEXTURE_IMAGE_UNITS: 0x8872, MAX_COMBINED_TEXTURE_IMAGE_UNITS: 0x8B4D, VENDOR: 0x1F00, RENDERER: 0x1F01,
+    VERSION: 0x1F02, SHADING_LANGUAGE_VERSION: 0x8B8C,
+    BYTE: 0x1400, UNSIGNED_BYTE: 0x1401, SHORT: 0x1402, UNSIGNED_SHORT: 0x1403, INT: 0x1404, UNSIGNED_INT: 0x1405,
+    FLOAT: 0x1406, HALF_FLOAT: 0x140B, HALF_FLOAT_OES: 0x8D61,
+    DEPTH_COMPONENT: 0x1902, ALPHA: 0x1906, RGB: 0x1907, RGBA: 0x1908, LUMINANCE: 0x1909, LUMINANCE_ALPHA: 0x190A,
+    UNSIGNED_SHORT_4_4_4_4: 0x8033, UNSIGNED_SHORT_5_5_5_1: 0x8034, UNSIGNED_SHORT_5_6_5: 0x8363,
+    FRAGMENT_SHADER: 0x8B30, VERTEX_SHADER: 0x8B31, SHADER_TYPE: 0x8B4F, DELETE_STATUS: 0x8B80,
+    COMPILE_STATUS: 0x8B81, LINK_STATUS: 0x8B82, VALIDATE_STATUS: 0x8B83, ATTACHED_SHADERS: 0x8B85,
+    ACTIVE_UNIFORMS: 0x8B86, ACTIVE_ATTRIBUTES: 0x8B89, CURRENT_PROGRAM: 0x8B8D,
+    NEVER: 0x200, LESS: 0x201, EQUAL: 0x202, LEQUAL: 0x203, GREATER: 0x204, NOTEQUAL: 0x205, GEQUAL: 0x206,
+    ALWAYS: 0x207,
+    NEAREST: 0x2600, LINEAR: 0x2601, NEAREST_MIPMAP_NEAREST: 0x2700, LINEAR_MIPMAP_NEAREST: 0x2701,
+    NEAREST_MIPMAP_LINEAR: 0x2702, LINEAR_MIPMAP_LINEAR: 0x2703, TEXTURE_MAG_FILTER: 0x2800,
+    TEXTURE_MIN_FILTER: 0x2801, TEXTURE_WRAP_S: 0x2802, TEXTURE_WRAP_T: 0x2803, TEXTURE_2D: 0xDE1,
+    TEXTURE_CUBE_MAP: 0x8513, TEXTURE0: 0x84C0, ACTIVE_TEXTURE: 0x84E0, REPEAT: 0x2901, CLAMP_TO_EDGE: 0x812F,
+    MIRRORED_REPEAT: 0x8370, TEXTURE_BINDING_2D: 0x8069, COMPRESSED_TEXTURE_FORMATS: 0x86A3,
+    FLOAT_VEC2: 0x8B50, FLOAT_VEC3: 0x8B51, FLOAT_VEC4: 0x8B52, INT_VEC2: 0x8B53, INT_VEC3: 0x8B54,
+    INT_VEC4: 0x8B55, BOOL: 0x8B56, BOOL_VEC2: 0x8B57, BOOL_VEC3: 0x8B58, BOOL_VEC4: 0x8B59, FLOAT_MAT2: 0x8B5A,
+    FLOAT_MAT3: 0x8B5B, FLOAT_MAT4: 0x8B5C, SAMPLER_2D: 0x8B5E, SAMPLER_CUBE: 0x8B60,
+    UNPACK_ALIGNMENT: 0xCF5, PACK_ALIGNMENT: 0xD05, UNPACK_FLIP_Y_WEBGL: 0x9240,
+    UNPACK_PREMULTIPLY_ALPHA_WEBGL: 0x9241,
+    ARRAY_BUFFER_BINDING: 0x8894, ELEMENT_ARRAY_BUFFER_BINDING: 0x8895, VERTEX_ARRAY_BINDING: 0x85B5,
+    FRAMEBUFFER: 0x8D40, RENDERBUFFER: 0x8D41, READ_FRAMEBUFFER: 0x8CA8, DRAW_FRAMEBUFFER: 0x8CA9,
+    FRAMEBUFFER_BINDING: 0x8CA6, RENDERBUFFER_BINDING: 0x8CA7, COLOR_ATTACHMENT0: 0x8CE0, DEPTH_ATTACHMENT: 0x8D00,
+    STENCIL_ATTACHMENT: 0x8D20, DEPTH_STENCIL_ATTACHMENT: 0x821A, FRAMEBUFFER_COMPLETE: 0x8CD5,
+    FRAMEBUFFER_INCOMPLETE_ATTACHMENT: 0x8CD6, FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: 0x8CD7,
+    FRAMEBUFFER_INCOMPLETE_DIMENSIONS: 0x8CD9, FRAMEBUFFER_UNSUPPORTED: 0x8CDD, INVALID_FRAMEBUFFER_OPERATION: 0x506,
+    RGBA4: 0x8056, RGB5_A1: 0x8057, RGB565: 0x8D62, RGB8: 0x8051, RGBA8: 0x8058, DEPTH_COMPONENT16: 0x81A5,
+    DEPTH_COMPONENT24: 0x81A6, DEPTH_STENCIL: 0x84F9, DEPTH24_STENCIL8: 0x88F0, STENCIL_INDEX8: 0x8D48,
+    RENDERBUFFER_WIDTH: 0x8D42, RENDERBUFFER_HEIGHT: 0x8D43, RENDERBUFFER_INTERNAL_FORMAT: 0x8D44,
+  };
+
+  /// GLSL ES 1.0 types: component count, component type, and (for matrices) the dimension.
+  const GLSL_TYPES = {
+    float: { n: 1, base: "float" }, int: { n: 1, base: "int" }, bool: { n: 1, base: "bool" },
+    vec2: { n: 2, base: "float" }, vec3: { n: 3, base: "float" }, vec4: { n: 4, base: "float" },
+    ivec2: { n: 2, base: "int" }, ivec3: { n: 3, base: "int" }, ivec4: { n: 4, base: "int" },
+    bvec2: { n: 2, base: "bool" }, bvec3: { n: 3, base: "bool" }, bvec4: { n: 4, base: "bool" },
+    mat2: { n: 4, base: "float", dim: 2 }, mat3: { n: 9, base: "float", dim: 3 },
+    mat4: { n: 16, base: "float", dim: 4 },
+    sampler2D: { n: 1, base: "sampler" }, samplerCube: { n: 1, base: "sampler" }, void: { n: 0, base: "void" },
+  };
+
+  const GLSL_TYPE_ENUMS = {
+    float: GL.FLOAT, vec2: GL.FLOAT_VEC2, vec3: GL.FLOAT_VEC3, vec4: GL.FLOAT_VEC4, int: GL.INT,
+    ivec2: GL.INT_VEC2, ivec3: GL.INT_VEC3, ivec4: GL.INT_VEC4, bool: GL.BOOL, bvec2: GL.BOOL_VEC2,
+    bvec3: GL.BOOL_VEC3, bvec4: GL.BOOL_VEC4, mat2: GL.FLOAT_MAT2, mat3: GL.FLOAT_MAT3, mat4: GL.FLOAT_MAT4,
+    sampler2D: GL.SAMPLER_2D, samplerCube: GL.SAMPLER_CUBE,
+  };
+
+  const glsl_vector_type = (base, n) => {
+    if (n == 1) return base;
+    return (base == "int" ? "ivec" : base == "bool" ? "bvec" : "vec") + n;
+  };
+
+  /// Zero value of a type, as JavaScript source.
+  const glsl_zero = (type) => {
+    const info = GLSL_TYPES[type];
+    const zero = info.base == "bool" ? "false" : "0";
+    return info.n == 1 ? zero : "[" + new Array(info.n).fill(zero).join(", ") + "]";
+  };
+
+  /// Strip comments and evaluate preprocessor directives. Only object-like macros and #ifdef/#ifndef/#if/#else/#endif
+  /// (with defined() and integer constants) are supported. Returns lines, with a map of macros to expand.
+  const glsl_preprocess = (source) => {
+    source = source.replace(/\/\*[\s\S]*?\*\//g, (comment) => comment.replace(/[^\n]/g, " "))
+      .replace(/\/\/[^\n]*/g, "").replace(/\\\n/g, " ");
+    const defines = new Map([["GL_ES", "1"], ["GL_FRAGMENT_PRECISION_HIGH", "1"], ["__VERSION__", "100"]]);
+    const lines = [];
+    const stack = [];  // { active, taken } per open conditional
+    const active = () => stack.every((entry) => entry.active);
+
+    const condition = (expression) => {
+      const text = expression.replace(/defined\s*\(?\s*(\w+)\s*\)?/g, (match, name) => defines.has(name) ? "1" : "0")
+        .replace(/[A-Za-z_]\w*/g, (name) => defines.has(name) ? defines.get(name) : "0");
+      if (!/^[\d\s()!&|=<>+\-*\/%]*$/.test(text)) {
+        throw new Error("unsupported #if expression: " + expression);
+      }
+      return !!new Function("return (" + text + ");")();
+    };
+
+    source.split("\n").forEach((line, index) => {
+      const directive = /^\s*#\s*(\w*)\s*(.*?)\s*$/.exec(line);
+      if (!directive) {
+        lines.push(active() ? line : "");
+        return;
+      }
+      lines.push("");
+      const [, name, rest] = directive;
+      const enclosing = stack.every((entry) => entry.active);
+      switch (name) {
+        case "ifdef": case "ifndef": case "if": {
+          const value = name == "if" ? enclosing && condition(rest) : defines.has(rest) == (name == "ifdef");
+          stack.push({ active: value, taken: value });
+          break;
+        }
+        case "elif": case "else": {
+          const entry = stack[stack.length - 1];
+          if (!entry) throw new Error("line " + (index + 1) + ": #" + name + " without #if");
+          stack.pop();
+          const outer = stack.every((open) => open.active);
+          entry.active = !entry.taken && outer && (name == "else" || condition(rest));
+          entry.taken = entry.taken || entry.active;
+          stack.push(entry);
+          break;
+        }
+        case "endif":
+          stack.pop();
+          break;
+        case "define":
+          if (enclosing) {
+            const macro = /^(\w+)(\()?\s*(.*)$/.exec(rest);
+            if (macro[2]) throw new Error("line " + (index + 1) + ": function-like macros are not supported");
+            defines.set(macro[1], macro[3]);
+          }
+          break;
+        case "undef":
+          if (enclosing) defines.delete(rest);
+          break;
+        case "error":
+          if (enclosing) throw new Error("line " + (index + 1) + ": #error " + rest);
+          break;
+        default:  // #version, #extension, #pragma, #line
+          break;
+      }
+    });
+    return { lines: lines, defines: defines };
+  };
+
+  /// Whitespace, or a number, an identifier or an operator (in that order of capture groups).
+  const GLSL_TOKEN = new RegExp([
+    "\\s+",
+    "(\\d+\\.\\d*(?:[eE][+-]?\\d+)?|\\.\\d+(?:[eE][+-]?\\d+)?|\\d+[eE][+-]?\\d+|0[xX][0-9a-fA-F]+|\\d+)",
+    "([A-Za-z_]\\w*)",
+    "(\\+\\+|--|\\+=|-=|\\*=|\\/=|==|!=|<=|>=|&&|\\|\\||\\^\\^|[-+*\\/%=<>!?:;,.(){}\\[\\]~&|^])",
+  ].join("|"), "y");
+
+  const glsl_tokenize = (preprocessed) => {
+    const tokens = [];
+    const push_line = (text, line, depth) => {
+      GLSL_TOKEN.lastIndex = 0;
+      while (GLSL_TOKEN.lastIndex < text.length) {
+        const start = GLSL_TOKEN.lastIndex;
+        const match = GLSL_TOKEN.exec(text);
+        if (!match) throw new Error("line " + line + ": unexpected character '" + text[start] + "'");
+        if (match[1]) {
+          tokens.push({ kind: "number", text: match[1], line: line });
+        } else if (match[2]) {
+          const macro = preprocessed.defines.get(match[2]);
+          if (macro !== undefined && depth < 16) {
+            const resume = GLSL_TOKEN.lastIndex;
+            push_line(macro, line, depth + 1);
+            GLSL_TOKEN.lastIndex = resume;
+          } else {
+            tokens.push({ kind: "ident", text: match[2], line: line });
+          }
+        } else if (match[3]) {
+          tokens.push({ kind: "op", text: match[3], line: line });
+        }
+      }
+    };
+    preprocessed.lines.forEach((text, index) => push_line(text, index + 1, 0));
+    return tokens;
+  };
+
+  const GLSL_SWIZZLE_SETS = ["xyzw", "rgba", "stpq"];
+
+  /// Built-in functions that are applied per component (with scalar arguments broadcast to vectors).
+  const GLSL_COMPONENTWISE = {
+    radians: 1, degrees: 1, sin: 1, cos: 1, tan: 1, asin: 1, acos: 1, exp: 1, log: 1, exp2: 1, log2: 1,
+    sqrt: 1, inversesqrt: 1, abs: 1, sign: 1, floor: 1, ceil: 1, fract: 1,
+    pow: 2, mod: 2, min: 2, max: 2, step: 2, matrixCompMult: 2,
+    clamp: 3, mix: 3, smoothstep: 3,
+  };
+
+  const GLSL_RELATIONAL = ["lessThan", "lessThanEqual", "greaterThan", "greaterThanEqual", "equal", "notEqual"];
+
+  const GLSL_BUILTIN_VARIABLES = {
+    vertex: { gl_Position: "vec4", gl_PointSize: "float" },
+    fragment: {
+      gl_FragColor: "vec4", gl_FragCoord: "vec4", gl_FrontFacing: "bool", gl_PointCoord: "vec2",
+      gl_FragData: "vec4[1]",
+    },
+  };
+
+  const GLSL_BUILTIN_CONSTANTS = {
+    gl_MaxVertexAttribs: 16, gl_MaxVertexUniformVectors: 256, gl_MaxVaryingVectors: 15,
+    gl_MaxVertexTextureImageUnits: 16, gl_MaxCombinedTextureImageUnits: 32, gl_MaxTextureImageUnits: 16,
+    gl_MaxFragmentUniformVectors: 224, gl_MaxDrawBuffers: 1,
+  };
+
+  /**
+   * Compile a GLSL ES 1.0 shader to JavaScript. Returns the attributes, uniforms and varyings it declares and the
+   * generated source of a factory: called with the runtime helpers ($), it returns { bind(U, A, V, G), main() },
+   * where U, A, V and G hold the uniforms, attributes, varyings and other globals (including gl_Position etc.).
+   * Throws an Error (with a line number) if the shader can not be compiled.
+   */
+  const glsl_compile = (source, stage) => {
+    const tokens = glsl_tokenize(glsl_preprocess(source));
+    let pos = 0;
+
+    const peek = (offset) => tokens[pos + (offset || 0)] || { kind: "eof", text: "", line: "end" };
+    const next = () => {
+      const token = peek();
+      pos++;
+      return token;
+    };
+    const fail = (message) => {
+      throw new Error("line " + peek().line + ": " + message);
+    };
+    const accept = (text) => {
+      if (peek().text === text && peek().kind != "eof") {
+        pos++;
+        return true;
+      }
+      return false;
+    };
+    const expect = (text) => {
+      if (!accept(text)) fail("expected '" + text + "' but found '" + (peek().text || "end of shader") + "'");
+    };
+    const identifier = () => {
+      if (peek().kind != "ident") fail("expected a name but found '" + peek().text + "'");
+      return next().text;
+    };
+    const skip_precision = () => {
+      while (["lowp", "mediump", "highp"].includes(peek().text)) pos++;
+    };
+    const is_type = (text) => GLSL_TYPES[text] !== undefined;
+
+    const attributes = [];
+    const uniforms = [];
+    const varyings = [];
+    const globals_init = [];
+    const functions = new Map();  // name -> [{ params, type, js }]
+    const function_code = [];
+    let return_type = null;
+    let uses_frag_data = false;
+
+    const scopes = [new Map()];
+    const declare = (name, symbol) => {
+      const scope = scopes[scopes.length - 1];
+      if (scope.has(name)) fail("'" + name + "' is already declared");
+      scope.set(name, symbol);
+    };
+    const lookup = (name) => {
+      for (let i = scopes.length - 1; i >= 0; i--) {
+        if (scopes[i].has(name)) return scopes[i].get(name);
+      }
+      const builtin = GLSL_BUILTIN_VARIABLES[stage][name];
+      if (builtin) {
+        if (name == "gl_FragData") {
+          uses_frag_data = true;
+          return { type: "vec4", array: 1, code: "G.gl_FragData", writable: true };
+        }
+        return { type: builtin, code: "G." + name, writable: true };
+      }
+      if (GLSL_BUILTIN_CONSTANTS[name] !== undefined) {
+        return { type: "int", code: String(GLSL_BUILTIN_CONSTANTS[name]), constant: GLSL_BUILTIN_CONSTANTS[name] };
+      }
+      fail("'" + name + "' is not declared");
+    };
+
+    const components = (type) => GLSL_TYPES[type].n;
+    const base_of = (type) => GLSL_TYPES[type].base;
+    const is_scalar = (type) => components(type) == 1 && base_of(type) != "sampler";
+    const is_matrix = (type) => GLSL_TYPES[type].dim !== undefined;
+    const is_aggregate = (type, array) => array !== undefined || components(type) > 1;
+    const is_simple = (code) => /^[\w.$]+$/.test(code);
+    const value = (code, type, fresh) => ({ code: code, type: type, fresh: fresh !== false });
+    const copied = (expression) =>
+      is_aggregate(expression.type, expression.array) && !expression.fresh
+        ? "$.copy(" + expression.code + ")" : expression.code;
+
+    const array_size = () => {
+      const size = parse_conditional();
+      if (size.constant === undefined || size.constant <= 0) fail("array size must be a positive constant");
+      expect("]");
+      return size.constant;
+    };
+
+    // Expressions. Each returns { code, type, fresh, lvalue?, constant?, array? }. fresh is false for values that
+    // alias a variable (and must be copied when stored), lvalue describes how to assign to the expression.
+
+    const arithmetic = (op, a, b) => {
+      const name = { "+": "add", "-": "sub", "*": "mul", "/": "div" }[op];
+      if (is_scalar(a.type) && is_scalar(b.type)) {
+        const int = base_of(a.type) == "int" && base_of(b.type) == "int";
+        const code = "(" + a.code + " " + op + " " + b.code + ")";
+        const result = value(int ? "(" + code + " | 0)" : code, int ? "int" : "float");
+        if (a.constant !== undefined && b.constant !== undefined) {
+          result.constant = new Function("return " + result.code + ";")();
+        }
+        return result;
+      }
+      if (op == "*" && is_matrix(a.type) && is_matrix(b.type)) {
+        return value("$.mul_mm(" + a.code + ", " + b.code + ", " + GLSL_TYPES[a.type].dim + ")", a.type);
+      }
+      if (op == "*" && is_matrix(a.type) && !is_scalar(b.type)) {
+        return value("$.mul_mv(" + a.code + ", " + b.code + ", " + GLSL_TYPES[a.type].dim + ")", b.type);
+      }
+      if (op == "*" && is_matrix(b.type) && !is_scalar(a.type)) {
+        return value("$.mul_vm(" + a.code + ", " + b.code + ", " + GLSL_TYPES[b.type].dim + ")", a.type);
+      }
+      if (is_scalar(a.type)) {
+        return value("$." + name + "_sv(" + a.code + ", " + b.code + ")", b.type);
+      }
+      if (is_scalar(b.type)) {
+        return value("$." + name + "_vs(" + a.code + ", " + b.code + ")", a.type);
+      }
+      if (components(a.type) != components(b.type)) fail("mismatched operands " + a.type + " " + op + " " + b.type);
+      return value("$." + name + "_vv(" + a.code + ", " + b.code + ")", a.type);
+    };
+
+    const binary = (op, a, b) => {
+      switch (op) {
+        case "+": case "-": case "*": case "/":
+          return arithmetic(op, a, b);
+        case "<": case ">": case "<=": case ">=":
+          return value("(" + a.code + " " + op + " " + b.code + ")", "bool");
+        case "==": case "!=":
+          if (is_aggregate(a.type, a.array)) {
+            return value((op == "!=" ? "!" : "") + "$.equal(" + a.code + ", " + b.code + ")", "bool");
+          }
+          return value("(" + a.code + " " + op + "= " + b.code + ")", "bool");
+        case "&&": case "||":
+          return value("(" + a.code + " " + op + " " + b.code + ")", "bool");
+        case "^^":
+          return value("(" + a.code + " !== " + b.code + ")", "bool");
+        default:
+          fail("unsupported operator '" + op + "'");
+      }
+    };
+
+    const assign = (target, source) => {
+      const lvalue = target.lvalue;
+      if (!lvalue) fail("cannot assign to this expression");
+      const code = copied(source);
+      switch (lvalue.kind) {
+        case "swizzle":
+          if (lvalue.indices.length == 1) {
+            return value("(" + lvalue.base + "[" + lvalue.indices[0] + "] = " + code + ")", target.type);
+          }
+          return value("$.set_swizzle(" + lvalue.base + ", [" + lvalue.indices.join(", ") + "], " + code + ")",
+            target.type, false);
+        case "column":
+          return value("$.set_column(" + lvalue.base + ", " + lvalue.index + ", " + lvalue.dim + ", " + code + ")",
+            target.type, false);
+        default:
+          return value("(" + lvalue.code + " = " + code + ")", target.type, source.fresh);
+      }
+    };
+
+    const constructor = (type, args) => {
+      const n = components(type);
+      if (args.length == 0) fail("constructor " + type + " needs arguments");
+      if (is_scalar(type)) {
+        const arg = args[0];
+        const scalar = is_scalar(arg.type) ? arg.code : arg.code + "[0]";
+        const from = is_scalar(arg.type) ? base_of(arg.type) : base_of(arg.type);
+        let code = scalar;
+        if (type == "int" && from != "int") code = "Math.trunc(" + scalar + ")";
+        if (type == "bool" && from != "bool") code = "(" + scalar + " != 0)";
+        if (type != "bool" && from == "bool") code = "(" + scalar + " ? 1 : 0)";
+        const result = value(code, type);
+        if (arg.constant !== undefined && is_scalar(arg.type)) {
+          result.constant = new Function("return " + code + ";")();
+        }
+        return result;
+      }
+      if (args.length == 1 && is_scalar(args[0].type)) {
+        return is_matrix(type)
+          ? value("$.mat_diagonal(" + args[0].code + ", " + GLSL_TYPES[type].dim + ")", type)
+          : value("$.splat(" + args[0].code + ", " + n + ")", type);
+      }
+      if (args.length == 1 && is_matrix(type) && is_matrix(args[0].type)) {
+        return value("$.mat_resize(" + args[0].code + ", " + GLSL_TYPES[args[0].type].dim + ", " +
+          GLSL_TYPES[type].dim + ")", type);
+      }
+      if (args.every((arg) => is_scalar(arg.type)) && args.length == n) {
+        return value("[" + args.map((arg) => arg.code).join(", ") + "]", type);
+      }
+      return value("$.flatten(" + n + ", [" + args.map((arg) => arg.code).join(", ") + "])", type);
+    };
+
+    const widest = (args) => {
+      const aggregate = args.find((arg) => !is_scalar(arg.type));
+      return aggregate ? aggregate.type : "float";
+    };
+
+    const builtin = (name, args) => {
+      const codes = args.map((arg) => arg.code).join(", ");
+      const arity = GLSL_COMPONENTWISE[name];
+      if (arity !== undefined || (name == "atan" && (args.length == 1 || args.length == 2))) {
+        const count = name == "atan" ? args.length : arity;
+        if (args.length != count) fail(name + "() takes " + count + " arguments");
+        const f = name == "atan" && count == 2 ? "atan2" : name;
+        const type = widest(args);
+        if (is_scalar(type)) return value("$.f." + f + "(" + codes + ")", "float");
+        return value("$.map" + count + "($.f." + f + ", " + codes + ")", type);
+      }
+      if (GLSL_RELATIONAL.includes(name)) {
+        return value("$.map2($.f." + name + ", " + codes + ")", glsl_vector_type("bool", components(args[0].type)));
+      }
+      switch (name) {
+        case "length": case "dot": case "distance":
+          return value("$." + name + "(" + codes + ")", "float");
+        case "normalize": case "cross": case "reflect": case "refract": case "faceforward":
+          return value("$." + name + "(" + codes + ")", args[0].type);
+        case "any": case "all":
+          return value("$." + name + "(" + codes + ")", "bool");
+        case "not":
+          return value("$.not(" + codes + ")", args[0].type);
+        case "texture2D": case "texture2DLod":
+          return value("$.texture2D(" + args[0].code + ", " + args[1].code + ")", "vec4");
+        case "texture2DProj": case "texture2DProjLod":
+          return value("$.texture2D_proj(" + args[0].code + ", " + args[1].code + ")", "vec4");
+        case "textureCube": case "textureCubeLod":
+          return value("$.texture_cube(" + codes + ")", "vec4");
+        default:
+          return null;
+      }
+    };
+
+    const call = (name, args) => {
+      if (is_type(name)) return constructor(name, args);
+      const overloads = functions.get(name);
+      if (overloads) {
+        const match = overloads.find((f) => f.params.length == args.length &&
+            f.params.every((param, i) => param.type == args[i].type)) ||
+          overloads.find((f) => f.params.length == args.length &&
+            f.params.every((param, i) => components(param.type) == components(args[i].type)));
+        if (!match) fail("no matching overload of " + name + "()");
+        return value(match.js + "(" + args.map(copied).join(", ") + ")", match.type);
+      }
+      const result = builtin(name, args);
+      if (!result) fail("unknown function " + name + "()");
+      return result;
+    };
+
+    const parse_primary = () => {
+      const token = peek();
+      if (token.kind == "number") {
+        pos++;
+        if (/^0[xX]/.test(token.text)) {
+          return Object.assign(value(String(parseInt(token.text, 16)), "int"), { constant: parseInt(token.text, 16) });
+        }
+        if (/[.eE]/.test(token.text)) {
+          const number = parseFloat(token.text);
+          return Object.assign(value(String(number), "float"), { constant: number });
+        }
+        return Object.assign(value(String(parseInt(token.text, 10)), "int"), { constant: parseInt(token.text, 10) });
+      }
+      if (token.text == "true" || token.text == "false") {
+        pos++;
+        return Object.assign(value(token.text, "bool"), { constant: token.text == "true" });
+      }
+      if (accept("(")) {
+        const inner = parse_expression();
+        expect(")");
+        return inner;
+      }
+      if (token.kind == "ident") {
+        pos++;
+        if (accept("(")) {
+          const args = [];
+          if (peek().text == "void" && peek(1).text == ")") pos++;
+          if (!accept(")")) {
+            do {
+              args.push(parse_assignment());
+            } while (accept(","));
+            expect(")");
+          }
+          return call(token.text, args);
+        }
+        const symbol = lookup(token.text);
+        const result = value(symbol.code, symbol.type, false);
+        result.array = symbol.array;
+        if (symbol.constant !== undefined) result.constant = symbol.constant;
+        if (symbol.writable) result.lvalue = { kind: "var", code: symbol.code };
+        return result;
+      }
+      fail("unexpected '" + (token.text || "end of shader") + "'");
+    };
+
+    const parse_postfix = () => {
+      let result = parse_primary();
+      for (;;) {
+        if (accept("[")) {
+          const index = parse_expression();
+          expect("]");
+          const writable = !!result.lvalue;
+          if (result.array !== undefined) {
+            const code = result.code + "[" + index.code + "]";
+            result = Object.assign(value(code, result.type, false), writable ? { lvalue: { kind: "var", code } } : {});
+          } else if (is_matrix(result.type)) {
+            const dim = GLSL_TYPES[result.type].dim;
+            const column = { base: result.code, index: index.code, dim: dim };
+            result = value("$.column(" + result.code + ", " + index.code + ", " + dim + ")", "vec" + dim);
+            result.column = column;
+            if (writable) result.lvalue = Object.assign({ kind: "column" }, column);
+          } else if (result.column) {
+            const code = result.column.base + "[(" + result.column.index + ") * " + result.column.dim + " + " +
+              index.code + "]";
+            result = Object.assign(value(code, "float", false), writable ? { lvalue: { kind: "var", code } } : {});
+          } else if (!is_scalar(result.type)) {
+            const base = is_simple(result.code) ? result.code : "(" + result.code + ")";
+            const code = base + "[" + index.code + "]";
+            result = Object.assign(value(code, base_of(result.type), false),
+              writable ? { lvalue: { kind: "var", code } } : {});
+          } else {
+            fail("cannot index a " + result.type);
+          }
+        } else if (accept(".")) {
+          const field = identifier();
+          if (is_scalar(result.type) || is_matrix(result.type) || result.array !== undefined) {
+            fail("cannot select ." + field + " from a " + result.type);
+          }
+          const set = GLSL_SWIZZLE_SETS.find((letters) => letters.includes(field[0]));
+          const indices = set ? [...field].map((letter) => set.indexOf(letter)) : [-1];
+          if (field.length > 4 || indices.some((index) => index < 0 || index >= components(result.type))) {
+            fail("invalid swizzle ." + field + " of a " + result.type);
+          }
+          const type = glsl_vector_type(base_of(result.type), indices.length);
+          const base = is_simple(result.code) ? result.code : "(" + result.code + ")";
+          const writable = !!result.lvalue && new Set(indices).size == indices.length;
+          if (indices.length == 1) {
+            result = value(base + "[" + indices[0] + "]", type, false);
+          } else if (is_simple(result.code)) {
+            result = value("[" + indices.map((index) => base + "[" + index + "]").join(", ") + "]", type);
+          } else {
+            result = value("$.swizzle(" + result.code + ", [" + indices.join(", ") + "])", type);
+          }
+          if (writable) result.lvalue = { kind: "swizzle", base: base, indices: indices };
+        } else if (peek().text == "++" || peek().text == "--") {
+          const op = next().text;
+          if (!result.lvalue || !is_scalar(result.type)) fail("operand of " + op + " must be a scalar variable");
+          result = value("(" + result.lvalue.code + op + ")", result.type);
+        } else {
+          return result;
+        }
+      }
+    };
+
+    const parse_unary = () => {
+      const op = peek().text;
+      if (peek().kind == "op" && (op == "-" || op == "+" || op == "!" || op == "++" || op == "--")) {
+        pos++;
+        const operand = parse_unary();
+        switch (op) {
+          case "+":
+            return operand;
+          case "!":
+            return value("(!" + operand.code + ")", "bool");
+          case "-": {
+            if (!is_scalar(operand.type)) return value("$.negate(" + operand.code + ")", operand.type);
+            const result = value("(-" + operand.code + ")", operand.type);
+            if (operand.constant !== undefined) result.constant = -operand.constant;
+            return result;
+          }
+          default: {
+            const one = value("1", base_of(operand.type) == "int" ? "int" : "float");
+            return assign(operand, arithmetic(op[0], operand, one));
+          }
+        }
+      }
+      return parse_postfix();
+    };
+
+    const BINARY_PRECEDENCE = [
+      ["||"], ["^^"], ["&&"], ["==", "!="], ["<", ">", "<=", ">="], ["+", "-"], ["*", "/"],
+    ];
+
+    const parse_binary = (level) => {
+      if (level == BINARY_PRECEDENCE.length) return parse_unary();
+      let left = parse_binary(level + 1);
+      while (peek().kind == "op" && BINARY_PRECEDENCE[level].includes(peek().text)) {
+        const op = next().text;
+        left = binary(op, left, parse_binary(level + 1));
+      }
+      return left;
+    };
+
+    const parse_conditional = () => {
+      const condition = parse_binary(0);
+      if (!accept("?")) return condition;
+      const a = parse_expression();
+      expect(":");
+      const b = parse_assignment();
+      return value("(" + condition.code + " ? " + a.code + " : " + b.code + ")", a.type, a.fresh && b.fresh);
+    };
+
+    const parse_assignment = () => {
+      const target = parse_conditional();
+      const op = peek().text;
+      if (peek().kind == "op" && ["=", "+=", "-=", "*=", "/="].includes(op)) {
+        pos++;
+        const source = parse_assignment();
+        return assign(target, op == "=" ? source : arithmetic(op[0], target, source));
+      }
+      return target;
+    };
+
+    const parse_expression = () => {
+      let result = parse_assignment();
+      while (accept(",")) {
+        const right = parse_assignment();
+        result = value("(" + result.code + ", " + right.code + ")", right.type, right.fresh);
+      }
+      return result;
+    };
+
+    // Statements, returned as JavaScript source.
+
+    const parse_declaration = (constant) => {
+      skip_precision();
+      const type = next().text;
+      const declarations = [];
+      do {
+        const name = identifier();
+        const array = accept("[") ? array_size() : undefined;
+        let init = array !== undefined
+          ? "[" + new Array(array).fill(glsl_zero(type)).join(", ") + "]" : glsl_zero(type);
+        let constant_value;
+        if (accept("=")) {
+          const expression = parse_assignment();
+          init = copied(expression);
+          constant_value = constant ? expression.constant : undefined;
+        }
+        const js = "l_" + name;
+        declare(name, { type: type, array: array, code: js, writable: !constant, constant: constant_value });
+        declarations.push(js + " = " + init);
+      } while (accept(","));
+      return "let " + declarations.join(", ") + ";";
+    };
+
+    const is_declaration = () => {
+      let offset = 0;
+      if (peek().text == "const") offset++;
+      while (["lowp", "mediump", "highp"].includes(peek(offset).text)) offset++;
+      return is_type(peek(offset).text) && peek(offset + 1).kind == "ident";
+    };
+
+    const parse_statement = () => {
+      const token = peek();
+      if (token.text == "{" && token.kind == "op") {
+        return parse_block();
+      }
+      if (accept("if")) {
+        expect("(");
+        const condition = parse_expression();
+        expect(")");
+        let code = "if (" + condition.code + ") " + parse_scoped_statement();
+        if (accept("else")) code += " else " + parse_scoped_statement();
+        return code;
+      }
+      if (accept("for")) {
+        expect("(");
+        scopes.push(new Map());
+        const init = is_declaration() ? parse_declaration(accept("const")).slice(0, -1) : parse_optional(";");
+        if (init.startsWith("let ")) expect(";");
+        const condition = parse_optional(";");
+        const step = peek().text == ")" ? "" : parse_expression().code;
+        expect(")");
+        const body = parse_scoped_statement();
+        scopes.pop();
+        return "for (" + init + "; " + condition + "; " + step + ") " + body;
+      }
+      if (accept("while")) {
+        expect("(");
+        const condition = parse_expression();
+        expect(")");
+        return "while (" + condition.code + ") " + parse_scoped_statement();
+      }
+      if (accept("do")) {
+        const body = parse_scoped_statement();
+        expect("while");
+        expect("(");
+        const condition = parse_expression();
+        expect(")");
+        expect(";");
+        return "do " + body + " while (" + condition.code + ");";
+      }
+      if (accept("return")) {
+        if (accept(";")) return "return;";
+        const result = parse_expression();
+        expect(";");
+        return "return " + (return_type && is_aggregate(return_type) ? copied(result) : result.code) + ";";
+      }
+      if (accept("break")) {
+        expect(";");
+        return "break;";
+      }
+      if (accept("continue")) {
+        expect(";");
+        return "continue;";
+      }
+      if (accept("discard")) {
+        if (stage != "fragment") fail("discard is only allowed in fragment shaders");
+        expect(";");
+        return "throw $.DISCARD;";
+      }
+      if (accept(";")) {
+        return ";";
+      }
+      if (is_declaration()) {
+        const code = parse_declaration(accept("const"));
+        expect(";");
+        return code;
+      }
+      const expression = parse_expression();
+      expect(";");
+      return expression.code + ";";
+    };
+
+    /// An expression followed by terminator, or nothing. Returns its code ("" if empty).
+    const parse_optional = (terminator) => {
+      if (accept(terminator)) return "";
+      const code = parse_expression().code;
+      expect(terminator);
+      return code;
+    };
+
+    const parse_scoped_statement = () => {
+      scopes.push(new Map());
+      const code = parse_statement();
+      scopes.pop();
+      return "{ " + code + " }";
+    };
+
+    const parse_block = () => {
+      expect("{");
+      scopes.push(new Map());
+      const statements = [];
+      while (!accept("}")) {
+        if (peek().kind == "eof") fail("unexpected end of shader");
+        statements.push(parse_statement());
+      }
+      scopes.pop();
+      return "{\n" + statements.join("\n") + "\n}";
+    };
+
+    // Global declarations.
+
+    const parse_function = (type, name) => {
+      const params = [];
+      if (!accept(")")) {
+        if (peek().text == "void" && peek(1).text == ")") pos++;
+        while (!accept(")")) {
+          while (["in", "const", "lowp", "mediump", "highp"].includes(peek().text)) pos++;
+          if (peek().text == "out" || peek().text == "inout") fail("out and inout parameters are not supported");
+          const param_type = next().text;
+          if (!is_type(param_type)) fail("unknown type '" + param_type + "'");
+          const param_name = peek().kind == "ident" ? next().text : "_" + params.length;
+          if (accept("[")) fail("array parameters are not supported");
+          params.push({ type: param_type, name: param_name });
+          if (peek().text != ")") expect(",");
+        }
+      }
+
+      const js = "f_" + name + "_" + params.map((param) => param.type).join("_");
+      const overloads = functions.get(name) || [];
+      if (!overloads.find((f) => f.js == js)) {
+        overloads.push({ params: params, type: type, js: js });
+        functions.set(name, overloads);
+      }
+      if (accept(";")) return;  // Prototype
+
+      scopes.push(new Map());
+      params.forEach((param) => declare(param.name, { type: param.type, code: "l_" + param.name, writable: true }));
+      return_type = type;
+      let body = parse_block();
+      return_type = null;
+      scopes.pop();
+
+      if (name == "main") {
+        body = "{\n" + globals_init.join("\n") + "\n" + body + "\n}";
+      }
+      function_code.push("function " + js + "(" + params.map((param) => "l_" + param.name).join(", ") + ") " +
+        body);
+    };
+
+    const parse_global = () => {
+      if (accept("precision")) {
+        skip_precision();
+        next();
+        expect(";");
+        return;
+      }
+      let qualifier = null;
+      if (accept("invariant")) {
+        const qualified = ["varying", "attribute", "uniform"].includes(peek().text) || is_type(peek().text);
+        if (peek().kind == "ident" && !qualified) {
+          while (!accept(";")) pos++;  // "invariant gl_Position;" has no effect here.
+          return;
+        }
+      }
+      if (["attribute", "uniform", "varying", "const"].includes(peek().text)) qualifier = next().text;
+      skip_precision();
+      if (peek().text == "struct") fail("structs are not supported");
+      const type = next().text;
+      if (!is_type(type)) fail("unknown type '" + type + "'");
+      const name = identifier();
+      if (accept("(")) {
+        if (qualifier) fail("functions can not be " + qualifier);
+        parse_function(type, name);
+        return;
+      }
+      if (qualifier == "attribute" && stage != "vertex") fail("attributes are only allowed in vertex shaders");
+
+      let declared = name;
+      for (;;) {
+        const array = accept("[") ? array_size() : undefined;
+        const symbol = { type: type, array: array };
+        if (qualifier == "attribute") {
+          symbol.code = "A." + declared;
+          attributes.push({ name: declared, type: type });
+        } else if (qualifier == "uniform") {
+          symbol.code = "U." + declared;
+          uniforms.push({ name: declared, type: type, size: array });
+        } else if (qualifier == "varying") {
+          symbol.code = "V." + declared;
+          symbol.writable = stage == "vertex";
+          varyings.push({ name: declared, type: type, size: array });
+        } else {
+          symbol.code = "G." + declared;
+          symbol.writable = qualifier != "const";
+        }
+
+        let init = array !== undefined
+          ? "[" + new Array(array).fill(glsl_zero(type)).join(", ") + "]" : glsl_zero(type);
+        if (accept("=")) {
+          if (qualifier == "attribute" || qualifier == "uniform" || qualifier == "varying") {
+            fail(qualifier + " variables can not be initialized");
+          }
+          const expression = parse_assignment();
+          init = copied(expression);
+          if (qualifier == "const") symbol.constant = expression.constant;
+        }
+        if (!qualifier || qualifier == "const" || (qualifier == "varying" && stage == "vertex")) {
+          globals_init.push(symbol.code + " = " + init + ";");
+        }
+        declare(declared, symbol);
+
+        if (!accept(",")) break;
+        declared = identifier();
+      }
+      expect(";");
+    };
+
+    while (peek().kind != "eof") {
+      parse_global();
+    }
+    if (!functions.has("main") || !function_code.some((code) => code.startsWith("function f_main_("))) {
+      throw new Error("no main() function");
+    }
+
+    const factory = [
+      "\"use strict\";",
+      "let U, A, V, G;",
+      ...function_code,
+      "return { bind: (u, a, v, g) => { U = u; A = a; V = v; G = g; }, main: f_main_ };",
+    ].join("\n");
+    return {
+      attributes: attributes,
+      uniforms: uniforms,
+      varyings: varyings,
+      uses_frag_data: uses_frag_data,
+      factory: new Function("$", factory),
+    };
+  };
+
+  // Shader runtime helpers ($ in the generated code). Vectors are arrays, matrices are column-major arrays.
+
+  const componentwise_vv = (f) => (a, b) => {
+    const result = new Array(a.length);
+    for (let i = 0; i < a.length; i++) result[i] = f(a[i], b[i]);
+    return result;
+  };
+  const componentwise_vs = (f) => (a, s) => {
+    const result = new Array(a.length);
+    for (let i = 0; i < a.length; i++) result[i] = f(a[i], s);
+    return result;
+  };
+  const componentwise_sv = (f) => (s, b) => {
+    const result = new Array(b.length);
+    for (let i = 0; i < b.length; i++) result[i] = f(s, b[i]);
+    return result;
+  };
+  const component = (x, i) => typeof x === "object" ? x[i] : x;
+  const dot = (a, b) => {
+    if (typeof a !== "object") return a * b;
+    let sum = 0;
+    for (let i = 0; i < a.length; i++) sum += a[i] * b[i];
+    return sum;
+  };
+  const operators = {
+    add: (a, b) => a + b,
+    sub: (a, b) => a - b,
+    mul: (a, b) => a * b,
+    div: (a, b) => a / b,
+  };
+
+  const glsl_helpers = {
+    DISCARD: { discard: true },
+    copy: (x) => x.slice(),
+    swizzle: (v, indices) => indices.map((index) => v[index]),
+    set_swizzle: (v, indices, x) => {
+      indices.forEach((index, i) => v[index] = component(x, i));
+      return x;
+    },
+    column: (m, i, dim) => m.slice(i * dim, i * dim + dim),
+    set_column: (m, i, dim, v) => {
+      for (let j = 0; j < dim; j++) m[i * dim + j] = v[j];
+      return v;
+    },
+    splat: (s, n) => new Array(n).fill(s),
+    flatten: (n, args) => {
+      const result = [];
+      for (const arg of args) {
+        if (typeof arg === "object") result.push(...arg);
+        else result.push(arg);
+      }
+      if (result.length < n) throw new Error("not enough data for constructor");
+      return result.slice(0, n);
+    },
+    mat_diagonal: (s, dim) => {
+      const result = new Array(dim * dim).fill(0);
+      for (let i = 0; i < dim; i++) result[i * dim + i] = s;
+      return result;
+    },
+    mat_resize: (m, from, to) => {
+      const result = new Array(to * to);
+      for (let j = 0; j < to; j++) {
+        for (let i = 0; i < to; i++) {
+          result[j * to + i] = (i < from && j < from) ? m[j * from + i] : (i == j ? 1 : 0);
+        }
+      }
+      return result;
+    },
+    mul_mv: (m, v, dim) => {
+      const result = new Array(dim).fill(0);
+      for (let j = 0; j < dim; j++) {
+        for (let i = 0; i < dim; i++) result[i] += m[j * dim + i] * v[j];
+      }
+      return result;
+    },
+    mul_vm: (v, m, dim) => {
+      const result = new Array(dim).fill(0);
+      for (let j = 0; j < dim; j++) {
+        for (let i = 0; i < dim; i++) result[j] += v[i] * m[j * dim + i];
+      }
+      return result;
+    },
+    mul_mm: (a, b, dim) => {
+      const result = new Array(dim * dim).fill(0);
+      for (let j = 0; j < dim; j++) {
+        for (let k = 0; k < dim; k++) {
+          const factor = b[j * dim + k];
+          for (let i = 0; i < dim; i++) result[j * dim + i] += a[k * dim + i] * factor;
+        }
+      }
+      return result;
+    },
+    negate: (v) => v.map((x) => -x),
+    equal: (a, b) => a.length == b.length && a.every((x, i) => x === b[i]),
+    map1: (f, x) => x.map((a) => f(a)),
+    map2: (f, x, y) => {
+      const n = typeof x === "object" ? x.length : y.length;
+      const result = new Array(n);
+      for (let i = 0; i < n; i++) result[i] = f(component(x, i), component(y, i));
+      return result;
+    },
+    map3: (f, x, y, z) => {
+      const n = typeof x === "object" ? x.length : typeof y === "object" ? y.length : z.length;
+      const result = new Array(n);
+      for (let i = 0; i < n; i++) result[i] = f(component(x, i), component(y, i), component(z, i));
+      return result;
+    },
+    f: {
+      radians: (x) => x * Math.PI / 180,
+      degrees: (x) => x * 180 / Math.PI,
+      sin: Math.sin, cos: Math.cos, tan: Math.tan, asin: Math.asin, acos: Math.acos, atan: Math.atan,
+      atan2: Math.atan2, exp: Math.exp, log: Math.log, exp2: (x) => Math.pow(2, x), log2: Math.log2,
+      sqrt: Math.sqrt, inversesqrt: (x) => 1 / Math.sqrt(x), abs: Math.abs, sign: Math.sign,
+      floor: Math.floor, ceil: Math.ceil, fract: (x) => x - Math.floor(x), pow: Math.pow,
+      mod: (x, y) => x - y * Math.floor(x / y), min: Math.min, max: Math.max,
+      step: (edge, x) => x < edge ? 0 : 1, matrixCompMult: (a, b) => a * b,
+      clamp: (x, low, high) => Math.min(Math.max(x, low), high),
+      mix: (x, y, a) => x * (1 - a) + y * a,
+      smoothstep: (edge0, edge1, x) => {
+        const t = Math.min(Math.max((x - edge0) / (edge1 - edge0), 0), 1);
+        return t * t * (3 - 2 * t);
+      },
+      lessThan: (a, b) => a < b, lessThanEqual: (a, b) => a <= b, greaterThan: (a, b) => a > b,
+      greaterThanEqual: (a, b) => a >= b, equal: (a, b) => a == b, notEqual: (a, b) => a != b,
+    },
+    dot: dot,
+    length: (x) => Math.sqrt(dot(x, x)),
+    distance: (a, b) => {
+      if (typeof a !== "object") return Math.abs(a - b);
+      let sum = 0;
+      for (let i = 0; i < a.length; i++) sum += (a[i] - b[i]) * (a[i] - b[i]);
+      return Math.sqrt(sum);
+    },
+    normalize: (x) => {
+      if (typeof x !== "object") return Math.sign(x);
+      const scale = 1 / Math.sqrt(dot(x, x));
+      return x.map((a) => a * scale);
+    },
+    cross: (a, b) => [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]],
+    reflect: (i, n) => {
+      const d = 2 * dot(n, i);
+      return typeof i === "object" ? i.map((x, k) => x - d * n[k]) : i - d * n;
+    },
+    refract: (i, n, eta) => {
+      const d = dot(n, i);
+      const k = 1 - eta * eta * (1 - d * d);
+      if (k < 0) return typeof i === "object" ? i.map(() => 0) : 0;
+      const f = eta * d + Math.sqrt(k);
+      return typeof i === "object" ? i.map((x, j) => eta * x - f * n[j]) : eta * i - f * n;
+    },
+    faceforward: (n, i, nref) => dot(nref, i) < 0 ? (typeof n === "object" ? n.slice() : n)
+      : (typeof n === "object" ? n.map((x) => -x) : -n),
+    any: (v) => v.some((x) => x),
+    all: (v) => v.every((x) => x),
+    not: (v) => v.map((x) => !x),
+  };
+  for (const [name, f] of Object.entries(operators)) {
+    glsl_helpers[name + "_vv"] = componentwise_vv(f);
+    glsl_helpers[name + "_vs"] = componentwise_vs(f);
+    glsl_helpers[name + "_sv"] = componentwise_sv(f);
+  }
+
+  /// Bytes per pixel of the texture formats/types we understand, with a decoder to normalized RGBA.
+  const texel_decoder = (format, type) => {
+    const channels = { [GL.RGBA]: 4, [GL.RGB]: 3, [GL.LUMINANCE_ALPHA]: 2, [GL.LUMINANCE]: 1, [GL.ALPHA]: 1 }[format];
+    if (!channels) return null;
+    const expand = (values, out, offset) => {
+      switch (format) {
+        case GL.RGBA: out[offset] = values[0]; out[offset + 1] = values[1]; out[offset + 2] = values[2];
+          out[offset + 3] = values[3]; break;
+        case GL.RGB: out[offset] = values[0]; out[offset + 1] = values[1]; out[offset + 2] = values[2];
+          out[offset + 3] = 1; break;
+        case GL.LUMINANCE_ALPHA: out[offset] = out[offset + 1] = out[offset + 2] = values[0];
+          out[offset + 3] = values[1]; break;
+        case GL.LUMINANCE: out[offset] = out[offset + 1] = out[offset + 2] = values[0]; out[offset + 3] = 1; break;
+        case GL.ALPHA: out[offset] = out[offset + 1] = out[offset + 2] = 0; out[offset + 3] = values[0]; break;
+      }
+    };
+    const values = [0, 0, 0, 0];
+    switch (type) {
+      case GL.UNSIGNED_BYTE:
+        return {
+          size: channels, decode: (bytes, view, at, out, offset) => {
+            for (let c = 0; c < channels; c++) values[c] = bytes[at + c] / 255;
+            expand(values, out, offset);
+          },
+        };
+      case GL.FLOAT:
+        return {
+          size: channels * 4, decode: (bytes, view, at, out, offset) => {
+            for (let c = 0; c < channels; c++) values[c] = view.getFloat32(at + c * 4, true);
+            expand(values, out, offset);
+          },
+        };
+      case GL.UNSIGNED_SHORT_5_6_5:
+        return {
+          size: 2, decode: (bytes, view, at, out, offset) => {
+            const v = view.getUint16(at, true);
+            expand([(v >> 11) / 31, ((v >> 5) & 63) / 63, (v & 31) / 31, 1], out, offset);
+          },
+        };
+      case GL.UNSIGNED_SHORT_4_4_4_4:
+        return {
+          size: 2, decode: (bytes, view, at, out, offset) => {
+            const v = view.getUint16(at, true);
+            expand([(v >> 12) / 15, ((v >> 8) & 15) / 15, ((v >> 4) & 15) / 15, (v & 15) / 15], out, offset);
+          },
+        };
+      case GL.UNSIGNED_SHORT_5_5_5_1:
+        return {
+          size: 2, decode: (bytes, view, at, out, offset) => {
+            const v = view.getUint16(at, true);
+            expand([(v >> 11) / 31, ((v >> 6) & 31) / 31, ((v >> 1) & 31) / 31, v & 1], out, offset);
+          },
+        };
+      default:
+        return null;
+    }
+  };
+
+  /// Wrap a texture coordinate (in texels) to [0, size).
+  const wrap = (mode, i, size) => {
+    switch (mode) {
+      case GL.CLAMP_TO_EDGE:
+        return i < 0 ? 0 : i >= size ? size - 1 : i;
+      case GL.MIRRORED_REPEAT: {
+        const period = ((i % (2 * size)) + 2 * size) % (2 * size);
+        return period < size ? period : 2 * size - 1 - period;
+      }
+      default:
+        return ((i % size) + size) % size;
+    }
+  };
+
+  const blend_factor = (factor, src, dst, constant, channel, out) => {
+    switch (factor) {
+      case GL.ZERO: return 0;
+      case GL.ONE: return 1;
+      case GL.SRC_COLOR: return src[channel];
+      case GL.ONE_MINUS_SRC_COLOR: return 1 - src[channel];
+      case GL.DST_COLOR: return dst[channel];
+      case GL.ONE_MINUS_DST_COLOR: return 1 - dst[channel];
+      case GL.SRC_ALPHA: return src[3];
+      case GL.ONE_MINUS_SRC_ALPHA: return 1 - src[3];
+      case GL.DST_ALPHA: return dst[3];
+      case GL.ONE_MINUS_DST_ALPHA: return 1 - dst[3];
+      case GL.CONSTANT_COLOR: return constant[channel];
+      case GL.ONE_MINUS_CONSTANT_COLOR: return 1 - constant[channel];
+      case GL.CONSTANT_ALPHA: return constant[3];
+      case GL.ONE_MINUS_CONSTANT_ALPHA: return 1 - constant[3];
+      case GL.SRC_ALPHA_SATURATE: return channel == 3 ? 1 : Math.min(src[3], 1 - dst[3]);
+      default: return out;
+    }
+  };
+
+  const depth_passes = (func, z, stored) => {
+    switch (func) {
+      case GL.NEVER: return false;
+      case GL.LESS: return z < stored;
+      case GL.EQUAL: return z == stored;
+      case GL.LEQUAL: return z <= stored;
+      case GL.GREATER: return z > stored;
+      case GL.NOTEQUAL: return z != stored;
+      case GL.GEQUAL: return z >= stored;
+      default: return true;
+    }
+  };
+
+  /// Read one component of a vertex attribute from a buffer.
+  const attribute_reader = (type, normalized) => {
+    switch (type) {
+      case GL.FLOAT: return (view, at) => view.getFloat32(at, true);
+      case GL.BYTE:
+        return normalized ? (view, at) => Math.max(view.getInt8(at) / 127, -1) : (view, at) => view.getInt8(at);
+      case GL.UNSIGNED_BYTE:
+        return normalized ? (view, at) => view.getUint8(at) / 255 : (view, at) => view.getUint8(at);
+      case GL.SHORT:
+        return normalized ? (view, at) => Math.max(view.getInt16(at, true) / 32767, -1)
+          : (view, at) => view.getInt16(at, true);
+      case GL.UNSIGNED_SHORT:
+        return normalized ? (view, at) => view.getUint16(at, true) / 65535 : (view, at) => view.getUint16(at, true);
+      case GL.INT: return (view, at) => view.getInt32(at, true);
+      case GL.UNSIGNED_INT: return (view, at) => view.getUint32(at, true);
+      default: return null;
+    }
+  };
+
+  const ATTRIBUTE_TYPE_SIZES = {
+    [GL.FLOAT]: 4, [GL.BYTE]: 1, [GL.UNSIGNED_BYTE]: 1, [GL.SHORT]: 2, [GL.UNSIGNED_SHORT]: 2, [GL.INT]: 4,
+    [GL.UNSIGNED_INT]: 4,
+  };
+
+  const MAX_VERTEX_ATTRIBS = 16;
+  const MAX_TEXTURE_UNITS = 16;
+
+  return (canvas) => {
+    const width = canvas.width || 300;
+    const height = canvas.height || 150;
+    const display = typeof canvas.getContext === "function" ? canvas.getContext("2d") : null;
+
+    // Default framebuffer, rows bottom to top like GL.
+    const color = new Uint8Array(width * height * 4);
+    const depth = new Float32Array(width * height).fill(1);
+
+    /// What draws and clears write to (see render_target()): its size, RGBA color (null if none), the value of a fully
+    /// saturated color channel in it (255 for bytes, 1 for the floats of texture levels), and depth (null if none).
+    const default_target = { width: width, height: height, color: color, scale: 255, depth: depth };
+
+    let error = GL.NO_ERROR;
+    const set_error = (code) => {
+      if (error == GL.NO_ERROR) error = code;
+    };
+
+    const new_vertex_array = () => ({
+      attributes: Array.from({ length: MAX_VERTEX_ATTRIBS }, () => ({
+        enabled: false, buffer: null, size: 4, type: GL.FLOAT, normalized: false, stride: 0, offset: 0, divisor: 0,
+      })),
+      element_buffer: null,
+    });
+    const default_vertex_array = new_vertex_array();
+
+    const state = {
+      viewport: [0, 0, width, height],
+      scissor: [0, 0, width, height],
+      clear_color: [0, 0, 0, 0],
+      clear_depth: 1,
+      caps: new Map(),
+      depth_func: GL.LESS,
+      depth_mask: true,
+      color_mask: [true, true, true, true],
+      blend_src_rgb: GL.ONE, blend_dst_rgb: GL.ZERO, blend_src_alpha: GL.ONE, blend_dst_alpha: GL.ZERO,
+      blend_equation_rgb: GL.FUNC_ADD, blend_equation_alpha: GL.FUNC_ADD,
+      blend_color: [0, 0, 0, 0],
+      cull_face: GL.BACK,
+      front_face: GL.CCW,
+      program: null,
+      framebuffer: null,
+      renderbuffer: null,
+      array_buffer: null,
+      vertex_array: default_vertex_array,
+      active_texture: 0,
+      texture_units: Array.from({ length: MAX_TEXTURE_UNITS }, () => null),
+      unpack_alignment: 4,
+      pack_alignment: 4,
+      generic_attributes: Array.from({ length: MAX_VERTEX_ATTRIBS }, () => [0, 0, 0, 1]),
+    };
+    const enabled = (cap) => state.caps.get(cap) === true;
+
+    // Texture sampling for the shaders.
+    const sample = (texture, s, t) => {
+      const level = texture && texture.levels[0];
+      if (!level || !texture_complete(texture)) return [0, 0, 0, 1];
+      const data = level.data;
+      const x = s * level.width;
+      const y = t * level.height;
+      if (texture.mag_filter == GL.NEAREST) {
+        const i = wrap(texture.wrap_s, Math.floor(x), level.width);
+        const j = wrap(texture.wrap_t, Math.floor(y), level.height);
+        const at = (j * level.width + i) * 4;
+        return [data[at], data[at + 1], data[at + 2], data[at + 3]];
+      }
+      const x0 = Math.floor(x - 0.5);
+      const y0 = Math.floor(y - 0.5);
+      const fx = x - 0.5 - x0;
+      const fy = y - 0.5 - y0;
+      const i0 = wrap(texture.wrap_s, x0, level.width);
+      const i1 = wrap(texture.wrap_s, x0 + 1, level.width);
+      const j0 = wrap(texture.wrap_t, y0, level.height);
+      const j1 = wrap(texture.wrap_t, y0 + 1, level.height);
+      const result = [0, 0, 0, 0];
+      for (let c = 0; c < 4; c++) {
+        const top = data[(j0 * level.width + i0) * 4 + c] * (1 - fx) + data[(j0 * level.width + i1) * 4 + c] * fx;
+        const bottom = data[(j1 * level.width + i0) * 4 + c] * (1 - fx) + data[(j1 * level.width + i1) * 4 + c] * fx;
+        result[c] = top * (1 - fy) + bottom * fy;
+      }
+      return result;
+    };
+
+    /// Like WebGL, a texture whose minification filter needs mipmaps that it does not have samples as black.
+    const texture_complete = (texture) => {
+      if (texture.min_filter == GL.NEAREST || texture.min_filter == GL.LINEAR) return true;
+      let w = texture.levels[0].width;
+      let h = texture.levels[0].height;
+      for (let i = 1; w > 1 || h > 1; i++) {
+        w = Math.max(w >> 1, 1);
+        h = Math.max(h >> 1, 1);
+        const level = texture.levels[i];
+        if (!level || level.width != w || level.height != h) return false;
+      }
+      return true;
+    };
+
+    const shader_runtime = Object.assign(Object.create(glsl_helpers), {
+      texture2D: (unit, coord) => sample(state.texture_units[unit], coord[0], coord[1]),
+      texture2D_proj: (unit, coord) => {
+        const q = coord[coord.length - 1];
+        return sample(state.texture_units[unit], coord[0] / q, coord[1] / q);
+      },
+      texture_cube: () => [0, 0, 0, 1],
+    });
+
+    const bound_buffer = (target) => {
+      if (target == GL.ARRAY_BUFFER) return state.array_buffer;
+      if (target == GL.ELEMENT_ARRAY_BUFFER) return state.vertex_array.element_buffer;
+      set_error(GL.INVALID_ENUM);
+      return null;
+    };
+
+    const bound_texture = (target) => {
+      if (target != GL.TEXTURE_2D) {
+        set_error(GL.INVALID_ENUM);
+        return null;
+      }
+      return state.texture_units[state.active_texture];
+    };
+
+    /// Decode uploaded pixels into the normalized RGBA storage of a texture level.
+    const texture_level = (width, height, format, type, pixels) => {
+      const data = new Float32Array(width * height * 4);
+      if (!pixels) return { width: width, height: height, data: data };
+      const decoder = texel_decoder(format, type);
+      if (!decoder) {
+        set_error(GL.INVALID_ENUM);
+        return null;
+      }
+      upload_pixels(data, width, 0, 0, width, height, decoder, pixels);
+      return { width: width, height: height, data: data };
+    };
+
+    /// The next smaller mipmap level of a texture level, by averaging 2x2 texels (clamped at odd edges).
+    const texture_level_half = (level) => {
+      const width = Math.max(level.width >> 1, 1);
+      const height = Math.max(level.height >> 1, 1);
+      const data = new Float32Array(width * height * 4);
+      const source = level.data;
+      for (let y = 0; y < height; y++) {
+        const y0 = Math.min(y * 2, level.height - 1) * level.width;
+        const y1 = Math.min(y * 2 + 1, level.height - 1) * level.width;
+        for (let x = 0; x < width; x++) {
+          const x0 = Math.min(x * 2, level.width - 1);
+          const x1 = Math.min(x * 2 + 1, level.width - 1);
+          for (let c = 0; c < 4; c++) {
+            data[(y * width + x) * 4 + c] = (source[(y0 + x0) * 4 + c] + source[(y0 + x1) * 4 + c] +
+              source[(y1 + x0) * 4 + c] + source[(y1 + x1) * 4 + c]) / 4;
+          }
+        }
+      }
+      return { width: width, height: height, data: data };
+    };
+
+    const upload_pixels = (data, level_width, x, y, width, height, decoder, pixels) => {
+      const bytes = new Uint8Array(pixels.buffer, pixels.byteOffset, pixels.byteLength);
+      const view = new DataView(pixels.buffer, pixels.byteOffset, pixels.byteLength);
+      const alignment = state.unpack_alignment;
+      const row_bytes = Math.ceil(width * decoder.size / alignment) * alignment;
+      for (let j = 0; j < height; j++) {
+        for (let i = 0; i < width; i++) {
+          const at = j * row_bytes + i * decoder.size;
+          if (at + decoder.size > bytes.length) return;
+          decoder.decode(bytes, view, at, data, ((y + j) * level_width + x + i) * 4);
+        }
+      }
+    };
+
+    // Vertex processing.
+
+    /// Prepare to fetch the active attributes of the current program for a draw.
+    const attribute_fetchers = (program) => program.attributes.map((attribute) => {
+      const n = GLSL_TYPES[attribute.type].n;
+      const pointer = state.vertex_array.attributes[attribute.location];
+      const target = new Array(n).fill(0);
+      if (!pointer.enabled || !pointer.buffer) {
+        const generic = state.generic_attributes[attribute.location];
+        return { name: attribute.name, scalar: n == 1, value: n == 1 ? generic[0] : generic.slice(0, n) };
+      }
+      const read = attribute_reader(pointer.type, pointer.normalized);
+      const stride = pointer.stride || pointer.size * ATTRIBUTE_TYPE_SIZES[pointer.type];
+      const view = new DataView(pointer.buffer.data.buffer);
+      return {
+        name: attribute.name, scalar: n == 1, divisor: pointer.divisor,
+        fetch: (index) => {
+          const at = pointer.offset + index * stride;
+          for (let c = 0; c < n; c++) {
+            target[c] = c < pointer.size ? (at + c * 4 < view.byteLength || pointer.type != GL.FLOAT
+              ? read(view, at + c * ATTRIBUTE_TYPE_SIZES[pointer.type]) : 0) : (c == 3 ? 1 : 0);
+          }
+          return n == 1 ? target[0] : target;
+        },
+      };
+    });
+
+    const run_vertex = (program, fetchers, attributes, index, instance) => {
+      for (const fetcher of fetchers) {
+        if (fetcher.fetch) {
+          const element = fetcher.divisor ? Math.floor(instance / fetcher.divisor) : index;
+          attributes[fetcher.name] = fetcher.fetch(element);
+        } else {
+          attributes[fetcher.name] = fetcher.value;
+        }
+      }
+      const globals = program.vertex_globals;
+      globals.gl_Position = [0, 0, 0, 1];
+      globals.gl_PointSize = 1;
+      program.vertex.main();
+
+      const varyings = new Float64Array(program.varying_size);
+      for (const varying of program.varying_layout) {
+        const value = program.vertex_varyings[varying.name];
+        if (varying.n == 1) varyings[varying.offset] = +value;
+        else for (let c = 0; c < varying.n; c++) varyings[varying.offset + c] = +value[c];
+      }
+      return { clip: globals.gl_Position.slice(), point_size: globals.gl_PointSize, varyings: varyings };
+    };
+
+    // Fragment processing.
+
+    const fragment_shader = (program, target) => {
+      const globals = program.fragment_globals;
+      const varyings = program.fragment_varyings;
+      const layout = program.varying_layout;
+      for (const varying of layout) {
+        if (varying.n > 1) varyings[varying.name] = new Array(varying.n).fill(0);
+      }
+      const source = [0, 0, 0, 0];
+      const destination = [0, 0, 0, 0];
+
+      const color = target.color;
+      const scale = target.scale;
+      const depth = target.depth;
+      const blending = enabled(GL.BLEND);
+      const depth_test = enabled(GL.DEPTH_TEST) && depth;  // Without a depth buffer, the test always passes.
+      const write_depth = depth_test && state.depth_mask;
+      const mask = state.color_mask;
+
+      /// Shade and write pixel (x, y) with depth z, interpolated varyings and gl_FragCoord.w.
+      return (x, y, z, interpolated, w, front_facing, point_coord) => {
+        const pixel = y * target.width + x;
+        if (depth_test && !depth_passes(state.depth_func, z, depth[pixel])) return;
+
+        for (const varying of layout) {
+          if (varying.n == 1) {
+            varyings[varying.name] = interpolated[varying.offset];
+          } else {
+            const value = varyings[varying.name];
+            for (let c = 0; c < varying.n; c++) value[c] = interpolated[varying.offset + c];
+          }
+        }
+        globals.gl_FragCoord = [x + 0.5, y + 0.5, z, w];
+        globals.gl_FrontFacing = front_facing;
+        globals.gl_PointCoord = point_coord || [0.5, 0.5];
+        globals.gl_FragColor = [0, 0, 0, 0];
+        if (program.uses_frag_data) globals.gl_FragData = [[0, 0, 0, 0]];
+        try {
+          program.fragment.main();
+        } catch (exception) {
+          if (exception === glsl_helpers.DISCARD) return;
+          throw exception;
+        }
+
+        const result = program.uses_frag_data ? globals.gl_FragData[0] : globals.gl_FragColor;
+        for (let c = 0; c < 4; c++) source[c] = Math.min(Math.max(+result[c], 0), 1);
+        if (write_depth) depth[pixel] = z;
+        if (!color) return;
+
+        const at = pixel * 4;
+        if (blending) {
+          for (let c = 0; c < 4; c++) destination[c] = color[at + c] / scale;
+          for (let c = 0; c < 4; c++) {
+            const alpha = c == 3;
+            const s = source[c] * blend_factor(alpha ? state.blend_src_alpha : state.blend_src_rgb,
+              source, destination, state.blend_color, c, 1);
+            const d = destination[c] * blend_factor(alpha ? state.blend_dst_alpha : state.blend_dst_rgb,
+              source, destination, state.blend_color, c, 0);
+            switch (alpha ? state.blend_equation_alpha : state.blend_equation_rgb) {
+              case GL.FUNC_SUBTRACT: source[c] = s - d; break;
+              case GL.FUNC_REVERSE_SUBTRACT: source[c] = d - s; break;
+              case GL.MIN: source[c] = Math.min(source[c], destination[c]); break;
+              case GL.MAX: source[c] = Math.max(source[c], destination[c]); break;
+              default: source[c] = s + d; break;
+            }
+          }
+        }
+        for (let c = 0; c < 4; c++) {
+          if (mask[c]) color[at + c] = Math.round(Math.min(Math.max(source[c], 0), 1) * 255) * scale / 255;
+        }
+      };
+    };
+
+    // Rasterization.
+
+    /// The pixel rectangle that may be written: the render target, clipped to the scissor box when enabled.
+    const draw_bounds = (target) => {
+      let [x0, y0, x1, y1] = [0, 0, target.width, target.height];
+      if (enabled(GL.SCISSOR_TEST)) {
+        const [sx, sy, sw, sh] = state.scissor;
+        x0 = Math.max(x0, sx);
+        y0 = Math.max(y0, sy);
+        x1 = Math.min(x1, sx + sw);
+        y1 = Math.min(y1, sy + sh);
+      }
+      return [x0, y0, x1, y1];
+    };
+
+    /// Clip space to window coordinates (x, y in pixels, z in [0, 1]) and 1/w.
+    const to_window = (vertex) => {
+      const [x, y, z, w] = vertex.clip;
+      const [vx, vy, vw, vh] = state.viewport;
+      const inverse_w = 1 / w;
+      return {
+        x: vx + (x * inverse_w + 1) * vw / 2,
+        y: vy + (y * inverse_w + 1) * vh / 2,
+        z: (z * inverse_w + 1) / 2,
+        inverse_w: inverse_w,
+        varyings: vertex.varyings,
+        point_size: vertex.point_size,
+      };
+    };
+
+    /// Clip a triangle against the near plane (z >= -w), the only plane that needs real clipping. The others are
+    /// handled per pixel. Returns the resulting polygon.
+    const clip_near = (polygon) => {
+      const distance = (vertex) => vertex.clip[2] + vertex.clip[3];
+      if (polygon.every((vertex) => distance(vertex) >= 0)) return polygon;
+      const result = [];
+      for (let i = 0; i < polygon.length; i++) {
+        const a = polygon[i];
+        const b = polygon[(i + 1) % polygon.length];
+        const da = distance(a);
+        const db = distance(b);
+        if (da >= 0) result.push(a);
+        if ((da >= 0) != (db >= 0)) {
+          const t = da / (da - db);
+          const varyings = new Float64Array(a.varyings.length);
+          for (let k = 0; k < varyings.length; k++) varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+          result.push({
+            clip: a.clip.map((value, k) => value + (b.clip[k] - value) * t),
+            point_size: a.point_size,
+            varyings: varyings,
+          });
+        }
+      }
+      return result;
+    };
+
+    const rasterize_triangle = (shade, v0, v1, v2, bounds) => {
+      const area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+      if (area == 0 || !isFinite(area)) return;
+      const front_facing = (area > 0) == (state.front_face == GL.CCW);
+      if (enabled(GL.CULL_FACE)) {
+        const cull = state.cull_face;
+        if (cull == GL.FRONT_AND_BACK || (cull == GL.BACK && !front_facing) || (cull == GL.FRONT && front_facing)) {
+          return;
+        }
+      }
+      // Make the triangle counter-clockwise, so that inside means all edge functions are positive.
+      if (area < 0) [v1, v2] = [v2, v1];
+      const size = Math.abs(area);
+
+      const x_min = Math.max(bounds[0], Math.floor(Math.min(v0.x, v1.x, v2.x)));
+      const x_max = Math.min(bounds[2] - 1, Math.ceil(Math.max(v0.x, v1.x, v2.x)));
+      const y_min = Math.max(bounds[1], Math.floor(Math.min(v0.y, v1.y, v2.y)));
+      const y_max = Math.min(bounds[3] - 1, Math.ceil(Math.max(v0.y, v1.y, v2.y)));
+
+      // Top-left fill rule: pixels exactly on an edge belong to the triangle only for top and left edges.
+      const edge = (a, b) => {
+        const dx = b.x - a.x;
+        const dy = b.y - a.y;
+        return { a: a, dx: dx, dy: dy, bias: (dy < 0 || (dy == 0 && dx > 0)) ? 0 : -1e-9 };
+      };
+      const e0 = edge(v1, v2);
+      const e1 = edge(v2, v0);
+      const e2 = edge(v0, v1);
+      const evaluate = (e, x, y) => e.dx * (y - e.a.y) - e.dy * (x - e.a.x);
+
+      const count = v0.varyings.length;
+      const interpolated = new Float64Array(count);
+      for (let y = y_min; y <= y_max; y++) {
+        const py = y + 0.5;
+        for (let x = x_min; x <= x_max; x++) {
+          const px = x + 0.5;
+          const w0 = evaluate(e0, px, py);
+          const w1 = evaluate(e1, px, py);
+          const w2 = evaluate(e2, px, py);
+          if (w0 + e0.bias < 0 || w1 + e1.bias < 0 || w2 + e2.bias < 0) continue;
+          const b0 = w0 / size;
+          const b1 = w1 / size;
+          const b2 = w2 / size;
+          const z = b0 * v0.z + b1 * v1.z + b2 * v2.z;
+          if (z < 0 || z > 1) continue;
+
+          // Perspective-correct interpolation of the varyings.
+          const p0 = b0 * v0.inverse_w;
+          const p1 = b1 * v1.inverse_w;
+          const p2 = b2 * v2.inverse_w;
+          const inverse_w = p0 + p1 + p2;
+          for (let k = 0; k < count; k++) {
+            interpolated[k] = (p0 * v0.varyings[k] + p1 * v1.varyings[k] + p2 * v2.varyings[k]) / inverse_w;
+          }
+          shade(x, y, z, interpolated, inverse_w, front_facing, null);
+        }
+      }
+    };
+
+    const rasterize_line = (shade, v0, v1, bounds) => {
+      const dx = v1.x - v0.x;
+      const dy = v1.y - v0.y;
+      const steps = Math.max(Math.abs(dx), Math.abs(dy), 1);
+      const count = v0.varyings.length;
+      const interpolated = new Float64Array(count);
+      for (let i = 0; i < Math.ceil(steps); i++) {
+        const t = (i + 0.5) / Math.ceil(steps);
+        const x = Math.floor(v0.x + dx * t);
+        const y = Math.floor(v0.y + dy * t);
+        if (x < bounds[0] || x >= bounds[2] || y < bounds[1] || y >= bounds[3]) continue;
+        const z = v0.z + (v1.z - v0.z) * t;
+        if (z < 0 || z > 1) continue;
+        for (let k = 0; k < count; k++) interpolated[k] = v0.varyings[k] + (v1.varyings[k] - v0.varyings[k]) * t;
+        shade(x, y, z, interpolated, v0.inverse_w + (v1.inverse_w - v0.inverse_w) * t, true, null);
+      }
+    };
+
+    const rasterize_point = (shade, v, bounds) => {
+      if (v.z < 0 || v.z > 1) return;
+      const size = Math.max(1, v.point_size);
+      const x0 = Math.max(bounds[0], Math.round(v.x - size / 2));
+      const y0 = Math.max(bounds[1], Math.round(v.y - size / 2));
+      const x1 = Math.min(bounds[2], Math.round(v.x - size / 2) + Math.round(size));
+      const y1 = Math.min(bounds[3], Math.round(v.y - size / 2) + Math.round(size));
+      for (let y = y0; y < y1; y++) {
+        for (let x = x0; x < x1; x++) {
+          const point_coord = [(x + 0.5 - (v.x - size / 2)) / size, 1 - (y + 0.5 - (v.y - size / 2)) / size];
+          shade(x, y, v.z, v.varyings, v.inverse_w, true, point_coord);
+        }
+      }
+    };
+
+    /// Run a draw call: vertex indices come from index(i) for i in [0, count).
+    const draw = (mode, count, index, instance_count) => {
+      const program = state.program;
+      if (!program || !program.linked) {
+        set_error(GL.INVALID_OPERATION);
+        return;
+      }
+      const target = render_target();
+      if (!target) return;
+      if (count <= 0 || instance_count <= 0) return;
+
+      const fetchers = attribute_fetchers(program);
+      const attributes = {};
+      program.vertex.bind(program.uniform_values, attributes, program.vertex_varyings, program.vertex_globals);
+      program.fragment.bind(program.uniform_values, {}, program.fragment_varyings, program.fragment_globals);
+      const shade = fragment_shader(program, target);
+      const bounds = draw_bounds(target);
+
+      for (let instance = 0; instance < instance_count; instance++) {
+        const cache = new Map();
+        const vertex = (i) => {
+          const vertex_index = index(i);
+          let result = cache.get(vertex_index);
+          if (!result) {
+            result = run_vertex(program, fetchers, attributes, vertex_index, instance);
+            cache.set(vertex_index, result);
+          }
+          return result;
+        };
+
+        const triangle = (a, b, c) => {
+          const polygon = clip_near([vertex(a), vertex(b), vertex(c)]);
+          if (polygon.length < 3) return;
+          const window = polygon.map(to_window);
+          for (let k = 1; k + 1 < window.length; k++) {
+            rasterize_triangle(shade, window[0], window[k], window[k + 1], bounds);
+          }
+        };
+        const line = (a, b) => {
+          const v0 = vertex(a);
+          const v1 = vertex(b);
+          if (v0.clip[3] <= 0 || v1.clip[3] <= 0) return;
+          rasterize_line(shade, to_window(v0), to_window(v1), bounds);
+        };
+
+        switch (mode) {
+          case GL.POINTS:
+            for (let i = 0; i < count; i++) {
+              const v = vertex(i);
+              if (v.clip[3] > 0) rasterize_point(shade, to_window(v), bounds);
+            }
+            break;
+          case GL.LINES:
+            for (let i = 0; i + 1 < count; i += 2) line(i, i + 1);
+            break;
+          case GL.LINE_STRIP:
+          case GL.LINE_LOOP:
+            for (let i = 0; i + 1 < count; i++) line(i, i + 1);
+            if (mode == GL.LINE_LOOP && count > 2) line(count - 1, 0);
+            break;
+          case GL.TRIANGLES:
+            for (let i = 0; i + 2 < count; i += 3) triangle(i, i + 1, i + 2);
+            break;
+          case GL.TRIANGLE_STRIP:
+            for (let i = 0; i + 2 < count; i++) {
+              if (i % 2 == 0) triangle(i, i + 1, i + 2);
+              else triangle(i + 1, i, i + 2);
+            }
+            break;
+          case GL.TRIANGLE_FAN:
+            for (let i = 1; i + 1 < count; i++) triangle(0, i, i + 1);
+            break;
+          default:
+            set_error(GL.INVALID_ENUM);
+            return;
+        }
+      }
+    };
+
+    const element_index = (type, offset) => {
+      const buffer = state.vertex_array.element_buffer;
+      if (!buffer) {
+        set_error(GL.INVALID_OPERATION);
+        return null;
+      }
+      const view = new DataView(buffer.data.buffer);
+      switch (type) {
+        case GL.UNSIGNED_BYTE: return (i) => view.getUint8(offset + i);
+        case GL.UNSIGNED_SHORT: return (i) => view.getUint16(offset + i * 2, true);
+        case GL.UNSIGNED_INT: return (i) => view.getUint32(offset + i * 4, true);
+        default:
+          set_error(GL.INVALID_ENUM);
+          return null;
+      }
+    };
+
+    // Framebuffer objects.
+
+    /// The image of a framebuffer attachment, as in render targets: { width, height, color, scale } for color images
+    /// (texture levels, color renderbuffers), { width, height, depth } for depth renderbuffers, null if it has none.
+    const attachment_image = (attachment) => {
+      if (!attachment) return null;
+      if (attachment.renderbuffer) return attachment.renderbuffer.image;
+      const level = attachment.texture.levels[attachment.level];
+      return level ? { width: level.width, height: level.height, color: level.data, scale: 1 } : null;
+    };
+
+    const framebuffer_depth = (framebuffer) =>
+      framebuffer.attachments.get(GL.DEPTH_ATTACHMENT) || framebuffer.attachments.get(GL.DEPTH_STENCIL_ATTACHMENT);
+
+    const framebuffer_status = (framebuffer) => {
+      if (!framebuffer) return GL.FRAMEBUFFER_COMPLETE;
+      if (!framebuffer.attachments.size) return GL.FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT;
+      let size = null;
+      for (const [point, attachment] of framebuffer.attachments) {
+        const image = attachment_image(attachment);
+        const wanted = point == GL.COLOR_ATTACHMENT0 ? "color" : point == GL.STENCIL_ATTACHMENT ? "stencil" : "depth";
+        if (!image || !image[wanted] || !image.width || !image.height) {
+          return GL.FRAMEBUFFER_INCOMPLETE_ATTACHMENT;
+        }
+        if (size && (size.width != image.width || size.height != image.height)) {
+          return GL.FRAMEBUFFER_INCOMPLETE_DIMENSIONS;
+        }
+        size = image;
+      }
+      if (framebuffer.attachments.has(GL.STENCIL_ATTACHMENT)) return GL.FRAMEBUFFER_UNSUPPORTED;
+      return GL.FRAMEBUFFER_COMPLETE;
+    };
+
+    /// The render target of the bound framebuffer (see default_target), or null (with the error set) if incomplete.
+    const render_target = () => {
+      const framebuffer = state.framebuffer;
+      if (!framebuffer) return default_target;
+      if (framebuffer_status(framebuffer) != GL.FRAMEBUFFER_COMPLETE) {
+        set_error(GL.INVALID_FRAMEBUFFER_OPERATION);
+        return null;
+      }
+      const color_image = attachment_image(framebuffer.attachments.get(GL.COLOR_ATTACHMENT0));
+      const depth_image = attachment_image(framebuffer_depth(framebuffer));
+      const size = color_image || depth_image;
+      return {
+        width: size.width, height: size.height, color: color_image && color_image.color,
+        scale: color_image ? color_image.scale : 255, depth: depth_image && depth_image.depth,
+      };
+    };
+
+    /// Storage for a renderbuffer of some internal format, or null if the format is not one.
+    const renderbuffer_image = (format, width, height) => {
+      switch (format) {
+        case GL.RGBA4: case GL.RGB5_A1: case GL.RGB565: case GL.RGB8: case GL.RGBA8:
+          return { width: width, height: height, color: new Uint8Array(width * height * 4), scale: 255 };
+        case GL.DEPTH_COMPONENT16: case GL.DEPTH_COMPONENT24: case GL.DEPTH_STENCIL: case GL.DEPTH24_STENCIL8:
+          return { width: width, height: height, depth: new Float32Array(width * height).fill(1) };
+        case GL.STENCIL_INDEX8:
+          return { width: width, height: height, stencil: true };
+        default:
+          return null;
+      }
+    };
+
+    const framebuffer_target_valid = (target) => {
+      if (target == GL.FRAMEBUFFER || target == GL.DRAW_FRAMEBUFFER || target == GL.READ_FRAMEBUFFER) return true;
+      set_error(GL.INVALID_ENUM);
+      return false;
+    };
+
+    /// Attach an image to the bound framebuffer (null detaches).
+    const framebuffer_attach = (target, point, attachment) => {
+      if (!framebuffer_target_valid(target)) return;
+      if (!state.framebuffer) {
+        set_error(GL.INVALID_OPERATION);
+        return;
+      }
+      const attachments = state.framebuffer.attachments;
+      if (point == GL.DEPTH_STENCIL_ATTACHMENT) {
+        attachments.delete(GL.DEPTH_ATTACHMENT);
+        attachments.delete(GL.STENCIL_ATTACHMENT);
+      } else if (point == GL.DEPTH_ATTACHMENT || point == GL.STENCIL_ATTACHMENT) {
+        attachments.delete(GL.DEPTH_STENCIL_ATTACHMENT);
+      } else if (point != GL.COLOR_ATTACHMENT0) {
+        set_error(GL.INVALID_ENUM);
+        return;
+      }
+      if (attachment) attachments.set(point, attachment);
+      else attachments.delete(point);
+    };
+
+    /// Detach an image from the bound framebuffer, as deleting it does.
+    const framebuffer_detach = (matches) => {
+      if (!state.framebuffer) return;
+      for (const [point, attachment] of state.framebuffer.attachments) {
+        if (matches(attachment)) state.framebuffer.attachments.delete(point);
+      }
+    };
+
+    // Shaders and programs.
+
+    const link = (program) => {
+      program.linked = false;
+      const vertex = program.shaders.find((shader) => shader.type == GL.VERTEX_SHADER);
+      const fragment = program.shaders.find((shader) => shader.type == GL.FRAGMENT_SHADER);
+      if (!vertex || !fragment || !vertex.compiled || !fragment.compiled) {
+        program.info_log = "Program needs a compiled vertex and fragment shader";
+        return;
+      }
+
+      const varying_layout = [];
+      let varying_size = 0;
+      for (const varying of fragment.compiled.varyings) {
+        const declared = vertex.compiled.varyings.find((v) => v.name == varying.name);
+        if (!declared || declared.type != varying.type) {
+          program.info_log = "Varying " + varying.name + " is not written by the vertex shader";
+          return;
+        }
+        if (varying.size !== undefined) {
+          program.info_log = "Varying arrays are not supported";
+          return;
+        }
+        const n = GLSL_TYPES[varying.type].n;
+        varying_layout.push({ name: varying.name, n: n, offset: varying_size });
+        varying_size += n;
+      }
+
+      const attributes = [];
+      let next_location = 0;
+      const used = new Set(vertex.compiled.attributes.map((a) => program.bound_locations.get(a.name))
+        .filter((location) => location !== undefined));
+      for (const attribute of vertex.compiled.attributes) {
+        if (GLSL_TYPES[attribute.type].dim) {
+          program.info_log = "Matrix attributes are not supported";
+          return;
+        }
+        let location = program.bound_locations.get(attribute.name);
+        if (location === undefined) {
+          while (used.has(next_location)) next_location++;
+          location = next_location++;
+        }
+        attributes.push({ name: attribute.name, type: attribute.type, location: location });
+      }
+
+      const uniforms = [];
+      const uniform_values = {};
+      for (const uniform of [...vertex.compiled.uniforms, ...fragment.compiled.uniforms]) {
+        const existing = uniforms.find((u) => u.name == uniform.name);
+        if (existing) {
+          if (existing.type != uniform.type || existing.size != uniform.size) {
+            program.info_log = "Uniform " + uniform.name + " is declared differently in the two shaders";
+            return;
+          }
+          continue;
+        }
+        uniforms.push(uniform);
+        const zero = new Function("return " + glsl_zero(uniform.type) + ";");
+        uniform_values[uniform.name] = uniform.size !== undefined ? Array.from({ length: uniform.size }, zero) : zero();
+      }
+
+      program.attributes = attributes;
+      program.uniforms = uniforms;
+      program.uniform_values = uniform_values;
+      program.varying_layout = varying_layout;
+      program.varying_size = varying_size;
+      program.uses_frag_data = fragment.compiled.uses_frag_data;
+      program.vertex = vertex.compiled.factory(shader_runtime);
+      program.fragment = fragment.compiled.factory(shader_runtime);
+      program.vertex_varyings = {};
+      program.vertex_globals = {};
+      program.fragment_varyings = {};
+      program.fragment_globals = {};
+      program.info_log = "";
+      program.linked = true;
+    };
+
+    const set_uniform = (location, values, components) => {
+      if (!location) return;
+      const program = state.program;
+      if (!program || location.program != program || location.generation != program.generation) {
+        set_error(GL.INVALID_OPERATION);
+        return;
+      }
+      const uniform = location.uniform;
+      const store = program.uniform_values;
+      const n = GLSL_TYPES[uniform.type].n;
+      if (uniform.type == "bool" || uniform.type.startsWith("bvec")) values = values.map((v) => v != 0);
+      if (components != n) {
+        set_error(GL.INVALID_OPERATION);
+        return;
+      }
+      if (uniform.size === undefined) {
+        store[uniform.name] = n == 1 ? values[0] : Array.from(values.slice(0, n));
+        return;
+      }
+      for (let i = location.index, at = 0; i < uniform.size && at + n <= values.length; i++, at += n) {
+        store[uniform.name][i] = n == 1 ? values[at] : Array.from(values.slice(at, at + n));
+      }
+    };
+
+    const uniform_vector = (n) => function (location, ...values) {
+      set_uniform(location, values, n);
+    };
+    const uniform_array = (n) => function (location, data) {
+      set_uniform(location, Array.from(data), n);
+    };
+    const uniform_matrix = (dim) => function (location, transpose, data) {
+      if (transpose) {
+        set_error(GL.INVALID_VALUE);
+        return;
+      }
+      set_uniform(location, Array.from(data), dim * dim);
+    };
+
+    /// Present the framebuffer in the canvas (if it has a 2D context), flipping it to top-down rows.
+    const present = () => {
+      if (!display) return;
+      const image = display.createImageData(width, height);
+      const row = width * 4;
+      for (let y = 0; y < height; y++) {
+        image.data.set(color.subarray((height - 1 - y) * row, (height - y) * row), y * row);
+      }
+      display.putImageData(image, 0, 0);
+    };
+
+    const gl = Object.assign(Object.create(null), GL, {
+      canvas: canvas,
+      drawingBufferWidth: width,
+      drawingBufferHeight: height,
+
+      getError: () => {
+        const result = error;
+        error = GL.NO_ERROR;
+        return result;
+      },
+      isContextLost: () => false,
+      getExtension: () => null,
+      getSupportedExtensions: () => [],
+      getContextAttributes: () => ({ alpha: true, depth: true, stencil: false, antialias: false }),
+
+      getParameter: (pname) => {
+        switch (pname) {
+          case GL.VIEWPORT: return new Int32Array(state.viewport);
+          case GL.SCISSOR_BOX: return new Int32Array(state.scissor);
+          case GL.COLOR_CLEAR_VALUE: return new Float32Array(state.clear_color);
+          case GL.DEPTH_CLEAR_VALUE: return state.clear_depth;
+          case GL.MAX_TEXTURE_SIZE: return 4096;
+          case GL.MAX_VIEWPORT_DIMS: return new Int32Array([4096, 4096]);
+          case GL.DEPTH_BITS: return 24;
+          case GL.MAX_VERTEX_ATTRIBS: return MAX_VERTEX_ATTRIBS;
+          case GL.MAX_TEXTURE_IMAGE_UNITS: case GL.MAX_COMBINED_TEXTURE_IMAGE_UNITS: return MAX_TEXTURE_UNITS;
+          case GL.VENDOR: return "Linux/Wasm";
+          case GL.RENDERER: return "Linux/Wasm software renderer";
+          case GL.VERSION: return "WebGL 2.0 (software)";
+          case GL.SHADING_LANGUAGE_VERSION: return "WebGL GLSL ES 1.0 (software)";
+          case GL.CURRENT_PROGRAM: return state.program;
+          case GL.ACTIVE_TEXTURE: return GL.TEXTURE0 + state.active_texture;
+          case GL.ARRAY_BUFFER_BINDING: return state.array_buffer;
+          case GL.ELEMENT_ARRAY_BUFFER_BINDING: return state.vertex_array.element_buffer;
+          case GL.TEXTURE_BINDING_2D: return state.texture_units[state.active_texture];
+          case GL.COMPRESSED_TEXTURE_FORMATS: return new Uint32Array(0);
+          case GL.VERTEX_ARRAY_BINDING: return state.vertex_array == default_vertex_array ? null : state.vertex_array;
+          case GL.FRAMEBUFFER_BINDING: return state.framebuffer;
+          case GL.RENDERBUFFER_BINDING: return state.renderbuffer;
+          default:
+            if (state.caps.has(pname)) return state.caps.get(pname);
+            set_error(GL.INVALID_ENUM);
+            return null;
+        }
+      },
+
+      // State
+
+      enable: (cap) => state.caps.set(cap, true),
+      disable: (cap) => state.caps.set(cap, false),
+      isEnabled: (cap) => enabled(cap),
+      viewport: (x, y, w, h) => state.viewport = [x, y, w, h],
+      scissor: (x, y, w, h) => state.scissor = [x, y, w, h],
+      clearColor: (r, g, b, a) => state.clear_color = [r, g, b, a].map((c) => Math.min(Math.max(c, 0), 1)),
+      clearDepth: (d) => state.clear_depth = Math.min(Math.max(d, 0), 1),
+      clearStencil: () => { },
+      depthFunc: (func) => state.depth_func = func,
+      depthMask: (flag) => state.depth_mask = !!flag,
+      depthRange: () => { },
+      colorMask: (r, g, b, a) => state.color_mask = [!!r, !!g, !!b, !!a],
+      blendFunc: (src, dst) => {
+        state.blend_src_rgb = state.blend_src_alpha = src;
+        state.blend_dst_rgb = state.blend_dst_alpha = dst;
+      },
+      blendFuncSeparate: (src_rgb, dst_rgb, src_alpha, dst_alpha) => {
+        Object.assign(state, {
+          blend_src_rgb: src_rgb, blend_dst_rgb: dst_rgb, blend_src_alpha: src_alpha, blend_dst_alpha: dst_alpha,
+        });
+      },
+      blendEquation: (mode) => state.blend_equation_rgb = state.blend_equation_alpha = mode,
+      blendEquationSeparate: (rgb, alpha) => {
+        state.blend_equation_rgb = rgb;
+        state.blend_equation_alpha = alpha;
+      },
+      blendColor: (r, g, b, a) => state.blend_color = [r, g, b, a],
+      cullFace: (mode) => state.cull_face = mode,
+      frontFace: (mode) => state.front_face = mode,
+      lineWidth: () => { },
+      polygonOffset: () => { },
+      hint: () => { },
+      stencilFunc: () => { },
+      stencilOp: () => { },
+      stencilMask: () => { },
+      pixelStorei: (pname, param) => {
+        if (pname == GL.UNPACK_ALIGNMENT) state.unpack_alignment = param;
+        if (pname == GL.PACK_ALIGNMENT) state.pack_alignment = param;
+      },
+
+      clear: (mask) => {
+        const target = render_target();
+        if (!target) return;
+        const [x0, y0, x1, y1] = draw_bounds(target);
+        const stride = target.width;
+        const full = x0 == 0 && y0 == 0 && x1 == target.width && y1 == target.height;
+        if ((mask & GL.COLOR_BUFFER_BIT) && target.color) {
+          const rgba = state.clear_color.map((c) => Math.round(c * 255) * target.scale / 255);
+          const masked = !state.color_mask.every((m) => m);
+          for (let y = y0; y < y1; y++) {
+            for (let x = x0; x < x1; x++) {
+              const at = (y * stride + x) * 4;
+              for (let c = 0; c < 4; c++) {
+                if (!masked || state.color_mask[c]) target.color[at + c] = rgba[c];
+              }
+            }
+          }
+        }
+        if ((mask & GL.DEPTH_BUFFER_BIT) && state.depth_mask && target.depth) {
+          if (full) {
+            target.depth.fill(state.clear_depth);
+          } else {
+            for (let y = y0; y < y1; y++) target.depth.fill(state.clear_depth, y * stride + x0, y * stride + x1);
+          }
+        }
+      },
+
+      flush: present,
+      finish: present,
+
+      readPixels: (x, y, w, h, format, type, pixels) => {
+        if (format != GL.RGBA || type != GL.UNSIGNED_BYTE) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        const target = render_target();
+        if (!target) return;
+        if (!target.color) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        const factor = 255 / target.scale;
+        const row_bytes = Math.ceil(w * 4 / state.pack_alignment) * state.pack_alignment;
+        for (let j = 0; j < h; j++) {
+          for (let i = 0; i < w; i++) {
+            const sx = x + i;
+            const sy = y + j;
+            if (sx < 0 || sy < 0 || sx >= target.width || sy >= target.height) continue;
+            const from = (sy * target.width + sx) * 4;
+            const to = j * row_bytes + i * 4;
+            for (let c = 0; c < 4; c++) pixels[to + c] = Math.round(target.color[from + c] * factor);
+          }
+        }
+      },
+
+      // Buffers
+
+      createBuffer: () => ({ data: new Uint8Array(0), usage: GL.STATIC_DRAW }),
+      deleteBuffer: (buffer) => {
+        if (!buffer) return;
+        if (state.array_buffer == buffer) state.array_buffer = null;
+        if (state.vertex_array.element_buffer == buffer) state.vertex_array.element_buffer = null;
+        for (const pointer of state.vertex_array.attributes) {
+          if (pointer.buffer == buffer) pointer.buffer = null;
+        }
+      },
+      isBuffer: (buffer) => !!buffer && buffer.data !== undefined,
+      bindBuffer: (target, buffer) => {
+        if (target == GL.ARRAY_BUFFER) state.array_buffer = buffer;
+        else if (target == GL.ELEMENT_ARRAY_BUFFER) state.vertex_array.element_buffer = buffer;
+        else set_error(GL.INVALID_ENUM);
+      },
+      bufferData: (target, data, usage) => {
+        const buffer = bound_buffer(target);
+        if (!buffer) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        buffer.data = typeof data === "number"
+          ? new Uint8Array(data) : new Uint8Array(data.buffer, data.byteOffset, data.byteLength).slice();
+        buffer.usage = usage;
+      },
+      bufferSubData: (target, offset, data) => {
+        const buffer = bound_buffer(target);
+        if (!buffer) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        const bytes = new Uint8Array(data.buffer, data.byteOffset, data.byteLength);
+        if (offset < 0 || offset + bytes.length > buffer.data.length) {
+          set_error(GL.INVALID_VALUE);
+          return;
+        }
+        buffer.data.set(bytes, offset);
+      },
+
+      // Vertex arrays and attributes
+
+      createVertexArray: () => new_vertex_array(),
+      deleteVertexArray: (vertex_array) => {
+        if (state.vertex_array == vertex_array) state.vertex_array = default_vertex_array;
+      },
+      bindVertexArray: (vertex_array) => state.vertex_array = vertex_array || default_vertex_array,
+      enableVertexAttribArray: (index) => state.vertex_array.attributes[index].enabled = true,
+      disableVertexAttribArray: (index) => state.vertex_array.attributes[index].enabled = false,
+      vertexAttribPointer: (index, size, type, normalized, stride, offset) => {
+        if (index >= MAX_VERTEX_ATTRIBS || !attribute_reader(type, false)) {
+          set_error(index >= MAX_VERTEX_ATTRIBS ? GL.INVALID_VALUE : GL.INVALID_ENUM);
+          return;
+        }
+        Object.assign(state.vertex_array.attributes[index], {
+          buffer: state.array_buffer, size: size, type: type, normalized: !!normalized, stride: stride,
+          offset: offset,
+        });
+      },
+      vertexAttribDivisor: (index, divisor) => state.vertex_array.attributes[index].divisor = divisor,
+      vertexAttrib1f: (index, x) => state.generic_attributes[index] = [x, 0, 0, 1],
+      vertexAttrib2f: (index, x, y) => state.generic_attributes[index] = [x, y, 0, 1],
+      vertexAttrib3f: (index, x, y, z) => state.generic_attributes[index] = [x, y, z, 1],
+      vertexAttrib4f: (index, x, y, z, w) => state.generic_attributes[index] = [x, y, z, w],
+
+      // Drawing
+
+      drawArrays: (mode, first, count) => draw(mode, count, (i) => first + i, 1),
+      drawElements: (mode, count, type, offset) => {
+        const index = element_index(type, offset);
+        if (index) draw(mode, count, index, 1);
+      },
+      drawArraysInstanced: (mode, first, count, instances) => draw(mode, count, (i) => first + i, instances),
+      drawElementsInstanced: (mode, count, type, offset, instances) => {
+        const index = element_index(type, offset);
+        if (index) draw(mode, count, index, instances);
+      },
+
+      // Textures
+
+      createTexture: () => ({
+        levels: [], min_filter: GL.NEAREST_MIPMAP_LINEAR, mag_filter: GL.LINEAR, wrap_s: GL.REPEAT,
+        wrap_t: GL.REPEAT,
+      }),
+      deleteTexture: (texture) => {
+        state.texture_units = state.texture_units.map((bound) => bound == texture ? null : bound);
+        framebuffer_detach((attachment) => attachment.texture == texture);
+      },
+      isTexture: (texture) => !!texture && texture.levels !== undefined,
+      activeTexture: (unit) => {
+        if (unit < GL.TEXTURE0 || unit >= GL.TEXTURE0 + MAX_TEXTURE_UNITS) {
+          set_error(GL.INVALID_ENUM);
+          return;
+        }
+        state.active_texture = unit - GL.TEXTURE0;
+      },
+      bindTexture: (target, texture) => {
+        if (target != GL.TEXTURE_2D) {
+          set_error(GL.INVALID_ENUM);
+          return;
+        }
+        state.texture_units[state.active_texture] = texture;
+      },
+      texParameteri: (target, pname, param) => {
+        const texture = bound_texture(target);
+        if (!texture) return;
+        switch (pname) {
+          case GL.TEXTURE_MIN_FILTER: texture.min_filter = param; break;
+          case GL.TEXTURE_MAG_FILTER: texture.mag_filter = param; break;
+          case GL.TEXTURE_WRAP_S: texture.wrap_s = param; break;
+          case GL.TEXTURE_WRAP_T: texture.wrap_t = param; break;
+          default: break;
+        }
+      },
+      texParameterf: (target, pname, param) => gl.texParameteri(target, pname, param),
+      texImage2D: (target, level, internalformat, width, height, border, format, type, pixels) => {
+        const texture = bound_texture(target);
+        if (!texture) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        const data = texture_level(width, height, format, type, pixels);
+        if (data) texture.levels[level] = data;
+      },
+      texSubImage2D: (target, level, x, y, width, height, format, type, pixels) => {
+        const texture = bound_texture(target);
+        const data = texture && texture.levels[level];
+        if (!data || x < 0 || y < 0 || x + width > data.width || y + height > data.height) {
+          set_error(GL.INVALID_VALUE);
+          return;
+        }
+        const decoder = texel_decoder(format, type);
+        if (!decoder) {
+          set_error(GL.INVALID_ENUM);
+          return;
+        }
+        if (pixels) upload_pixels(data.data, data.width, x, y, width, height, decoder, pixels);
+      },
+
+      // No compressed formats are supported (none are listed in COMPRESSED_TEXTURE_FORMATS).
+      compressedTexImage2D: () => set_error(GL.INVALID_ENUM),
+      compressedTexSubImage2D: () => set_error(GL.INVALID_ENUM),
+      generateMipmap: (target) => {
+        const texture = bound_texture(target);
+        if (!texture || !texture.levels[0]) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        texture.levels.length = 1;
+        for (let level = texture.levels[0]; level.width > 1 || level.height > 1;) {
+          level = texture_level_half(level);
+          texture.levels.push(level);
+        }
+      },
+
+      // Framebuffers and renderbuffers (a single binding serves as both the draw and the read framebuffer)
+
+      createFramebuffer: () => ({ attachments: new Map() }),
+      deleteFramebuffer: (framebuffer) => {
+        if (framebuffer && state.framebuffer == framebuffer) state.framebuffer = null;
+      },
+      isFramebuffer: (framebuffer) => !!framebuffer && framebuffer.attachments !== undefined,
+      bindFramebuffer: (target, framebuffer) => {
+        if (framebuffer_target_valid(target)) state.framebuffer = framebuffer || null;
+      },
+      checkFramebufferStatus: (target) => framebuffer_target_valid(target) ? framebuffer_status(state.framebuffer) : 0,
+      framebufferTexture2D: (target, point, texture_target, texture, level) => {
+        if (texture && (texture_target != GL.TEXTURE_2D || level != 0)) {
+          set_error(texture_target != GL.TEXTURE_2D ? GL.INVALID_ENUM : GL.INVALID_VALUE);
+          return;
+        }
+        framebuffer_attach(target, point, texture ? { texture: texture, level: level } : null);
+      },
+      framebufferRenderbuffer: (target, point, renderbuffer_target, renderbuffer) => {
+        if (renderbuffer_target != GL.RENDERBUFFER) {
+          set_error(GL.INVALID_ENUM);
+          return;
+        }
+        framebuffer_attach(target, point, renderbuffer ? { renderbuffer: renderbuffer } : null);
+      },
+
+      createRenderbuffer: () => ({ image: null, format: GL.RGBA4 }),
+      deleteRenderbuffer: (renderbuffer) => {
+        if (!renderbuffer) return;
+        if (state.renderbuffer == renderbuffer) state.renderbuffer = null;
+        framebuffer_detach((attachment) => attachment.renderbuffer == renderbuffer);
+      },
+      isRenderbuffer: (renderbuffer) => !!renderbuffer && renderbuffer.format !== undefined,
+      bindRenderbuffer: (target, renderbuffer) => {
+        if (target != GL.RENDERBUFFER) {
+          set_error(GL.INVALID_ENUM);
+          return;
+        }
+        state.renderbuffer = renderbuffer || null;
+      },
+      renderbufferStorage: (target, format, width, height) => {
+        if (target != GL.RENDERBUFFER || !state.renderbuffer) {
+          set_error(target != GL.RENDERBUFFER ? GL.INVALID_ENUM : GL.INVALID_OPERATION);
+          return;
+        }
+        const image = renderbuffer_image(format, width, height);
+        if (!image) {
+          set_error(GL.INVALID_ENUM);
+          return;
+        }
+        state.renderbuffer.image = image;
+        state.renderbuffer.format = format;
+      },
+      getRenderbufferParameter: (target, pname) => {
+        const renderbuffer = state.renderbuffer;
+        switch (pname) {
+          case GL.RENDERBUFFER_WIDTH: return renderbuffer && renderbuffer.image ? renderbuffer.image.width : 0;
+          case GL.RENDERBUFFER_HEIGHT: return renderbuffer && renderbuffer.image ? renderbuffer.image.height : 0;
+          case GL.RENDERBUFFER_INTERNAL_FORMAT: return renderbuffer ? renderbuffer.format : 0;
+          default:
+            set_error(GL.INVALID_ENUM);
+            return null;
+        }
+      },
+
+      // Shaders and programs
+
+      createShader: (type) => ({ type: type, source: "", compiled: null, info_log: "", deleted: false }),
+      deleteShader: (shader) => {
+        if (shader) shader.deleted = true;
+      },
+      isShader: (shader) => !!shader && shader.source !== undefined,
+      shaderSource: (shader, source) => shader.source = source,
+      getShaderSource: (shader) => shader.source,
+      compileShader: (shader) => {
+        try {
+          shader.compiled = glsl_compile(shader.source, shader.type == GL.VERTEX_SHADER ? "vertex" : "fragment");
+          shader.info_log = "";
+        } catch (exception) {
+          shader.compiled = null;
+          shader.info_log = "ERROR: " + exception.message + "\n";
+        }
+      },
+      getShaderParameter: (shader, pname) => {
+        switch (pname) {
+          case GL.COMPILE_STATUS: return !!shader.compiled;
+          case GL.SHADER_TYPE: return shader.type;
+          case GL.DELETE_STATUS: return shader.deleted;
+          default:
+            set_error(GL.INVALID_ENUM);
+            return null;
+        }
+      },
+      getShaderInfoLog: (shader) => shader.info_log,
+      getShaderPrecisionFormat: () => ({ rangeMin: 127, rangeMax: 127, precision: 52 }),
+
+      createProgram: () => ({
+        shaders: [], linked: false, info_log: "", bound_locations: new Map(), generation: 0, deleted: false,
+        attributes: [], uniforms: [],
+      }),
+      deleteProgram: (program) => {
+        if (program) program.deleted = true;
+      },
+      isProgram: (program) => !!program && program.shaders !== undefined,
+      attachShader: (program, shader) => {
+        if (program.shaders.includes(shader)) {
+          set_error(GL.INVALID_OPERATION);
+          return;
+        }
+        program.shaders.push(shader);
+      },
+      detachShader: (program, shader) => program.shaders = program.shaders.filter((s) => s != shader),
+      getAttachedShaders: (program) => program.shaders.slice(),
+      bindAttribLocation: (program, index, name) => program.bound_locations.set(name, index),
+      linkProgram: (program) => {
+        program.generation++;
+        link(program);
+      },
+      validateProgram: () => { },
+      useProgram: (program) => state.program = program,
+      getProgramParameter: (program, pname) => {
+        switch (pname) {
+          case GL.LINK_STATUS: return program.linked;
+          case GL.DELETE_STATUS: return program.deleted;
+          case GL.VALIDATE_STATUS: return program.linked;
+          case GL.ATTACHED_SHADERS: return program.shaders.length;
+          case GL.ACTIVE_ATTRIBUTES: return program.attributes.length;
+          case GL.ACTIVE_UNIFORMS: return program.uniforms.length;
+          default:
+            set_error(GL.INVALID_ENUM);
+            return null;
+        }
+      },
+      getProgramInfoLog: (program) => program.info_log,
+      getActiveAttrib: (program, index) => {
+        const attribute = program.attributes[index];
+        return attribute ? { name: attribute.name, size: 1, type: GLSL_TYPE_ENUMS[attribute.type] } : null;
+      },
+      getActiveUniform: (program, index) => {
+        const uniform = program.uniforms[index];
+        if (!uniform) return null;
+        return {
+          name: uniform.size !== undefined ? uniform.name + "[0]" : uniform.name,
+          size: uniform.size || 1,
+          type: GLSL_TYPE_ENUMS[uniform.type],
+        };
+      },
+      getAttribLocation: (program, name) => {
+        const attribute = program.attributes.find((a) => a.name == name);
+        return attribute ? attribute.location : -1;
+      },
+      getUniformLocation: (program, name) => {
+        const parsed = /^(\w+)(?:\[(\d+)\])?$/.exec(name);
+        const uniform = parsed && program.uniforms.find((u) => u.name == parsed[1]);
+        if (!uniform) return null;
+        const index = parsed[2] !== undefined ? parseInt(parsed[2], 10) : 0;
+        if ((parsed[2] !== undefined && uniform.size === undefined) || index >= (uniform.size || 1)) return null;
+        return { program: program, generation: program.generation, uniform: uniform, index: index };
+      },
+      getUniform: (program, location) => {
+        const value = program.uniform_values[location.uniform.name];
+        return location.uniform.size !== undefined ? value[location.index] : value;
+      },
+
+      uniform1f: uniform_vector(1), uniform2f: uniform_vector(2), uniform3f: uniform_vector(3),
+      uniform4f: uniform_vector(4), uniform1i: uniform_vector(1), uniform2i: uniform_vector(2),
+      uniform3i: uniform_vector(3), uniform4i: uniform_vector(4),
+      uniform1fv: uniform_array(1), uniform2fv: uniform_array(2), uniform3fv: uniform_array(3),
+      uniform4fv: uniform_array(4), uniform1iv: uniform_array(1), uniform2iv: uniform_array(2),
+      uniform3iv: uniform_array(3), uniform4iv: uniform_array(4),
+      uniformMatrix2fv: uniform_matrix(2), uniformMatrix3fv: uniform_matrix(3), uniformMatrix4fv: uniform_matrix(4),
+    });
+    return gl;
+  };
+})();
@@ -1,7 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 (function (console) {
+  // Same cache-busting version as ours.
+  importScripts("linux-module-cache.js" + self.location.search);
+
   let port = self;
+  let graphics_port = null;  // Our own channel to the graphics host (see linux-graphics.js), set up at init.
   let memory = null;  // Note: memory.buffer has to be re-accessed after growing the memory!
   let locks = null;
   const text_decoder = new TextDecoder("utf-8");
@@ -13,6 +17,15 @@
   /// SAB-backed storage for last process in switch_to (when it returns back from another task).
   let switch_to_last_task = null;
 
+  /// The task table shared by all runners (see task_table in linux.js for the layout), and the slots (word offsets) of
+  /// the tasks we have switched to before.
+  let task_table = null;
+  const task_table_slots = new Map();
+  const TASK_TABLE_STRIDE = 4;
+  const TASK_TABLE_TASK = 0;
+  const TASK_TABLE_SERIALIZE = 1;
+  const TASK_TABLE_LAST_TASK = 2;
+
   /// The vmlinux instance, to handle boot, idle, kthreads and syscalls etc.
   let vmlinux_instance = null;
 
@@ -65,12 +78,624 @@
     Atomics.store(locks._memory, locks[lock], 0);
   };
 
+  /// Find the slot of a task in the task table, or -1 if it has none.
+  const task_table_find = (task) => {
+    const cached = task_table_slots.get(task);
+    if (cached !== undefined && Atomics.load(task_table, cached + TASK_TABLE_TASK) == task) {
+      return cached;
+    }
+
+    const end = 1 + Atomics.load(task_table, 0) * TASK_TABLE_STRIDE;
+    for (let slot = 1; slot < end; slot += TASK_TABLE_STRIDE) {
+      if (Atomics.load(task_table, slot + TASK_TABLE_TASK) == task) {
+        task_table_slots.set(task, slot);
+        return slot;
+      }
+    }
+    return -1;
+  };
+
   const serialize_me = () => {
     // Wait for some other task or CPU to wake us up.
     lock_wait("serialize");
     return switch_to_last_task[0];  // last_task was written by the caller just prior to waking.
   };
 
+  /// Whether to compile user executables through the persistent module cache (see linux-module-cache.js).
+  let module_cache = false;
+
+  /// Lookups in the compiled executable cache of the main thread that we wait for the answer to, by key.
+  const executable_lookups = new Map();
+
+  /**
+   * Compile a user executable, or rather get it from the cache of the main thread (executable_cache in linux.js) if
+   * any task compiled the same binary before. It is keyed by the SHA-256 hash of the binary, so fork and repeated exec
+   * of a binary only hash it (a few ms for a busybox). The module is shared between the Workers, with its machine code.
+   * If some other task is compiling the binary already, the main thread holds on to our lookup until it is done. Misses
+   * go through the persistent module cache, if enabled, which survives page loads.
+   */
+  const executable_compile = async (binary) => {
+    if (!crypto.subtle) {
+      return WebAssembly.compile(binary);  // Not a secure context, no hashing.
+    }
+
+    const key = await linux_module_cache_key(binary);
+    const cached = await new Promise((resolve) => {
+      executable_lookups.set(key, resolve);
+      port.postMessage({ method: "executable_lookup", key: key });
+    });
+    if (cached) {
+      return cached;
+    }
+
+    let module = null;
+    try {
+      module = await (module_cache ? linux_module_cache_compile(binary, key) : WebAssembly.compile(binary));
+      return module;
+    } finally {
+      // A null module (the binary failed to compile) lets the tasks that wait for it try (and fail) themselves.
+      port.postMessage({ method: "executable_store", key: key, module: module });
+    }
+  };
+
+  /// GL commands that can be encoded into the GL command ring, indexed by opcode. Opcode 0 is reserved to mark that
+  /// the rest of the ring is unused and the reader should wrap around. Argument types are one letter each:
+  ///   i = integer, f = float, F = float array (length-prefixed), m = Wasm memory region (pointer and byte size),
+  ///   w = Wasm memory region written by the host (like m, but its contents are not captured),
+  ///   s = shader ID, p = program ID, b = buffer ID, t = texture ID, u = uniform location ID.
+  /// Commands are looked up by name, which defaults to func_name (overloads of one GL function need distinct names).
+  /// This table is handed to the graphics host together with the ring, so that it can decode the commands.
+  const gl_commands = [
+    null,
+    { func_name: "clear", args: "i" },
+    { func_name: "clearColor", args: "ffff" },
+    { func_name: "viewport", args: "iiii" },
+    { func_name: "compileShader", args: "i" },  // Handled by the host (compiles lazily, see gl_shader_compile()).
+    { func_name: "attachShader", args: "ii" },  // Handled by the host (records the shaders of the program).
+    { func_name: "linkProgram", args: "ii" },  // Handled by the host (program cache, invalidates uniform locations).
+    { func_name: "useProgram", args: "p" },
+    { func_name: "enableVertexAttribArray", args: "i" },
+    { func_name: "disableVertexAttribArray", args: "i" },
+    { func_name: "vertexAttribPointer", args: "iiiiii" },
+    { func_name: "bindBuffer", args: "ib" },
+    { func_name: "drawArrays", args: "iii" },
+    { func_name: "drawElements", args: "iiii" },
+    { func_name: "uniform1f", args: "uf" },
+    { func_name: "uniform1i", args: "ui" },
+    { func_name: "uniform2f", args: "uff" },
+    { func_name: "uniform3f", args: "ufff" },
+    { func_name: "uniform4f", args: "uffff" },
+    { func_name: "uniform2fv", args: "uF" },
+    { func_name: "uniform3fv", args: "uF" },
+    { func_name: "uniform4fv", args: "uF" },
+    { func_name: "uniformMatrix4fv", args: "uiF" },
+    { func_name: "bindTexture", args: "it" },
+    { func_name: "texParameteri", args: "iii" },
+    { func_name: "texParameterf", args: "iif" },
+    { func_name: "activeTexture", args: "i" },
+    { func_name: "enable", args: "i" },
+    { func_name: "disable", args: "i" },
+    { func_name: "flush", args: "" },
+    { func_name: "bufferData", args: "imi" },
+    { name: "bufferDataSize", func_name: "bufferData", args: "iii" },
+    { func_name: "bufferSubData", args: "iim" },
+    { func_name: "fence", args: "i" },  // Handled by the host, see gl_fence_insert().
+    { func_name: "pixelStorei", args: "ii" },
+    { func_name: "texImage2D", args: "iiiiiiiim" },  // Handled by the host (typed view of the pixels).
+    { func_name: "texSubImage2D", args: "iiiiiiiim" },  // Handled by the host (typed view of the pixels).
+    { func_name: "compressedTexImage2D", args: "iiiiiim" },
+    { func_name: "compressedTexSubImage2D", args: "iiiiiiim" },
+    { func_name: "generateMipmap", args: "i" },
+    { func_name: "createShader", args: "ii" },  // Handled by the host (binds a name to a new object).
+    { func_name: "createProgram", args: "i" },  // Handled by the host (binds a name to a new object).
+    { func_name: "deleteShader", args: "i" },  // Handled by the host (also unbinds the name).
+    { func_name: "deleteProgram", args: "i" },  // Handled by the host (also unbinds the name).
+    { func_name: "deleteBuffer", args: "i" },  // Handled by the host (also unbinds the name).
+    { func_name: "deleteTexture", args: "i" },  // Handled by the host (also unbinds the name).
+    { func_name: "drawArraysInstanced", args: "iiii" },  // Handled by the host (WebGL2 or ANGLE_instanced_arrays).
+    { func_name: "drawElementsInstanced", args: "iiiii" },  // Handled by the host (WebGL2 or ANGLE_instanced_arrays).
+    { func_name: "vertexAttribDivisor", args: "ii" },  // Handled by the host (WebGL2 or ANGLE_instanced_arrays).
+    { func_name: "bindVertexArray", args: "i" },  // Handled by the host (WebGL2 or OES_vertex_array_object).
+    { func_name: "deleteVertexArray", args: "i" },  // Handled by the host (WebGL2 or OES_vertex_array_object).
+    { func_name: "bindFramebuffer", args: "ii" },  // Handled by the host (binds a name to a new object).
+    { func_name: "deleteFramebuffer", args: "i" },  // Handled by the host (also unbinds the name).
+    { func_name: "framebufferTexture2D", args: "iiiti" },
+    { func_name: "framebufferRenderbuffer", args: "iiii" },  // Handled by the host (binds a name to a new object).
+    { func_name: "bindRenderbuffer", args: "ii" },  // Handled by the host (binds a name to a new object).
+    { func_name: "deleteRenderbuffer", args: "i" },  // Handled by the host (also unbinds the name).
+    { func_name: "renderbufferStorage", args: "iiii" },  // Handled by the host (sized formats on WebGL1).
+    { func_name: "readPixels", args: "iiiiiiw" },  // Handled by the host (typed view of the pixels).
+    { name: "readPixelsAsync", func_name: "readPixels", args: "iiiiiiww" },  // Handled by the host (see gl_readback).
+  ];
+
+  /// Reverse lookup of gl_commands (name -> opcode).
+  const gl_opcodes = Object.fromEntries(gl_commands.map((command, opcode) =>
+    [command && (command.name || command.func_name), opcode]));
+
+  /// The GL command ring (SAB-backed), lazily created on the first GL command. Word 0 is the write position (owned by
+  /// us), word 1 is the read position (owned by the graphics host), word 2 is the last fence signaled by the graphics
+  /// host, word 3 the last program link it has seen complete (see wasm_gl_program_ready), and the command words follow. A ring with equal positions is empty, and one word is always kept free so that a
+  /// full ring can be told apart from an empty one.
+  const GL_RING_WORDS = 256 * 1024;
+  const GL_RING_HEAD = 0;
+  const GL_RING_TAIL = 1;
+  const GL_RING_FENCE = 2;
+  const GL_RING_LINKED = 3;
+  const GL_RING_HEADER_WORDS = 4;
+  let gl_ring = null;
+  let gl_ring_f32 = null;
+
+  /// The last fence inserted into the ring. Fences are signaled in order, so a fence is signaled if the fence word in
+  /// the ring header has reached it.
+  let gl_fence_serial = 0;
+
+  /// Links are numbered like fences, and also complete in order (see gl_links_poll() in linux-graphics.js). Programs
+  /// map to the number of their last link.
+  let gl_link_serial = 0;
+  const gl_program_links = new Map();
+
+  /// Set when commands have been written to the ring that the graphics host has not been asked to drain yet.
+  let gl_ring_pending = false;
+
+  /// GL capture (wasm_gl_capture_begin/end): while set, everything this Worker sends to the graphics host is also
+  /// appended here as trace records, so that gl-replay.html can play the session back without booting Linux. A trace is
+  /// "GLTRACE1", a u32 byte length and the JSON of gl_commands, followed by records of a u32 type, a u32 byte length
+  /// and the data padded to 4 bytes (all little endian). Command data is the ring words of the command followed by the
+  /// bytes of each m argument (padded, w arguments have none), flushes have no data, and messages are JSON.
+  const GL_TRACE_MAGIC = "GLTRACE1";
+  const GL_TRACE_COMMAND = 1;
+  const GL_TRACE_FLUSH = 2;
+  const GL_TRACE_MESSAGE = 3;
+  let gl_capture = null;
+
+  const gl_capture_record = (type, data) => {
+    const record = new Uint8Array(8 + ((data.byteLength + 3) & ~3));
+    const record_view = new DataView(record.buffer);
+    record_view.setUint32(0, type, true);
+    record_view.setUint32(4, data.byteLength, true);
+    record.set(new Uint8Array(data.buffer, data.byteOffset, data.byteLength), 8);
+    gl_capture.push(record);
+  };
+
+  const gl_capture_command = (start, length, types, args) => {
+    let size = length * 4;
+    for (let i = 0; i < args.length; i++) {
+      if (types[i] == "m") {
+        size += (args[i][1] + 3) & ~3;
+      }
+    }
+
+    const data = new Uint8Array(size);
+    data.set(new Uint8Array(gl_ring.buffer, (GL_RING_HEADER_WORDS + start) * 4, length * 4));
+    let offset = length * 4;
+    for (let i = 0; i < args.length; i++) {
+      if (types[i] == "m") {
+        data.set(new Uint8Array(memory.buffer, args[i][0], args[i][1]), offset);
+        offset += (args[i][1] + 3) & ~3;
+      }
+    }
+    gl_capture_record(GL_TRACE_COMMAND, data);
+  };
+
+  /// Ask the graphics host to execute all commands written to the GL command ring so far.
+  const gl_ring_flush = () => {
+    if (gl_ring_pending) {
+      gl_ring_pending = false;
+      if (gl_capture) {
+        gl_capture_record(GL_TRACE_FLUSH, new Uint8Array(0));
+      }
+      graphics_port.postMessage({ method: "graphics_gl_flush" });
+    }
+  };
+
+  /// Find room for a command of length words in the ring and return its position. Blocks if the ring is full.
+  const gl_ring_reserve = (length) => {
+    if (!gl_ring) {
+      gl_ring = new Int32Array(new SharedArrayBuffer((GL_RING_HEADER_WORDS + GL_RING_WORDS) * 4));
+      gl_ring_f32 = new Float32Array(gl_ring.buffer);
+      graphics_port.postMessage({ method: "graphics_gl_ring_init", ring: gl_ring, commands: gl_commands });
+    }
+    if (length >= GL_RING_WORDS / 2) {
+      throw new Error("GL command of " + length + " words does not fit in the command ring");
+    }
+
+    for (;;) {
+      const head = gl_ring[GL_RING_HEAD];
+      const tail = Atomics.load(gl_ring, GL_RING_TAIL);
+
+      if (head >= tail) {
+        // Free space is at the end of the ring, and (when wrapping) at the start except for the word before tail.
+        if (GL_RING_WORDS - head > length || (GL_RING_WORDS - head == length && tail > 0)) {
+          return head;
+        }
+        if (tail > length) {
+          // Not enough contiguous space at the end. Mark the rest as unused and continue from the start.
+          gl_ring[GL_RING_HEADER_WORDS + head] = 0;
+          Atomics.store(gl_ring, GL_RING_HEAD, 0);
+          continue;
+        }
+      } else if (tail - head > length) {
+        return head;
+      }
+
+      // The ring is full. Have the graphics host drain it and wait until it has made some progress.
+      gl_ring_flush();
+      Atomics.wait(gl_ring, GL_RING_TAIL, tail);
+    }
+  };
+
+  /// Encode a GL call into the command ring. It will be executed by the graphics host on the next flush.
+  const gl_ring_command = (func_name, ...args) => {
+    const opcode = gl_opcodes[func_name];
+    const types = gl_commands[opcode].args;
+
+    let length = 1 + args.length;
+    for (let i = 0; i < args.length; i++) {
+      if (types[i] == "F") {
+        length += args[i].length;
+      } else if (types[i] == "m" || types[i] == "w") {
+        length += 1;
+      }
+    }
+
+    const start = gl_ring_reserve(length);
+    let pos = GL_RING_HEADER_WORDS + start;
+    gl_ring[pos++] = opcode;
+    for (let i = 0; i < args.length; i++) {
+      if (types[i] == "f") {
+        gl_ring_f32[pos++] = args[i];
+      } else if (types[i] == "F") {
+        gl_ring[pos++] = args[i].length;
+        gl_ring_f32.set(args[i], pos);
+        pos += args[i].length;
+      } else if (types[i] == "m" || types[i] == "w") {
+        gl_ring[pos++] = args[i][0];
+        gl_ring[pos++] = args[i][1];
+      } else {
+        gl_ring[pos++] = args[i];
+      }
+    }
+
+    if (gl_capture) {
+      gl_capture_command(start, length, types, args);
+    }
+
+    // Release the command words above to the graphics host.
+    Atomics.store(gl_ring, GL_RING_HEAD, (start + length) % GL_RING_WORDS);
+    gl_ring_pending = true;
+    gl_calls_issued++;
+  };
+
+  /// Insert a fence into the command ring. It is signaled when the graphics host has executed all commands before it,
+  /// at which point any Wasm memory referenced by those commands (m arguments) has been read and may be reused.
+  const gl_fence_insert = () => {
+    gl_fence_serial++;
+    gl_ring_command("fence", gl_fence_serial);
+    return gl_fence_serial;
+  };
+
+  /// Convert a GLuint64 timeout in nanoseconds to milliseconds. Wasm i64 arguments arrive as signed BigInts, so
+  /// GL_TIMEOUT_IGNORED (all ones) is -1n here: reinterpret as unsigned first.
+  const gl_timeout_ms = (timeout) => {
+    const unsigned = BigInt.asUintN(64, BigInt(timeout));
+    return (unsigned == 0xFFFFFFFFFFFFFFFFn) ? Infinity : Number(unsigned) / 1000000;
+  };
+
+  /// Wait for a fence to be signaled, at most timeout_ms milliseconds. Returns true if it was signaled.
+  const gl_fence_wait = (fence, timeout_ms) => {
+    gl_ring_flush();
+
+    const deadline = performance.now() + timeout_ms;
+    for (;;) {
+      const signaled = Atomics.load(gl_ring, GL_RING_FENCE);
+      if (signaled >= fence) {
+        return true;
+      }
+
+      const remaining = deadline - performance.now();
+      if (remaining <= 0) {
+        return false;
+      }
+      Atomics.wait(gl_ring, GL_RING_FENCE, signaled, remaining);
+    }
+  };
+
+  /// Reply mailbox for blocking GL queries (glGet*, info logs, ...), reused for all of them. It is created on first use
+  /// and handed to the graphics host once (graphics_gl_reply_init in linux-graphics.js), and only replaced by a larger
+  /// one if a reply did not fit. Layout: status (0 while pending, 1 when answered), scalar result, payload length, a
+  /// spare word, then the payload bytes.
+  const GL_REPLY_STATUS = 0;
+  const GL_REPLY_SCALAR = 1;
+  const GL_REPLY_LENGTH = 2;
+  const GL_REPLY_HEADER_BYTES = 16;
+  let gl_reply = null;
+  let gl_reply_payload = null;
+
+  const gl_reply_alloc = (capacity) => {
+    // A power of two (so whole words), so that growing replies do not replace the mailbox each time.
+    let size = 4096;
+    while (size < capacity) {
+      size *= 2;
+    }
+    gl_reply = new Int32Array(new SharedArrayBuffer(GL_REPLY_HEADER_BYTES + size));
+    gl_reply_payload = new Uint8Array(gl_reply.buffer, GL_REPLY_HEADER_BYTES);
+    graphics_post({
+      method: "graphics_gl_reply_init",
+      reply: gl_reply,
+    });
+  };
+
+  /// Post a query to the graphics host and block until it has answered. Returns the scalar result; the payload is left
+  /// in gl_reply_payload (truncated to its capacity, GL_REPLY_LENGTH has the full length).
+  const gl_query = (message) => {
+    if (!gl_reply) {
+      gl_reply_alloc(4096);
+    }
+
+    Atomics.store(gl_reply, GL_REPLY_STATUS, 0);
+    gl_calls_issued++;
+    graphics_post(message);
+    Atomics.wait(gl_reply, GL_REPLY_STATUS, 0);
+    return gl_reply[GL_REPLY_SCALAR];
+  };
+
+  /// Like gl_query(), but returns (a copy of) the whole payload. Grows the mailbox and asks again if it did not fit.
+  const gl_query_payload = (message) => {
+    for (;;) {
+      gl_query(message);
+      const length = gl_reply[GL_REPLY_LENGTH];
+      if (length <= gl_reply_payload.length) {
+        return gl_reply_payload.slice(0, length);
+      }
+      gl_reply_alloc(length);
+    }
+  };
+
+  /// GL object names are allocated here, without asking the graphics host, from counters shared by all Workers (see the
+  /// names registry in index.html). Shaders and programs share a namespace, like GL. Names are unique across contexts,
+  /// although each context only sees its own objects. EGL context and surface IDs are allocated the same way.
+  const GL_NAMES_BUFFERS = 0;
+  const GL_NAMES_TEXTURES = 1;
+  const GL_NAMES_SHADERS_PROGRAMS = 2;
+  const GL_NAMES_VERTEX_ARRAYS = 3;
+  const GL_NAMES_FRAMEBUFFERS = 4;
+  const GL_NAMES_RENDERBUFFERS = 5;
+  const GL_NAMES_EGL_CONTEXTS = 6;
+  const GL_NAMES_EGL_SURFACES = 7;
+  const GL_NAMES_KINDS = 8;
+  let gl_names = null;
+
+  /// Allocate a new (non-zero) name of some kind.
+  const gl_name_alloc = (kind) => {
+    return Atomics.add(gl_names, kind, 1) + 1;
+  };
+
+  /// Allocate n names of some kind and write them to a GLuint array in Wasm memory (glGen*).
+  const gl_name_gen = (kind, n, names) => {
+    const memory_view = new DataView(memory.buffer);
+    for (let i = 0; i < n; i++) {
+      memory_view.setUint32(names + i * 4, gl_name_alloc(kind), true);
+    }
+  };
+
+  /// Delete n objects whose names are in a GLuint array in Wasm memory (glDelete*).
+  const gl_name_delete = (func_name, n, names) => {
+    const memory_view = new DataView(memory.buffer);
+    for (let i = 0; i < n; i++) {
+      const name = memory_view.getUint32(names + i * 4, true);
+      if (name) {
+        gl_ring_command(func_name, name);
+      }
+    }
+  };
+
+  /// Active uniform and attribute locations of programs (program -> { uniforms: {name: location}, attributes: {...} }),
+  /// fetched from the graphics host once after each link, so that glGet*Location() is answered here.
+  const gl_program_location_cache = new Map();
+
+  const gl_program_locations = (program) => {
+    let locations = gl_program_location_cache.get(program);
+    if (locations) {
+      return locations;
+    }
+
+    locations = JSON.parse(text_decoder.decode(gl_query_payload({
+      method: "graphics_gl_get_program_locations",
+      program: program,
+    })));
+    gl_program_location_cache.set(program, locations);
+    return locations;
+  };
+
+  /// Copy an info log to Wasm memory like glGet*InfoLog(): at most max_length bytes including the terminating null,
+  /// with the length excluding it stored to *length (if given).
+  const gl_write_info_log = (log, max_length, length, info_log) => {
+    const log_length = Math.max(Math.min(log.length, max_length - 1), 0);
+    if (length) {
+      const memory_view = new DataView(memory.buffer);
+      memory_view.setInt32(length, log_length, true);
+    }
+
+    if (info_log && max_length > 0) {
+      const memory_u8 = new Uint8Array(memory.buffer);
+      memory_u8.set(log.subarray(0, log_length), info_log);
+      memory_u8[info_log + log_length] = 0;
+    }
+  };
+
+  /// Calls sent to the graphics host (ring commands and queries), and state changes dropped by the state shadow.
+  let gl_calls_issued = 0;
+  let gl_calls_elided = 0;
+
+  /// Client-side shadow of the GL state that programs tend to set over and over again with the same values. Calls that
+  /// would not change it are dropped before they reach the ring. Anything not in here (yet) is unknown and always sent.
+  /// It is thrown away on eglMakeCurrent(), as another thread could have changed the state of the context meanwhile.
+  const GL_ELEMENT_ARRAY_BUFFER = 0x8893;
+  let gl_shadowing = true;
+  let gl_shadow = null;
+
+  const gl_shadow_reset = () => {
+    gl_shadow = {
+      program: undefined,
+      vertex_array: undefined,
+      buffers: new Map(),  // Target -> buffer
+      active_texture: undefined,
+      textures: new Map(),  // "unit:target" -> texture
+      caps: new Map(),  // Capability -> enabled
+      clear_color: undefined,  // [r, g, b, a], as single precision floats
+      viewport: undefined,  // [x, y, width, height]
+      framebuffer: undefined,  // Bound to GL_FRAMEBUFFER
+      renderbuffer: undefined,
+    };
+  };
+  gl_shadow_reset();
+
+  /// Check whether a state change can be dropped because it would not change anything (counting it if so).
+  const gl_shadow_elide = (unchanged) => {
+    if (gl_shadowing && unchanged) {
+      gl_calls_elided++;
+      return true;
+    }
+    return false;
+  };
+
+  /// Read n names from a GLuint array in Wasm memory.
+  const gl_name_list = (n, names) => {
+    const memory_view = new DataView(memory.buffer);
+    const list = [];
+    for (let i = 0; i < n; i++) {
+      list.push(memory_view.getUint32(names + i * 4, true));
+    }
+    return list;
+  };
+
+  /// GL unbinds deleted objects: reset the bindings (in map) of the names in a GLuint array in Wasm memory to 0.
+  const gl_shadow_unbind = (map, n, names) => {
+    const deleted = gl_name_list(n, names);
+    for (const [key, bound] of map) {
+      if (deleted.includes(bound)) {
+        map.set(key, 0);
+      }
+    }
+  };
+
+  /// Current GL_UNPACK_ALIGNMENT and GL_PACK_ALIGNMENT, needed to know how many bytes glTexImage2D() and friends read
+  /// and glReadPixels() writes.
+  let gl_unpack_alignment = 4;
+  let gl_pack_alignment = 4;
+
+  /// Number of bytes that make up one pixel of the given format and type, or 0 if the combination is unsupported.
+  const gl_pixel_size = (format, type) => {
+    switch (type) {
+      case 0x8363: // GL_UNSIGNED_SHORT_5_6_5
+      case 0x8033: // GL_UNSIGNED_SHORT_4_4_4_4
+      case 0x8034: // GL_UNSIGNED_SHORT_5_5_5_1
+        return 2;
+    }
+
+    const component_size = {
+      0x1401: 1, // GL_UNSIGNED_BYTE
+      0x8D61: 2, // GL_HALF_FLOAT_OES
+      0x1406: 4, // GL_FLOAT
+    }[type] || 0;
+    const components = {
+      0x1906: 1, // GL_ALPHA
+      0x1909: 1, // GL_LUMINANCE
+      0x190A: 2, // GL_LUMINANCE_ALPHA
+      0x1907: 3, // GL_RGB
+      0x1908: 4, // GL_RGBA
+    }[format] || 0;
+    return component_size * components;
+  };
+
+  /// Number of bytes of client memory taken by a width x height image (rows but the last are padded to alignment), or -1
+  /// if the format and type combination is unsupported.
+  const gl_image_size = (width, height, format, type, alignment) => {
+    const pixel_size = gl_pixel_size(format, type);
+    if (!pixel_size) {
+      return -1;
+    }
+    if (width <= 0 || height <= 0) {
+      return 0;
+    }
+
+    const row_size = width * pixel_size;
+    const row_stride = Math.ceil(row_size / alignment) * alignment;
+    return row_stride * (height - 1) + row_size;
+  };
+
+  /// Encode a texImage2D/texSubImage2D-style command that reads pixels from Wasm memory, or return false if the
+  /// format/type combination is unsupported (the upload is then dropped).
+  const gl_ring_pixels_command = (func_name, args, width, height, format, type, pixels) => {
+    let size = 0;
+    if (pixels) {
+      size = gl_image_size(width, height, format, type, gl_unpack_alignment);
+      if (size < 0) {
+        log("[Graphics]: " + func_name + " with unsupported format 0x" + format.toString(16) + " and type 0x" +
+          type.toString(16));
+        return false;
+      }
+    }
+    gl_ring_command(func_name, ...args, [pixels, size]);
+    return true;
+  };
+
+  /// Post a graphics message to the graphics host, ordered after all GL commands already in the ring.
+  const graphics_post = (message) => {
+    gl_ring_flush();
+    if (gl_capture && message.method != "graphics_gl_reply_init") {
+      gl_capture_record(GL_TRACE_MESSAGE, text_encoder.encode(JSON.stringify(message)));
+    }
+    graphics_port.postMessage(message);
+  };
+
+  /// Display refresh counter, bumped by the graphics host from requestAnimationFrame (graphics_init in linux-graphics.js).
+  let gl_vblank = null;
+  let gl_swap_interval = 1;  // eglSwapInterval(): refreshes per swap, 0 = not throttled.
+  let gl_last_vblank = -1;  // Refresh that the last swap was paced to.
+
+  /// requestAnimationFrame stops in background tabs. Rather than hanging there, swaps then just crawl along.
+  const GL_VBLANK_TIMEOUT_MS = 100;
+
+  /// Present a frame and, unless the swap interval is 0, block until the display refresh it is due at. Like a FIFO
+  /// swap chain: a frame that misses its refresh is shown at the next one, so frame pacing stays deterministic.
+  const gl_swap_buffers = () => {
+    graphics_post({
+      method: "graphics_swap_buffers",
+    });
+    if (!gl_vblank || gl_swap_interval <= 0) {
+      return;
+    }
+
+    let vblank = Atomics.load(gl_vblank, 0);
+    const target = gl_last_vblank >= 0 && gl_last_vblank + gl_swap_interval > vblank
+      ? gl_last_vblank + gl_swap_interval
+      : vblank + 1;
+    while (vblank - target < 0) {
+      if (Atomics.wait(gl_vblank, 0, vblank, GL_VBLANK_TIMEOUT_MS) === "timed-out") {
+        break;
+      }
+      vblank = Atomics.load(gl_vblank, 0);
+    }
+    gl_last_vblank = Atomics.load(gl_vblank, 0);
+  };
+
+  const EGL_NONE = 0x3038;
+  const EGL_HEIGHT = 0x3056;
+  const EGL_WIDTH = 0x3057;
+
+  /// Read an EGL attribute list (pairs of name and value, up to EGL_NONE) from Wasm memory into a Map.
+  const egl_attribs = (attrib_list) => {
+    const attribs = new Map();
+    if (attrib_list) {
+      const memory_view = new DataView(memory.buffer);
+      for (let pos = attrib_list; memory_view.getInt32(pos, true) != EGL_NONE; pos += 8) {
+        attribs.set(memory_view.getInt32(pos, true), memory_view.getInt32(pos + 4, true));
+      }
+    }
+    return attribs;
+  };
+
   /// Callbacks from within Linux/Wasm out to our host code (cpu is not neccessarily ours).
   const host_callbacks = {
     /// Start secondary CPU.
@@ -117,12 +742,21 @@
 
     /// Serialization of tasks (idle tasks and before SMP is started).
     wasm_serialize_tasks: (prev_task, next_task) => {
-      // Notify the next task that it can run again.
-      port.postMessage({
-        method: "serialize_tasks",
-        prev_task: prev_task,
-        next_task: next_task,
-      });
+      // Notify the next task that it can run again. Tell it where we switched from, so that it can finish the task
+      // switch, then release that write and wake it up. Only tasks without a slot in the task table need the main
+      // thread to do it for us.
+      const slot = task_table ? task_table_find(next_task) : -1;
+      if (slot >= 0) {
+        Atomics.store(task_table, slot + TASK_TABLE_LAST_TASK, prev_task);
+        Atomics.store(task_table, slot + TASK_TABLE_SERIALIZE, 1);
+        Atomics.notify(task_table, slot + TASK_TABLE_SERIALIZE, 1);
+      } else {
+        port.postMessage({
+          method: "serialize_tasks",
+          prev_task: prev_task,
+          next_task: next_task,
+        });
+      }
 
       // Serialize this (old) task.
       return serialize_me();
@@ -152,7 +786,7 @@
 
     /// Replace the currently executing image (kthread spawning init, or user process) with a new user process image.
     wasm_load_executable: (bin_start, bin_end, data_start, table_start) => {
-      user_executable = WebAssembly.compile(new Uint8Array(memory.buffer).slice(bin_start, bin_end));
+      user_executable = executable_compile(new Uint8Array(memory.buffer).slice(bin_start, bin_end));
       user_executable_params = {
         data_start: data_start,
         table_start: table_start,
@@ -230,6 +864,7 @@
       return count;
     },
 
+    /// Console input for kernels without the console input ring (see console_input_flush in linux.js).
     wasm_driver_hvc_get: (buffer, count) => {
       // Reset lock. Using .store() for the memory barrier.
       Atomics.store(console_read_messenger, 0, -1);
@@ -252,17 +887,15 @@
     
     wasm_graphics_init: () => {
       // Initialize graphics subsystem
-      port.postMessage({
+      graphics_post({
         method: "graphics_init",
       });
       return 0; // Success
     },
 
     wasm_graphics_swap_buffers: () => {
-      // Request buffer swap (present frame)
-      port.postMessage({
-        method: "graphics_swap_buffers",
-      });
+      // Present frame (paced to the display refresh, see eglSwapInterval)
+      gl_swap_buffers();
       return 0; // Success
     },
 
@@ -296,70 +929,123 @@
     },
 
     wasm_egl_create_window_surface: (display, config, window, attrib_list) => {
-      // Return a surface ID (simplified: use incrementing IDs)
-      return 1; // Surface ID
+      // The first window surface is the page canvas (see graphics_egl_create_surface in linux-graphics.js)
+      const surface = gl_name_alloc(GL_NAMES_EGL_SURFACES);
+      graphics_post({
+        method: "graphics_egl_create_surface",
+        surface: surface,
+        window: true,
+      });
+      return surface;
+    },
+
+    wasm_egl_create_pbuffer_surface: (display, config, attrib_list) => {
+      // An offscreen surface, sized by EGL_WIDTH and EGL_HEIGHT
+      const attribs = egl_attribs(attrib_list);
+      const surface = gl_name_alloc(GL_NAMES_EGL_SURFACES);
+      graphics_post({
+        method: "graphics_egl_create_surface",
+        surface: surface,
+        window: false,
+        width: attribs.get(EGL_WIDTH) || 0,
+        height: attribs.get(EGL_HEIGHT) || 0,
+      });
+      return surface;
+    },
+
+    wasm_egl_destroy_surface: (display, surface) => {
+      graphics_post({
+        method: "graphics_egl_destroy_surface",
+        surface: surface,
+      });
+      return 1; // EGL_TRUE
     },
 
     wasm_egl_create_context: (display, config, share_context, attrib_list) => {
-      // Return a context ID (simplified: use incrementing IDs)
-      return 1; // Context ID
+      // Each context has its own WebGL context, and WebGL objects can not be shared between those.
+      if (share_context) {
+        log("[Graphics]: Shared EGL contexts are not supported");
+        return 0; // EGL_NO_CONTEXT
+      }
+      const context = gl_name_alloc(GL_NAMES_EGL_CONTEXTS);
+      graphics_post({
+        method: "graphics_egl_create_context",
+        context: context,
+      });
+      return context;
     },
 
-    wasm_egl_make_current: (display, draw, read, context) => {
-      // Make context current (WebGL is always current in our simplified model)
+    wasm_egl_destroy_context: (display, context) => {
+      graphics_post({
+        method: "graphics_egl_destroy_context",
+        context: context,
+      });
       return 1; // EGL_TRUE
     },
 
-    wasm_egl_swap_buffers: (display, surface) => {
-      // Swap buffers
-      port.postMessage({
-        method: "graphics_swap_buffers",
+    wasm_egl_make_current: (display, draw, read, context) => {
+      // Commands in the ring so far still go to the previous context. Reads come from the draw surface as well.
+      const result = gl_query({
+        method: "graphics_egl_make_current",
+        context: context,
+        surface: draw,
       });
+      // The state of the context is not necessarily the one we last saw (another thread may have used it)
+      gl_shadow_reset();
+      return result; // EGL_TRUE, or EGL_FALSE
+    },
+
+    wasm_egl_swap_buffers: (display, surface) => {
+      // Swap buffers (paced to the display refresh, see eglSwapInterval)
+      gl_swap_buffers();
       return 1; // EGL_TRUE
     },
 
-    // OpenGL ES callback helpers (these forward to the main thread)
+    wasm_egl_swap_interval: (display, interval) => {
+      // Number of display refreshes per swap, 0 for unthrottled swaps (benchmarks)
+      gl_swap_interval = Math.max(interval, 0);
+      gl_last_vblank = -1;
+      return 1; // EGL_TRUE
+    },
+
+    // OpenGL ES callback helpers (these forward to the graphics host, mostly through the GL command ring)
     wasm_gl_clear: (mask) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "clear",
-        args: [mask],
-      });
+      gl_ring_command("clear", mask);
     },
 
     wasm_gl_clear_color: (r, g, b, a) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "clearColor",
-        args: [r, g, b, a],
-      });
+      const color = [Math.fround(r), Math.fround(g), Math.fround(b), Math.fround(a)];
+      const current = gl_shadow.clear_color;
+      if (gl_shadow_elide(current && color.every((value, i) => value === current[i]))) return;
+      gl_shadow.clear_color = color;
+      gl_ring_command("clearColor", r, g, b, a);
     },
 
     wasm_gl_viewport: (x, y, width, height) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "viewport",
-        args: [x, y, width, height],
-      });
+      const viewport = [x, y, width, height];
+      const current = gl_shadow.viewport;
+      if (gl_shadow_elide(current && viewport.every((value, i) => value === current[i]))) return;
+      gl_shadow.viewport = viewport;
+      gl_ring_command("viewport", x, y, width, height);
+    },
+
+    wasm_gl_flush: () => {
+      gl_ring_command("flush");
+      gl_ring_flush();
+    },
+
+    wasm_gl_finish: () => {
+      // Unlike a fence, this also works without a command ring: the graphics host answers once it has executed
+      // everything posted before (graphics_post() flushes the ring first).
+      gl_query({ method: "graphics_gl_finish" });
     },
 
     // Shader functions
     wasm_gl_create_shader: (type) => {
-      // WebGL shader creation must return an ID
-      // Use a synchronous approach via SharedArrayBuffer
-      const result = new Int32Array(new SharedArrayBuffer(4));
-      Atomics.store(result, 0, -1);
-      
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "createShader",
-        args: [type],
-        result_buffer: result,
-      });
-      
-      // Wait for result
-      Atomics.wait(result, 0, -1);
-      return Atomics.load(result, 0);
+      // Names are allocated here, the graphics host creates the WebGLShader when it executes the command.
+      const shader = gl_name_alloc(GL_NAMES_SHADERS_PROGRAMS);
+      gl_ring_command("createShader", shader, type);
+      return shader;
     },
 
     wasm_gl_shader_source: (shader, count, string, length) => {
@@ -383,487 +1069,528 @@
         source += text_decoder.decode(memory_u8.slice(str_ptr, str_ptr + str_len));
       }
       
-      port.postMessage({
+      graphics_post({
         method: "graphics_gl_shader_source",
         shader: shader,
         source: source,
       });
     },
 
+    wasm_gl_delete_shader: (shader) => {
+      gl_ring_command("deleteShader", shader);
+    },
+
     wasm_gl_compile_shader: (shader) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "compileShader",
-        args: [shader],
-        is_shader_id: true,
-      });
+      gl_ring_command("compileShader", shader);
     },
 
     wasm_gl_get_shaderiv: (shader, pname, params) => {
-      const result = new Int32Array(new SharedArrayBuffer(4));
-      Atomics.store(result, 0, -999);
-      
-      port.postMessage({
+      const result = gl_query({
         method: "graphics_gl_get_shaderiv",
         shader: shader,
         pname: pname,
-        result_buffer: result,
       });
-      
-      Atomics.wait(result, 0, -999);
-      
+
       if (params) {
         const memory_view = new DataView(memory.buffer);
-        memory_view.setInt32(params, Atomics.load(result, 0), true);
+        memory_view.setInt32(params, result, true);
       }
     },
 
     wasm_gl_get_shader_info_log: (shader, max_length, length, info_log) => {
-      const result_len = new Int32Array(new SharedArrayBuffer(4));
-      const result_str = new Int8Array(new SharedArrayBuffer(max_length));
-      
-      port.postMessage({
+      gl_write_info_log(gl_query_payload({
         method: "graphics_gl_get_shader_info_log",
         shader: shader,
-        max_length: max_length,
-        result_len: result_len,
-        result_str: result_str,
-      });
-      
-      Atomics.wait(result_len, 0, 0);
-      
-      const log_length = Atomics.load(result_len, 0);
-      if (length) {
-        const memory_view = new DataView(memory.buffer);
-        memory_view.setInt32(length, log_length, true);
-      }
-      
-      if (info_log && log_length > 0) {
-        const memory_u8 = new Uint8Array(memory.buffer);
-        memory_u8.set(new Uint8Array(result_str.buffer, 0, log_length), info_log);
-      }
+      }), max_length, length, info_log);
     },
 
     // Program functions
     wasm_gl_create_program: () => {
-      const result = new Int32Array(new SharedArrayBuffer(4));
-      Atomics.store(result, 0, -1);
-      
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "createProgram",
-        args: [],
-        result_buffer: result,
-      });
-      
-      Atomics.wait(result, 0, -1);
-      return Atomics.load(result, 0);
+      const program = gl_name_alloc(GL_NAMES_SHADERS_PROGRAMS);
+      gl_ring_command("createProgram", program);
+      return program;
+    },
+
+    wasm_gl_delete_program: (program) => {
+      gl_ring_command("deleteProgram", program);
+      gl_program_location_cache.delete(program);
+      gl_program_links.delete(program);
     },
 
     wasm_gl_attach_shader: (program, shader) => {
-      port.postMessage({
-        method: "graphics_gl_attach_shader",
-        program: program,
-        shader: shader,
-      });
+      gl_ring_command("attachShader", program, shader);
     },
 
     wasm_gl_link_program: (program) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "linkProgram",
-        args: [program],
-        is_program_id: true,
-      });
+      gl_link_serial++;
+      gl_program_links.set(program, gl_link_serial);
+      gl_ring_command("linkProgram", program, gl_link_serial);
+      gl_program_location_cache.delete(program);
+    },
+
+    wasm_gl_program_ready: (program) => {
+      // No round trip: the graphics host bumps the link word of the ring as links complete.
+      const link = gl_program_links.get(program);
+      if (!link || Atomics.load(gl_ring, GL_RING_LINKED) >= link) {
+        return 1;
+      }
+      gl_ring_flush();  // Get the link going, if it has not been sent yet.
+      return 0;
     },
 
     wasm_gl_use_program: (program) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "useProgram",
-        args: [program],
-        is_program_id: true,
-      });
+      if (gl_shadow_elide(gl_shadow.program === program)) return;
+      gl_shadow.program = program;
+      gl_ring_command("useProgram", program);
     },
 
     wasm_gl_get_programiv: (program, pname, params) => {
-      const result = new Int32Array(new SharedArrayBuffer(4));
-      Atomics.store(result, 0, -999);
-      
-      port.postMessage({
+      const result = gl_query({
         method: "graphics_gl_get_programiv",
         program: program,
         pname: pname,
-        result_buffer: result,
       });
-      
-      Atomics.wait(result, 0, -999);
-      
+
       if (params) {
         const memory_view = new DataView(memory.buffer);
-        memory_view.setInt32(params, Atomics.load(result, 0), true);
+        memory_view.setInt32(params, result, true);
       }
     },
 
     wasm_gl_get_program_info_log: (program, max_length, length, info_log) => {
-      const result_len = new Int32Array(new SharedArrayBuffer(4));
-      const result_str = new Int8Array(new SharedArrayBuffer(max_length));
-      
-      port.postMessage({
+      gl_write_info_log(gl_query_payload({
         method: "graphics_gl_get_program_info_log",
         program: program,
-        max_length: max_length,
-        result_len: result_len,
-        result_str: result_str,
-      });
-      
-      Atomics.wait(result_len, 0, 0);
-      
-      const log_length = Atomics.load(result_len, 0);
-      if (length) {
-        const memory_view = new DataView(memory.buffer);
-        memory_view.setInt32(length, log_length, true);
-      }
-      
-      if (info_log && log_length > 0) {
-        const memory_u8 = new Uint8Array(memory.buffer);
-        memory_u8.set(new Uint8Array(result_str.buffer, 0, log_length), info_log);
-      }
+      }), max_length, length, info_log);
     },
 
     // Attribute and uniform functions
     wasm_gl_get_attrib_location: (program, name) => {
-      const memory_u8 = new Uint8Array(memory.buffer);
-      const attr_name = get_cstring(memory, name);
-      
-      const result = new Int32Array(new SharedArrayBuffer(4));
-      Atomics.store(result, 0, -999);
-      
-      port.postMessage({
-        method: "graphics_gl_get_attrib_location",
-        program: program,
-        name: attr_name,
-        result_buffer: result,
-      });
-      
-      Atomics.wait(result, 0, -999);
-      return Atomics.load(result, 0);
+      const location = gl_program_locations(program).attributes[get_cstring(memory, name)];
+      return (location === undefined) ? -1 : location;
     },
 
     wasm_gl_get_uniform_location: (program, name) => {
-      const attr_name = get_cstring(memory, name);
-      
-      const result = new Int32Array(new SharedArrayBuffer(4));
-      Atomics.store(result, 0, -999);
-      
-      port.postMessage({
-        method: "graphics_gl_get_uniform_location",
-        program: program,
-        name: attr_name,
-        result_buffer: result,
-      });
-      
-      Atomics.wait(result, 0, -999);
-      return Atomics.load(result, 0);
+      const location = gl_program_locations(program).uniforms[get_cstring(memory, name)];
+      return (location === undefined) ? -1 : location;
     },
 
     wasm_gl_enable_vertex_attrib_array: (index) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "enableVertexAttribArray",
-        args: [index],
-      });
+      gl_ring_command("enableVertexAttribArray", index);
     },
 
     wasm_gl_disable_vertex_attrib_array: (index) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "disableVertexAttribArray",
-        args: [index],
-      });
+      gl_ring_command("disableVertexAttribArray", index);
+    },
+
+    // Vertex array objects
+    wasm_gl_gen_vertex_arrays: (n, arrays) => {
+      // The graphics host creates the vertex array object when it first sees the name on glBindVertexArray.
+      gl_name_gen(GL_NAMES_VERTEX_ARRAYS, n, arrays);
+    },
+
+    wasm_gl_bind_vertex_array: (array) => {
+      if (gl_shadow_elide(gl_shadow.vertex_array === array)) return;
+      gl_shadow.vertex_array = array;
+      gl_shadow.buffers.delete(GL_ELEMENT_ARRAY_BUFFER);  // Part of the vertex array object state.
+      gl_ring_command("bindVertexArray", array);
+    },
+
+    wasm_gl_delete_vertex_arrays: (n, arrays) => {
+      if (gl_name_list(n, arrays).includes(gl_shadow.vertex_array)) {
+        gl_shadow.vertex_array = 0;
+        gl_shadow.buffers.delete(GL_ELEMENT_ARRAY_BUFFER);
+      }
+      gl_name_delete("deleteVertexArray", n, arrays);
     },
 
     wasm_gl_vertex_attrib_pointer: (index, size, type, normalized, stride, pointer) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "vertexAttribPointer",
-        args: [index, size, type, normalized, stride, pointer],
-      });
+      gl_ring_command("vertexAttribPointer", index, size, type, normalized, stride, pointer);
     },
 
     // Buffer functions
     wasm_gl_gen_buffers: (n, buffers) => {
-      const result = new Uint32Array(new SharedArrayBuffer(n * 4));
-      
-      port.postMessage({
-        method: "graphics_gl_gen_buffers",
-        n: n,
-        result_buffer: result,
-      });
-      
-      Atomics.wait(new Int32Array(result.buffer), 0, 0);
-      
-      if (buffers) {
-        const memory_view = new DataView(memory.buffer);
-        for (let i = 0; i < n; i++) {
-          memory_view.setUint32(buffers + i * 4, result[i], true);
-        }
-      }
+      // The graphics host creates the WebGLBuffer when it first sees the name (e.g. on glBindBuffer).
+      gl_name_gen(GL_NAMES_BUFFERS, n, buffers);
+    },
+
+    wasm_gl_delete_buffers: (n, buffers) => {
+      gl_shadow_unbind(gl_shadow.buffers, n, buffers);
+      gl_name_delete("deleteBuffer", n, buffers);
     },
 
     wasm_gl_bind_buffer: (target, buffer) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "bindBuffer",
-        args: [target, buffer],
-        is_buffer_id: true,
-      });
+      if (gl_shadow_elide(gl_shadow.buffers.get(target) === buffer)) return;
+      gl_shadow.buffers.set(target, buffer);
+      gl_ring_command("bindBuffer", target, buffer);
     },
 
     wasm_gl_buffer_data: (target, size, data, usage) => {
-      let buffer_data = null;
+      // The graphics host reads the data straight out of Wasm memory, so we have to wait for that to happen before the
+      // caller may reuse it (GL semantics). Use wasm_gl_buffer_data_unsynchronized() and a fence to avoid waiting.
+      host_callbacks.wasm_gl_buffer_data_unsynchronized(target, size, data, usage);
       if (data) {
-        const memory_u8 = new Uint8Array(memory.buffer);
-        buffer_data = memory_u8.slice(data, data + size);
+        gl_fence_wait(gl_fence_insert(), Infinity);
       }
-      
-      port.postMessage({
-        method: "graphics_gl_buffer_data",
-        target: target,
-        size: size,
-        data: buffer_data,
-        usage: usage,
-      });
+    },
+
+    wasm_gl_buffer_sub_data: (target, offset, size, data) => {
+      host_callbacks.wasm_gl_buffer_sub_data_unsynchronized(target, offset, size, data);
+      gl_fence_wait(gl_fence_insert(), Infinity);
+    },
+
+    wasm_gl_buffer_data_unsynchronized: (target, size, data, usage) => {
+      if (data) {
+        gl_ring_command("bufferData", target, [data, size], usage);
+      } else {
+        gl_ring_command("bufferDataSize", target, size, usage);
+      }
+    },
+
+    wasm_gl_buffer_sub_data_unsynchronized: (target, offset, size, data) => {
+      gl_ring_command("bufferSubData", target, offset, [data, size]);
+    },
+
+    // Sync objects. A fence is signaled when the graphics host has consumed every command before it, which is when
+    // memory passed to the unsynchronized upload functions may be reused.
+    wasm_gl_fence_sync: (condition, flags) => {
+      return gl_fence_insert();
+    },
+
+    wasm_gl_client_wait_sync: (sync, flags, timeout) => {
+      if (!gl_ring || sync <= 0 || sync > gl_fence_serial) {
+        return 0x911D; // GL_WAIT_FAILED
+      }
+      if (Atomics.load(gl_ring, GL_RING_FENCE) >= sync) {
+        return 0x911A; // GL_ALREADY_SIGNALED
+      }
+      return gl_fence_wait(sync, gl_timeout_ms(timeout)) ? 0x911C /* GL_CONDITION_SATISFIED */ : 0x911B /* GL_TIMEOUT_EXPIRED */;
+    },
+
+    wasm_gl_delete_sync: (sync) => {
+      // Fences are plain serial numbers, there is nothing to release.
     },
 
     // Drawing functions
     wasm_gl_draw_arrays: (mode, first, count) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "drawArrays",
-        args: [mode, first, count],
-      });
+      gl_ring_command("drawArrays", mode, first, count);
     },
 
     wasm_gl_draw_elements: (mode, count, type, indices) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "drawElements",
-        args: [mode, count, type, indices],
-      });
+      gl_ring_command("drawElements", mode, count, type, indices);
+    },
+
+    wasm_gl_draw_arrays_instanced: (mode, first, count, instance_count) => {
+      gl_ring_command("drawArraysInstanced", mode, first, count, instance_count);
+    },
+
+    wasm_gl_draw_elements_instanced: (mode, count, type, indices, instance_count) => {
+      gl_ring_command("drawElementsInstanced", mode, count, type, indices, instance_count);
+    },
+
+    wasm_gl_vertex_attrib_divisor: (index, divisor) => {
+      gl_ring_command("vertexAttribDivisor", index, divisor);
     },
 
     // Uniform functions
     wasm_gl_uniform1f: (location, v0) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "uniform1f",
-        args: [location, v0],
-        is_uniform_location: true,
-      });
+      gl_ring_command("uniform1f", location, v0);
     },
 
     wasm_gl_uniform1i: (location, v0) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "uniform1i",
-        args: [location, v0],
-        is_uniform_location: true,
-      });
+      gl_ring_command("uniform1i", location, v0);
     },
 
     wasm_gl_uniform_matrix4fv: (location, count, transpose, value) => {
-      const memory_f32 = new Float32Array(memory.buffer);
-      const matrix = Array.from(memory_f32.slice(value / 4, value / 4 + 16 * count));
-      
-      port.postMessage({
-        method: "graphics_gl_uniform_matrix4fv",
-        location: location,
-        count: count,
-        transpose: transpose,
-        value: matrix,
-      });
+      gl_ring_command("uniformMatrix4fv", location, transpose, new Float32Array(memory.buffer, value, 16 * count));
     },
 
     // Additional uniform functions
     wasm_gl_uniform2f: (location, v0, v1) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "uniform2f",
-        args: [location, v0, v1],
-        is_uniform_location: true,
-      });
+      gl_ring_command("uniform2f", location, v0, v1);
     },
 
     wasm_gl_uniform3f: (location, v0, v1, v2) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "uniform3f",
-        args: [location, v0, v1, v2],
-        is_uniform_location: true,
-      });
+      gl_ring_command("uniform3f", location, v0, v1, v2);
     },
 
     wasm_gl_uniform4f: (location, v0, v1, v2, v3) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "uniform4f",
-        args: [location, v0, v1, v2, v3],
-        is_uniform_location: true,
-      });
+      gl_ring_command("uniform4f", location, v0, v1, v2, v3);
     },
 
     wasm_gl_uniform2fv: (location, count, value) => {
-      const memory_f32 = new Float32Array(memory.buffer);
-      const vec = Array.from(memory_f32.slice(value / 4, value / 4 + 2 * count));
-      
-      port.postMessage({
-        method: "graphics_gl_uniform_fv",
-        location: location,
-        count: count,
-        size: 2,
-        value: vec,
-      });
+      gl_ring_command("uniform2fv", location, new Float32Array(memory.buffer, value, 2 * count));
     },
 
     wasm_gl_uniform3fv: (location, count, value) => {
-      const memory_f32 = new Float32Array(memory.buffer);
-      const vec = Array.from(memory_f32.slice(value / 4, value / 4 + 3 * count));
-      
-      port.postMessage({
-        method: "graphics_gl_uniform_fv",
-        location: location,
-        count: count,
-        size: 3,
-        value: vec,
-      });
+      gl_ring_command("uniform3fv", location, new Float32Array(memory.buffer, value, 3 * count));
     },
 
     wasm_gl_uniform4fv: (location, count, value) => {
-      const memory_f32 = new Float32Array(memory.buffer);
-      const vec = Array.from(memory_f32.slice(value / 4, value / 4 + 4 * count));
-      
-      port.postMessage({
-        method: "graphics_gl_uniform_fv",
-        location: location,
-        count: count,
-        size: 4,
-        value: vec,
-      });
+      gl_ring_command("uniform4fv", location, new Float32Array(memory.buffer, value, 4 * count));
     },
 
     // Texture functions
-    wasm_gl_gen_textures: (n, textures_ptr) => {
-      const result_buffer_i32 = new Int32Array(shared_result_buffer);
-      result_buffer_i32[0] = 0; // Reset result flag
-      
-      port.postMessage({
-        method: "graphics_gl_gen_textures",
-        n: n,
-      });
-      
-      // Wait for main thread to generate textures
-      Atomics.wait(result_buffer_i32, 0, 0);
-      
-      // Read texture IDs from result buffer
-      const memory_u32 = new Uint32Array(memory.buffer);
-      for (let i = 0; i < n; i++) {
-        memory_u32[textures_ptr / 4 + i] = result_buffer_i32[1 + i];
-      }
+    wasm_gl_gen_textures: (n, textures) => {
+      // The graphics host creates the WebGLTexture when it first sees the name (e.g. on glBindTexture).
+      gl_name_gen(GL_NAMES_TEXTURES, n, textures);
     },
 
     wasm_gl_bind_texture: (target, texture) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "bindTexture",
-        args: [target, texture],
-        is_texture: true,
-      });
+      // Bindings are per texture unit, so they can only be tracked while the active one is known.
+      const key = gl_shadow.active_texture + ":" + target;
+      if (gl_shadow_elide(gl_shadow.textures.get(key) === texture)) return;
+      if (gl_shadow.active_texture !== undefined) {
+        gl_shadow.textures.set(key, texture);
+      }
+      gl_ring_command("bindTexture", target, texture);
     },
 
-    wasm_gl_delete_textures: (n, textures_ptr) => {
-      const memory_u32 = new Uint32Array(memory.buffer);
-      const texture_ids = [];
-      for (let i = 0; i < n; i++) {
-        texture_ids.push(memory_u32[textures_ptr / 4 + i]);
+    wasm_gl_delete_textures: (n, textures) => {
+      gl_shadow_unbind(gl_shadow.textures, n, textures);
+      gl_name_delete("deleteTexture", n, textures);
+    },
+
+    wasm_gl_tex_image_2d: (target, level, internalformat, width, height, border, format, type, pixels) => {
+      // Zero-copy, just like wasm_gl_buffer_data() - we have to wait for the pixels to be read before returning.
+      if (host_callbacks.wasm_gl_tex_image_2d_unsynchronized(
+          target, level, internalformat, width, height, border, format, type, pixels) && pixels) {
+        gl_fence_wait(gl_fence_insert(), Infinity);
       }
-      
-      port.postMessage({
-        method: "graphics_gl_delete_textures",
-        texture_ids: texture_ids,
-      });
     },
 
-    wasm_gl_tex_image_2d: (target, level, internalformat, width, height, border, format, type, data_ptr) => {
-      let data = null;
-      if (data_ptr !== 0) {
-        // Calculate the size of the texture data based on format and type
-        let bytes_per_pixel = 4; // RGBA by default
-        if (format === 0x1907) { // GL_RGB
-          bytes_per_pixel = 3;
-        } else if (format === 0x1909) { // GL_LUMINANCE
-          bytes_per_pixel = 1;
-        } else if (format === 0x190A) { // GL_LUMINANCE_ALPHA
-          bytes_per_pixel = 2;
+    wasm_gl_tex_sub_image_2d: (target, level, xoffset, yoffset, width, height, format, type, pixels) => {
+      if (host_callbacks.wasm_gl_tex_sub_image_2d_unsynchronized(
+          target, level, xoffset, yoffset, width, height, format, type, pixels) && pixels) {
+        gl_fence_wait(gl_fence_insert(), Infinity);
+      }
+    },
+
+    wasm_gl_tex_image_2d_unsynchronized: (target, level, internalformat, width, height, border, format, type, pixels) => {
+      return gl_ring_pixels_command("texImage2D", [target, level, internalformat, width, height, border, format, type],
+        width, height, format, type, pixels);
+    },
+
+    wasm_gl_tex_sub_image_2d_unsynchronized: (target, level, xoffset, yoffset, width, height, format, type, pixels) => {
+      return gl_ring_pixels_command("texSubImage2D", [target, level, xoffset, yoffset, width, height, format, type],
+        width, height, format, type, pixels);
+    },
+
+    wasm_gl_compressed_tex_image_2d: (target, level, internalformat, width, height, border, image_size, data) => {
+      // The host reads the blocks straight out of Wasm memory, see wasm_gl_tex_image_2d().
+      gl_ring_command("compressedTexImage2D", target, level, internalformat, width, height, border, [data, image_size]);
+      gl_fence_wait(gl_fence_insert(), Infinity);
+    },
+
+    wasm_gl_compressed_tex_sub_image_2d: (target, level, xoffset, yoffset, width, height, format, image_size, data) => {
+      gl_ring_command("compressedTexSubImage2D", target, level, xoffset, yoffset, width, height, format,
+        [data, image_size]);
+      gl_fence_wait(gl_fence_insert(), Infinity);
+    },
+
+    wasm_gl_generate_mipmap: (target) => {
+      gl_ring_command("generateMipmap", target);
+    },
+
+    wasm_gl_pixel_storei: (pname, param) => {
+      if (pname == 0x0CF5) { // GL_UNPACK_ALIGNMENT
+        gl_unpack_alignment = param;
+      } else if (pname == 0x0D05) { // GL_PACK_ALIGNMENT
+        gl_pack_alignment = param;
+      }
+      gl_ring_command("pixelStorei", pname, param);
+    },
+
+    // Pixel readback. The graphics host writes the pixels straight into Wasm memory when it gets to the command.
+    wasm_gl_read_pixels: (x, y, width, height, format, type, pixels) => {
+      const size = gl_image_size(width, height, format, type, gl_pack_alignment);
+      if (size < 0) {
+        log("[Graphics]: readPixels with unsupported format 0x" + format.toString(16) + " and type 0x" +
+          type.toString(16));
+        return;
+      }
+      gl_ring_command("readPixels", x, y, width, height, format, type, [pixels, size]);
+      gl_fence_wait(gl_fence_insert(), Infinity);
+    },
+
+    wasm_gl_read_pixels_async: (x, y, width, height, format, type, pixels, done) => {
+      const size = gl_image_size(width, height, format, type, gl_pack_alignment);
+      if (size < 0) {
+        log("[Graphics]: readPixels with unsupported format 0x" + format.toString(16) + " and type 0x" +
+          type.toString(16));
+        return 0;
+      }
+      if (!done || done % 4) {
+        log("[Graphics]: readPixels completion word is not 4-byte aligned");
+        return 0;
+      }
+      Atomics.store(new Int32Array(memory.buffer), done / 4, 0);
+      gl_ring_command("readPixelsAsync", x, y, width, height, format, type, [pixels, size], [done, 4]);
+      gl_ring_flush();  // Get the copy going now rather than at the end of the frame.
+      return 1;
+    },
+
+    wasm_gl_read_pixels_wait: (done, timeout) => {
+      if (!done || done % 4) {
+        return 0x911D; // GL_WAIT_FAILED
+      }
+      const memory_i32 = new Int32Array(memory.buffer);
+      if (Atomics.load(memory_i32, done / 4)) {
+        return 0x911A; // GL_ALREADY_SIGNALED
+      }
+      gl_ring_flush();
+
+      const deadline = performance.now() + gl_timeout_ms(timeout);
+      while (!Atomics.load(memory_i32, done / 4)) {
+        const remaining = deadline - performance.now();
+        if (remaining <= 0) {
+          return 0x911B; // GL_TIMEOUT_EXPIRED
         }
-        
-        const size = width * height * bytes_per_pixel;
-        const memory_u8 = new Uint8Array(memory.buffer);
-        data = Array.from(memory_u8.slice(data_ptr, data_ptr + size));
+        Atomics.wait(memory_i32, done / 4, 0, remaining);
       }
-      
-      port.postMessage({
-        method: "graphics_gl_tex_image_2d",
-        target: target,
-        level: level,
-        internalformat: internalformat,
-        width: width,
-        height: height,
-        border: border,
-        format: format,
-        type: type,
-        data: data,
-      });
+      return 0x911C; // GL_CONDITION_SATISFIED
     },
 
     wasm_gl_tex_parameteri: (target, pname, param) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "texParameteri",
-        args: [target, pname, param],
-      });
+      gl_ring_command("texParameteri", target, pname, param);
     },
 
     wasm_gl_tex_parameterf: (target, pname, param) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "texParameterf",
-        args: [target, pname, param],
-      });
+      gl_ring_command("texParameterf", target, pname, param);
     },
 
     wasm_gl_active_texture: (texture) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "activeTexture",
-        args: [texture],
-      });
+      if (gl_shadow_elide(gl_shadow.active_texture === texture)) return;
+      gl_shadow.active_texture = texture;
+      gl_ring_command("activeTexture", texture);
     },
 
     wasm_gl_enable: (cap) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "enable",
-        args: [cap],
-      });
+      if (gl_shadow_elide(gl_shadow.caps.get(cap) === true)) return;
+      gl_shadow.caps.set(cap, true);
+      gl_ring_command("enable", cap);
     },
 
     wasm_gl_disable: (cap) => {
-      port.postMessage({
-        method: "graphics_gl_call",
-        func_name: "disable",
-        args: [cap],
+      if (gl_shadow_elide(gl_shadow.caps.get(cap) === false)) return;
+      gl_shadow.caps.set(cap, false);
+      gl_ring_command("disable", cap);
+    },
+
+    wasm_gl_get_integerv: (pname, params) => {
+      // Answered by the graphics host as an array of GLints (one for scalars), written to params as is.
+      const result = gl_query_payload({
+        method: "graphics_gl_get_integerv",
+        pname: pname,
       });
+      if (params) {
+        new Uint8Array(memory.buffer).set(result, params);
+      }
+    },
+
+    // Framebuffer and renderbuffer objects
+    wasm_gl_gen_framebuffers: (n, framebuffers) => {
+      // The graphics host creates the WebGLFramebuffer when it first sees the name (on glBindFramebuffer).
+      gl_name_gen(GL_NAMES_FRAMEBUFFERS, n, framebuffers);
+    },
+
+    wasm_gl_bind_framebuffer: (target, framebuffer) => {
+      // GL_FRAMEBUFFER binds both the draw and the read framebuffer, so binding either of those (WebGL2) on its own
+      // makes the shadow unknown.
+      const both = target == 0x8D40;  // GL_FRAMEBUFFER
+      if (gl_shadow_elide(both && gl_shadow.framebuffer === framebuffer)) return;
+      gl_shadow.framebuffer = both ? framebuffer : undefined;
+      gl_ring_command("bindFramebuffer", target, framebuffer);
+    },
+
+    wasm_gl_delete_framebuffers: (n, framebuffers) => {
+      if (gl_name_list(n, framebuffers).includes(gl_shadow.framebuffer)) {
+        gl_shadow.framebuffer = 0;
+      }
+      gl_name_delete("deleteFramebuffer", n, framebuffers);
+    },
+
+    wasm_gl_framebuffer_texture_2d: (target, attachment, textarget, texture, level) => {
+      gl_ring_command("framebufferTexture2D", target, attachment, textarget, texture, level);
+    },
+
+    wasm_gl_framebuffer_renderbuffer: (target, attachment, renderbuffertarget, renderbuffer) => {
+      gl_ring_command("framebufferRenderbuffer", target, attachment, renderbuffertarget, renderbuffer);
+    },
+
+    wasm_gl_check_framebuffer_status: (target) => {
+      return gl_query({
+        method: "graphics_gl_check_framebuffer_status",
+        target: target,
+      });
+    },
+
+    wasm_gl_gen_renderbuffers: (n, renderbuffers) => {
+      gl_name_gen(GL_NAMES_RENDERBUFFERS, n, renderbuffers);
+    },
+
+    wasm_gl_bind_renderbuffer: (target, renderbuffer) => {
+      if (gl_shadow_elide(gl_shadow.renderbuffer === renderbuffer)) return;
+      gl_shadow.renderbuffer = renderbuffer;
+      gl_ring_command("bindRenderbuffer", target, renderbuffer);
+    },
+
+    wasm_gl_delete_renderbuffers: (n, renderbuffers) => {
+      if (gl_name_list(n, renderbuffers).includes(gl_shadow.renderbuffer)) {
+        gl_shadow.renderbuffer = 0;
+      }
+      gl_name_delete("deleteRenderbuffer", n, renderbuffers);
+    },
+
+    wasm_gl_renderbuffer_storage: (target, internalformat, width, height) => {
+      gl_ring_command("renderbufferStorage", target, internalformat, width, height);
+    },
+
+    // State shadowing controls and counters (not part of GL)
+    wasm_gl_state_shadowing: (enabled) => {
+      gl_shadowing = !!enabled;
+    },
+
+    wasm_gl_get_call_counts: (issued, elided) => {
+      const memory_view = new DataView(memory.buffer);
+      if (issued) memory_view.setUint32(issued, gl_calls_issued, true);
+      if (elided) memory_view.setUint32(elided, gl_calls_elided, true);
+    },
+
+    // GL capture (not part of GL), see gl_capture
+    wasm_gl_capture_begin: () => {
+      gl_ring_flush();
+      gl_capture = [];
+    },
+
+    wasm_gl_capture_end: (name) => {
+      if (!gl_capture) {
+        return 0;
+      }
+      gl_ring_flush();
+
+      const table = text_encoder.encode(JSON.stringify(gl_commands));
+      const header = new Uint8Array(GL_TRACE_MAGIC.length + 4 + ((table.length + 3) & ~3));
+      header.set(text_encoder.encode(GL_TRACE_MAGIC), 0);
+      new DataView(header.buffer).setUint32(GL_TRACE_MAGIC.length, table.length, true);
+      header.set(table, GL_TRACE_MAGIC.length + 4);
+      gl_capture.unshift(header);
+
+      const trace = new Uint8Array(gl_capture.reduce((size, chunk) => size + chunk.length, 0));
+      let offset = 0;
+      for (const chunk of gl_capture) {
+        trace.set(chunk, offset);
+        offset += chunk.length;
+      }
+      gl_capture = null;
+
+      // The main thread offers the trace for download.
+      port.postMessage({
+        method: "graphics_capture_save",
+        name: get_cstring(memory, name),
+        trace: trace.buffer,
+      }, [trace.buffer]);
+      return 1;
     },
   };
 
@@ -874,9 +1601,15 @@
       memory = message.memory;
       locks = message.locks;
       switch_to_last_task = message.last_task; // Only defined for tasks and CPU 0 (init task).
+      task_table = message.task_table;
+      gl_names = message.gl_names || new Int32Array(GL_NAMES_KINDS); // Without graphics, only unique to us.
+      gl_vblank = message.gl_vblank || null;
+      graphics_port = message.graphics_port;
+      module_cache = !!message.module_cache;
 
       if (message.user_executable) {
-        // We are in a new runner that should duplicate the user executable. Happens when someone calls clone().
+        // We are in a new runner that should duplicate the user executable. Happens when someone calls clone(). The
+        // compiled module of our parent comes from the cache (see executable_compile()).
         host_callbacks.wasm_load_executable(
           message.user_executable.bin_start,
           message.user_executable.bin_end,
@@ -929,12 +1662,35 @@
         });
       };
 
+      /// For a pooled task runner: park until make_task() in linux.js hands us a task in our task descriptor.
+      const task_claim = () => {
+        const descriptor = message.task_descriptor;
+        if (!descriptor) return;
+
+        const words = descriptor._memory;
+        Atomics.wait(words, descriptor.claimed, 0);
+        message.prev_task = words[descriptor.prev_task];
+        message.new_task = words[descriptor.new_task];
+        runner_name = text_decoder.decode(
+          new Uint8Array(words.buffer, descriptor.name * 4, words[descriptor.name_length]).slice());
+
+        if (words[descriptor.bin_start]) {
+          host_callbacks.wasm_load_executable(
+            words[descriptor.bin_start],
+            words[descriptor.bin_end],
+            words[descriptor.data_start],
+            words[descriptor.table_start]);
+        }
+      };
+
       const vmlinux_run = () => {
         if (message.runner_type == "primary_cpu") {
-          // Notify the main thread about init task so that it knows where it resides in memory.
+          // Notify the main thread about init task so that it knows where it resides in memory. Likewise for the
+          // console input ring, that it writes keyboard input into (absent in kernels that ask for it by console_read).
           port.postMessage({
             method: "start_primary",
             init_task: vmlinux_instance.exports.init_task.value,
+            console_input: vmlinux_instance.exports.hvc_wasm_input ? vmlinux_instance.exports.hvc_wasm_input.value : 0,
           });
 
           // Setup the boot command line. We have the luxury to be able to write to it directly. The maximum length is
@@ -1115,7 +1871,16 @@
       // All tasks start in the kernel, some return to userland, where they should never return. If they return, we
       // handle this as an error and wait. Our life ends when the kernel kills us by terminating the whole Worker. Oh,
       // and exex() can trap us, in which case we have to circle back to loading new user code and executing it agian.
-      vmlinux_setup().then(vmlinux_run).catch(wasm_error).then(user_executable_chain);
+      vmlinux_setup().then(task_claim).then(vmlinux_run).catch(wasm_error).then(user_executable_chain);
+    },
+
+    /// Answer to executable_lookup (see executable_compile()): the compiled module, or null if we should compile it.
+    executable_module: (message) => {
+      const resolve = executable_lookups.get(message.key);
+      executable_lookups.delete(message.key);
+      if (resolve) {
+        resolve(message.module);
+      }
     },
   };
 
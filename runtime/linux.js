@@ -1,20 +1,147 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
-/// Create a Linux machine and run it.
-const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_write, graphics_ctx) => {
+/**
+ * Create a Linux machine and run it.
+ *
+ * options.task_pool configures the pool of pre-warmed task Workers (see make_task): { size, low, high }. size Workers
+ * are started once CPU 0 is up, and whenever fewer than low are left, the pool is refilled up to high. A size and high
+ * of 0 disable the pool, so that each task starts a Worker of its own.
+ *
+ * options.module_cache makes the Workers compile user executables through the persistent module cache (see
+ * linux-module-cache.js), so that they are compiled once, not once per page load.
+ */
+const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_write, graphics_ctx, options) => {
   /// Dict of online CPUs.
   const cpus = {};
 
   /// Dict of tasks.
   const tasks = {};
 
-  /// Input buffer (from keyboard to tty).
+  /// Pre-warmed task Workers, parked until make_task() hands them a task, oldest first.
+  const task_pool = [];
+  const task_pool_options = { size: 4, low: 2, high: 4, ...(options && options.task_pool) };
+
+  /// Whether Workers compile user executables through the persistent module cache.
+  const module_cache = !!(options && options.module_cache);
+
+  /**
+   * Compiled user executables, by SHA-256 hash of the binary (see executable_compile in linux-worker.js), least
+   * recently used first. An entry is { module, compiler, waiters }: module is null while compiler, the Worker of the
+   * first task to look it up, compiles it, and waiters are the Workers that looked it up meanwhile.
+   */
+  const executable_cache = new Map();
+
+  /// Number of compiled executables kept in executable_cache.
+  const EXECUTABLE_CACHE_ENTRIES = 32;
+
+  /// Forget a Worker that is gone in executable_cache. Compiles it had not finished are handed to a Worker waiting for
+  /// them (which is told to compile it), so that they do not wait forever.
+  const executable_cache_release = (worker) => {
+    for (const [key, entry] of executable_cache) {
+      if (entry.module) continue;
+      entry.waiters = entry.waiters.filter((waiter) => waiter != worker);
+      if (entry.compiler != worker) continue;
+
+      entry.compiler = entry.waiters.shift() || null;
+      if (entry.compiler) {
+        entry.compiler.postMessage({ method: "executable_module", key: key, module: null });
+      } else {
+        executable_cache.delete(key);
+      }
+    }
+  };
+
+  /**
+   * The task table, shared with all Workers, so that they can wake up the task they switch to themselves (see
+   * wasm_serialize_tasks in linux-worker.js) without a round trip through this thread. Each runner gets a slot of
+   * TASK_TABLE_STRIDE words: its task (0 until known), its serialize lock and its last_task. Word 0 is the number of
+   * slots handed out so far, which Workers look through. Slots of released tasks are handed out again.
+   *
+   * Only this thread writes the tasks. A runner that does not get a slot (the table is full) gets locks of its own, and
+   * switches to it go through serialize_tasks as before.
+   */
+  const TASK_TABLE_SLOTS = 1024;
+  const TASK_TABLE_STRIDE = 4;
+  const TASK_TABLE_TASK = 0;
+  const TASK_TABLE_SERIALIZE = 1;
+  const TASK_TABLE_LAST_TASK = 2;
+  const task_table = new Int32Array(new SharedArrayBuffer((1 + TASK_TABLE_SLOTS * TASK_TABLE_STRIDE) * 4));
+
+  /// Slots of the task table (word offsets) that have been released and can be handed out again.
+  const task_table_free = [];
+
+  /// Get a slot in the task table for a runner, or -1 if it is full.
+  const task_table_alloc = () => {
+    const slot = task_table_free.pop();
+    if (slot !== undefined) {
+      return slot;
+    }
+    const used = task_table[0];
+    if (used == TASK_TABLE_SLOTS) {
+      return -1;
+    }
+    Atomics.store(task_table, 0, used + 1);
+    return 1 + used * TASK_TABLE_STRIDE;
+  };
+
+  /// Enter the task of a runner into its slot, from where Workers can find it.
+  const task_table_register = (runner, task) => {
+    if (runner.task_table_slot >= 0) {
+      Atomics.store(task_table, runner.task_table_slot + TASK_TABLE_TASK, task);
+    }
+  };
+
+  /// Input buffer (from keyboard to tty), holding what has not been written into the console input ring yet.
   let input_buffer = new ArrayBuffer(0);
 
+  /**
+   * The console input ring in kernel memory (hvc_wasm_input in hvc_wasm.c), or 0 if the kernel has none, in which case
+   * it asks for input with console_read. It is a single producer (us) single consumer (the kernel) ring: head, tail,
+   * the address of the word to raise the console IRQ in (0 until the kernel takes it) and the IRQ, then the data.
+   * head and tail count bytes, and the kernel consumes at tail what we append at head.
+   */
+  let console_input = 0;
+  const CONSOLE_INPUT_HEAD = 0;
+  const CONSOLE_INPUT_TAIL = 1;
+  const CONSOLE_INPUT_RAISED_IRQS = 2;
+  const CONSOLE_INPUT_IRQ = 3;
+  const CONSOLE_INPUT_DATA = 16;
+  const CONSOLE_INPUT_SIZE = 4096;
+
+  /// Set while waiting for the kernel to make room in the console input ring.
+  let console_input_retry = null;
+
+  /// Move input_buffer into the console input ring (as much as fits) and raise the console IRQ, the way
+  /// raise_interrupt() does it in the kernel, for the kernel to read it without calling out to us.
+  const console_input_flush = () => {
+    console_input_retry = null;
+    const words = new Uint32Array(memory.buffer, console_input, CONSOLE_INPUT_DATA / 4);
+    const data = new Uint8Array(memory.buffer, console_input + CONSOLE_INPUT_DATA, CONSOLE_INPUT_SIZE);
+    const buffer = new Uint8Array(input_buffer);
+
+    const head = Atomics.load(words, CONSOLE_INPUT_HEAD);
+    const count = Math.min(buffer.length, CONSOLE_INPUT_SIZE - ((head - Atomics.load(words, CONSOLE_INPUT_TAIL)) >>> 0));
+    for (let i = 0; i < count; ++i) {
+      data[(head + i) % CONSOLE_INPUT_SIZE] = buffer[i];
+    }
+    Atomics.store(words, CONSOLE_INPUT_HEAD, (head + count) >>> 0);  // Releases the data written above.
+    input_buffer = buffer.slice(count).buffer;
+
+    const raised_irqs = Atomics.load(words, CONSOLE_INPUT_RAISED_IRQS);
+    if (count && raised_irqs) {
+      const irqs = new Int32Array(memory.buffer, raised_irqs, 1);
+      Atomics.or(irqs, 0, 1 << Atomics.load(words, CONSOLE_INPUT_IRQ));
+      Atomics.notify(irqs, 0, 1);
+    }
+    if (input_buffer.byteLength) {
+      console_input_retry = setTimeout(console_input_flush, 10);  // The ring is full.
+    }
+  };
+
   const text_decoder = new TextDecoder("utf-8");
   const text_encoder = new TextEncoder();
 
-  /// Graphics context (for WebGL/EGL support)
+  /// Graphics registry (for WebGL/EGL support), see index.html. The WebGL context itself lives in the graphics host.
   const graphics = graphics_ctx || null;
 
   const lock_notify = (locks, lock, count) => {
@@ -34,6 +161,15 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
       // in this special case tell us where it is so that we can register it.
       log("Starting cpu 0 with init_task " + message.init_task)
       tasks[message.init_task] = cpus[0];
+      task_table_register(cpus[0], message.init_task);
+
+      console_input = message.console_input;
+      if (console_input && input_buffer.byteLength) {
+        console_input_flush();  // Typed during boot.
+      }
+
+      // vmlinux has been instantiated (and memory initialized) once, so pooled Workers can instantiate it too.
+      task_pool_fill(task_pool_options.size);
     },
 
     start_secondary: (message) => {
@@ -73,13 +209,63 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
     release_task: (message) => {
       // Stop the worker, which will stop script execution. This is safe as the task should be hanging on a lock waiting
       // to be scheduled - which never happens as dead tasks don't get ever get scheduled.
-      tasks[message.dead_task].worker.terminate();
+      //
+      // The Worker does not go back to the pool: it is stuck deep in the kernel stack of the dead task, and all of its
+      // state (user executable, GL ring, shadowed GL state) belongs to that task. make_task() refills the pool instead.
+      const runner = tasks[message.dead_task];
+      runner.worker.terminate();
+      graphics_host.disconnect(runner.graphics_connection);
+      if (runner.task_table_slot >= 0) {
+        Atomics.store(task_table, runner.task_table_slot + TASK_TABLE_TASK, 0);
+        Atomics.store(task_table, runner.task_table_slot + TASK_TABLE_SERIALIZE, 0);
+        task_table_free.push(runner.task_table_slot);
+      }
 
+      executable_cache_release(runner.worker);
       delete tasks[message.dead_task];
     },
 
+    executable_lookup: (message, worker) => {
+      const entry = executable_cache.get(message.key);
+      if (!entry) {
+        // Not compiled yet, the Worker asking compiles it (and stores it with executable_store).
+        executable_cache.set(message.key, { module: null, compiler: worker, waiters: [] });
+        worker.postMessage({ method: "executable_module", key: message.key, module: null });
+      } else if (!entry.module) {
+        entry.waiters.push(worker);
+      } else {
+        executable_cache.delete(message.key);  // Most recently used now.
+        executable_cache.set(message.key, entry);
+        worker.postMessage({ method: "executable_module", key: message.key, module: entry.module });
+      }
+    },
+
+    executable_store: (message) => {
+      const entry = executable_cache.get(message.key);
+      if (!entry || entry.module) return;
+
+      for (const worker of entry.waiters) {
+        worker.postMessage({ method: "executable_module", key: message.key, module: message.module });
+      }
+      entry.waiters = [];
+      entry.compiler = null;
+      if (!message.module) {
+        executable_cache.delete(message.key);  // Failed to compile.
+        return;
+      }
+
+      entry.module = message.module;
+      for (const [key, other] of executable_cache) {
+        if (executable_cache.size <= EXECUTABLE_CACHE_ENTRIES) break;
+        if (other.module) {
+          executable_cache.delete(key);
+        }
+      }
+    },
+
     serialize_tasks: (message) => {
-      // next_task was previously suspended, wake it up.
+      // next_task was previously suspended, wake it up. Only used for tasks without a slot in the task table, the
+      // Workers wake up the others themselves.
 
       // Tell the next task where we switched from, so that it can finish the task switch.
       tasks[message.next_task].last_task[0] = message.prev_task;
@@ -88,6 +274,7 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
       lock_notify(tasks[message.next_task].locks, "serialize");
     },
 
+    /// Only used by kernels without the console input ring.
     console_read: (message, worker) => {
       const memory_u8 = new Uint8Array(memory.buffer);
       const buffer = new Uint8Array(input_buffer);
@@ -111,289 +298,18 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
       log(message.message);
     },
 
-    // Graphics callbacks (EGL/OpenGL ES operations)
-    graphics_init: (message) => {
-      if (graphics && graphics.canvas) {
-        graphics.canvas.parentElement.style.display = 'block';
-        log("[Graphics]: Initialized");
-      }
-    },
-
-    graphics_swap_buffers: (message) => {
-      // WebGL automatically swaps buffers, but we can trigger a flush here if needed
-      if (graphics && graphics.gl) {
-        graphics.gl.flush();
-      }
-    },
-
-    graphics_gl_call: (message) => {
-      // Generic OpenGL call forwarding from workers
-      if (!graphics || !graphics.gl) return;
-      
-      try {
-        const gl = graphics.gl;
-        
-        // Map ID to actual WebGL object if needed
-        let args = message.args || [];
-        if (message.is_shader_id && args.length > 0) {
-          args[0] = graphics.shaders.get(args[0]);
-        }
-        if (message.is_program_id && args.length > 0) {
-          args[0] = graphics.programs.get(args[0]);
-        }
-        if (message.is_buffer_id && args.length > 0) {
-          args[1] = graphics.buffers.get(args[1]);
-        }
-        if (message.is_uniform_location && args.length > 0) {
-          args[0] = graphics.uniformLocations.get(args[0]);
-        }
-        if (message.is_texture && args.length > 1) {
-          args[1] = graphics.textures.get(args[1]);
-        }
-        
-        const func = gl[message.func_name];
-        if (typeof func === 'function') {
-          let result = func.apply(gl, args);
-          
-          // Handle object creation - assign IDs
-          if (message.func_name === 'createShader' && result) {
-            const id = graphics.nextShaderId++;
-            graphics.shaders.set(id, result);
-            result = id;
-          } else if (message.func_name === 'createProgram' && result) {
-            const id = graphics.nextProgramId++;
-            graphics.programs.set(id, result);
-            result = id;
-          }
-          
-          // Return result via SharedArrayBuffer if requested
-          if (message.result_buffer) {
-            Atomics.store(message.result_buffer, 0, result || 0);
-            Atomics.notify(message.result_buffer, 0, 1);
-          }
-        }
-      } catch (error) {
-        log("[Graphics]: Error in " + message.func_name + ": " + error.message);
-        if (message.result_buffer) {
-          Atomics.store(message.result_buffer, 0, 0);
-          Atomics.notify(message.result_buffer, 0, 1);
-        }
-      }
-    },
-
-    graphics_gl_shader_source: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const shader = graphics.shaders.get(message.shader);
-      if (shader) {
-        graphics.gl.shaderSource(shader, message.source);
-      }
-    },
-
-    graphics_gl_attach_shader: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const program = graphics.programs.get(message.program);
-      const shader = graphics.shaders.get(message.shader);
-      if (program && shader) {
-        graphics.gl.attachShader(program, shader);
-      }
-    },
-
-    graphics_gl_get_shaderiv: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const shader = graphics.shaders.get(message.shader);
-      if (shader) {
-        const result = graphics.gl.getShaderParameter(shader, message.pname);
-        Atomics.store(message.result_buffer, 0, result ? 1 : 0);
-        Atomics.notify(message.result_buffer, 0, 1);
-      }
+    graphics_show: (message) => {
+      graphics_show();
     },
 
-    graphics_gl_get_shader_info_log: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const shader = graphics.shaders.get(message.shader);
-      if (shader) {
-        const log = graphics.gl.getShaderInfoLog(shader) || "";
-        const encoder = new TextEncoder();
-        const encoded = encoder.encode(log);
-        const length = Math.min(encoded.length, message.max_length - 1);
-        
-        for (let i = 0; i < length; i++) {
-          message.result_str[i] = encoded[i];
-        }
-        message.result_str[length] = 0; // Null terminator
-        
-        Atomics.store(message.result_len, 0, length);
-        Atomics.notify(message.result_len, 0, 1);
-      }
-    },
-
-    graphics_gl_get_programiv: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const program = graphics.programs.get(message.program);
-      if (program) {
-        const result = graphics.gl.getProgramParameter(program, message.pname);
-        Atomics.store(message.result_buffer, 0, result ? 1 : 0);
-        Atomics.notify(message.result_buffer, 0, 1);
-      }
-    },
-
-    graphics_gl_get_program_info_log: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const program = graphics.programs.get(message.program);
-      if (program) {
-        const log = graphics.gl.getProgramInfoLog(program) || "";
-        const encoder = new TextEncoder();
-        const encoded = encoder.encode(log);
-        const length = Math.min(encoded.length, message.max_length - 1);
-        
-        for (let i = 0; i < length; i++) {
-          message.result_str[i] = encoded[i];
-        }
-        message.result_str[length] = 0; // Null terminator
-        
-        Atomics.store(message.result_len, 0, length);
-        Atomics.notify(message.result_len, 0, 1);
-      }
-    },
-
-    graphics_gl_get_attrib_location: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const program = graphics.programs.get(message.program);
-      if (program) {
-        const location = graphics.gl.getAttribLocation(program, message.name);
-        Atomics.store(message.result_buffer, 0, location);
-        Atomics.notify(message.result_buffer, 0, 1);
-      }
-    },
-
-    graphics_gl_get_uniform_location: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const program = graphics.programs.get(message.program);
-      if (program) {
-        const location = graphics.gl.getUniformLocation(program, message.name);
-        if (location) {
-          const id = graphics.nextUniformLocationId++;
-          graphics.uniformLocations.set(id, location);
-          Atomics.store(message.result_buffer, 0, id);
-        } else {
-          Atomics.store(message.result_buffer, 0, -1);
-        }
-        Atomics.notify(message.result_buffer, 0, 1);
-      }
-    },
-
-    graphics_gl_gen_buffers: (message) => {
-      if (!graphics || !graphics.gl) return;
-      for (let i = 0; i < message.n; i++) {
-        const buffer = graphics.gl.createBuffer();
-        const id = graphics.nextBufferId++;
-        graphics.buffers.set(id, buffer);
-        message.result_buffer[i] = id;
-      }
-      Atomics.notify(new Int32Array(message.result_buffer.buffer), 0, 1);
-    },
-
-    graphics_gl_buffer_data: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const gl = graphics.gl;
-      
-      if (message.data) {
-        gl.bufferData(message.target, message.data, message.usage);
-      } else {
-        gl.bufferData(message.target, message.size, message.usage);
-      }
-    },
-
-    graphics_gl_uniform_matrix4fv: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const location = graphics.uniformLocations.get(message.location);
-      if (location) {
-        graphics.gl.uniformMatrix4fv(location, message.transpose, message.value);
-      }
-    },
-
-    graphics_gl_uniform_fv: (message) => {
-      if (!graphics || !graphics.gl) return;
-      const location = graphics.uniformLocations.get(message.location);
-      if (location) {
-        // Call the appropriate uniformNfv function based on size
-        if (message.size === 2) {
-          graphics.gl.uniform2fv(location, message.value);
-        } else if (message.size === 3) {
-          graphics.gl.uniform3fv(location, message.value);
-        } else if (message.size === 4) {
-          graphics.gl.uniform4fv(location, message.value);
-        }
-      }
-    },
-
-    graphics_gl_gen_textures: (message) => {
-      if (!graphics || !graphics.gl) return;
-      
-      const texture_ids = [];
-      for (let i = 0; i < message.n; i++) {
-        const texture = graphics.gl.createTexture();
-        const id = graphics.nextTextureId++;
-        graphics.textures.set(id, texture);
-        texture_ids.push(id);
-      }
-      
-      // Write texture IDs to shared result buffer
-      const result_buffer = message.worker._result_buffer;
-      if (result_buffer) {
-        const result_i32 = new Int32Array(result_buffer);
-        for (let i = 0; i < texture_ids.length; i++) {
-          result_i32[1 + i] = texture_ids[i];
-        }
-        // Signal completion
-        result_i32[0] = 1;
-        Atomics.notify(result_i32, 0);
-      }
-    },
-
-    graphics_gl_delete_textures: (message) => {
-      if (!graphics || !graphics.gl) return;
-      
-      for (const texture_id of message.texture_ids) {
-        const texture = graphics.textures.get(texture_id);
-        if (texture) {
-          graphics.gl.deleteTexture(texture);
-          graphics.textures.delete(texture_id);
-        }
-      }
-    },
-
-    graphics_gl_tex_image_2d: (message) => {
-      if (!graphics || !graphics.gl) return;
-      
-      if (message.data === null) {
-        // Allocate empty texture
-        graphics.gl.texImage2D(
-          message.target,
-          message.level,
-          message.internalformat,
-          message.width,
-          message.height,
-          message.border,
-          message.format,
-          message.type,
-          null
-        );
-      } else {
-        // Upload texture data
-        const data = new Uint8Array(message.data);
-        graphics.gl.texImage2D(
-          message.target,
-          message.level,
-          message.internalformat,
-          message.width,
-          message.height,
-          message.border,
-          message.format,
-          message.type,
-          data
-        );
-      }
+    graphics_capture_save: (message) => {
+      // A task ended a GL capture (wasm_gl_capture_end). Offer the trace for download, to play with gl-replay.html.
+      const link = document.createElement("a");
+      link.href = URL.createObjectURL(new Blob([message.trace], { type: "application/octet-stream" }));
+      link.download = message.name;
+      link.click();
+      setTimeout(() => URL.revokeObjectURL(link.href), 0);
+      log("[Graphics]: Saved GL trace " + message.name + " (" + message.trace.byteLength + " bytes)");
     },
   };
 
@@ -404,6 +320,54 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
     shared: true,
   });
 
+  /// Make the canvas visible, done when a task first initializes graphics.
+  const graphics_show = () => {
+    graphics.canvas.parentElement.style.display = 'block';
+  };
+
+  /**
+   * The graphics host that executes the GL requests of all tasks (see linux-graphics.js), each task Worker talking to
+   * it over its own MessageChannel.
+   *
+   * It runs in a render worker that owns the canvas as an OffscreenCanvas, so that a heavy frame does not delay the
+   * console I/O, task creation and task switches that this thread services for the whole machine. Browsers without
+   * OffscreenCanvas get it on this thread. Without graphics, it still answers queries and fences (with nothing drawn).
+   */
+  const graphics_host = (() => {
+    if (!graphics || !graphics.canvas.transferControlToOffscreen || !graphics.render_worker_url) {
+      return linux_graphics(graphics, memory, log, graphics_show);
+    }
+
+    const render_worker = new Worker(graphics.render_worker_url, { name: "Graphics" });
+    render_worker.onerror = (error) => {
+      throw error;
+    };
+    render_worker.onmessage = (message_event) => {
+      const data = message_event.data;
+      message_callbacks[data.method](data, render_worker);
+    };
+
+    const canvas = graphics.canvas.transferControlToOffscreen();
+    render_worker.postMessage({
+      method: "init",
+      graphics: { ...graphics, canvas: canvas },
+      memory: memory,
+    }, [canvas]);
+
+    return {
+      connect: (id, port) => {
+        render_worker.postMessage({ method: "connect", id: id, port: port }, [port]);
+      },
+
+      disconnect: (id) => {
+        render_worker.postMessage({ method: "disconnect", id: id });
+      },
+    };
+  })();
+
+  /// Last graphics connection ID handed out (one per runner).
+  let graphics_connection_id = 0;
+
   /**
    * Create and run one CPU in a background thread (a Web Worker).
    *
@@ -430,6 +394,7 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
     cpus[cpu] = runner;
     if (cpu != 0) {
       tasks[idle_task] = runner; // For CPU 0, start_primary does this registration for us.
+      task_table_register(runner, idle_task);
     }
   };
 
@@ -439,15 +404,78 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
    * In the beginning, all tasks are serialized and have to cooperate to schedule eachother, but after secondary CPUs
    * are brought up, they can run concurrently (and will effectively be managed by the Wasm host OS). While we are not
    * able to suspend them from JS, the host OS will do that.
+   *
+   * Starting a Worker and instantiating vmlinux in it takes long compared to a fork, so the task is normally handed to
+   * a Worker from the pool that has done both already, parked on an Atomics word in its task descriptor. Only when the
+   * pool has run dry does the task get a Worker of its own.
    */
   const make_task = (prev_task, new_task, name, user_executable) => {
-    const options = {
-      runner_type: "task",
-      prev_task: prev_task,
-      new_task: new_task,
-      user_executable: user_executable,
-    };
-    tasks[new_task] = make_vmlinux_runner(name + " (" + new_task + ")", options);
+    const runner = task_pool.shift();
+    if (!runner) {
+      const options = {
+        runner_type: "task",
+        prev_task: prev_task,
+        new_task: new_task,
+        user_executable: user_executable,
+      };
+      tasks[new_task] = make_vmlinux_runner(name + " (" + new_task + ")", options);
+      task_table_register(tasks[new_task], new_task);
+    } else {
+      // Hand the task to a Worker from the pool, which has loaded its script and instantiated vmlinux already.
+      const descriptor = runner.task_descriptor;
+      const words = descriptor._memory;
+      words[descriptor.prev_task] = prev_task;
+      words[descriptor.new_task] = new_task;
+      words[descriptor.bin_start] = user_executable ? user_executable.bin_start : 0;
+      words[descriptor.bin_end] = user_executable ? user_executable.bin_end : 0;
+      words[descriptor.data_start] = user_executable ? user_executable.data_start : 0;
+      words[descriptor.table_start] = user_executable ? user_executable.table_start : 0;
+      words[descriptor.name_length] = text_encoder.encodeInto(name + " (" + new_task + ")",
+        new Uint8Array(words.buffer, descriptor.name * 4, TASK_DESCRIPTOR_NAME_BYTES)).written;
+
+      // Release the above writes and wake up the Worker.
+      tasks[new_task] = runner;
+      task_table_register(runner, new_task);
+      Atomics.store(words, descriptor.claimed, 1);
+      Atomics.notify(words, descriptor.claimed, 1);
+    }
+
+    if (task_pool.length < task_pool_options.low) {
+      // Not on the way of the task we just started (or of the one that forked it).
+      setTimeout(() => task_pool_fill(task_pool_options.high), 0);
+    }
+  };
+
+  /// Size of the task name in a task descriptor (longer ones are cut short, it is only used in logs).
+  const TASK_DESCRIPTOR_NAME_BYTES = 64;
+
+  /// Number of task Workers started for the pool so far, to name them.
+  let task_pool_started = 0;
+
+  /// Start task Workers for the pool until it holds count of them. They park as soon as vmlinux is instantiated.
+  const task_pool_fill = (count) => {
+    while (task_pool.length < count) {
+      // Word offsets in the task descriptor that make_task() writes. The task name (UTF-8) starts at word name.
+      const descriptor = {
+        claimed: 0,
+        prev_task: 1,
+        new_task: 2,
+        bin_start: 3,
+        bin_end: 4,
+        data_start: 5,
+        table_start: 6,
+        name_length: 7,
+        name: 8,
+      };
+      descriptor._memory = new Int32Array(new SharedArrayBuffer(descriptor.name * 4 + TASK_DESCRIPTOR_NAME_BYTES));
+
+      const runner = make_vmlinux_runner("Task (pooled " + ++task_pool_started + ")", {
+        runner_type: "task",
+        task_descriptor: descriptor,
+      });
+      runner.task_descriptor = descriptor;
+      task_pool.push(runner);
+    }
   };
 
   /// Create a runner for vmlinux. It will run in a Web Worker and execute some specified code.
@@ -455,14 +483,20 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
     // Note: SharedWorker does not seem to allow WebAssembly Module or Memory instances posted.
     const worker = new Worker(worker_url, { name: name });
 
+    // Our locks and last_task live in our slot of the task table, if we get one.
+    const task_table_slot = task_table_alloc();
+
     let locks = {
-      serialize: 0,
+      serialize: (task_table_slot >= 0) ? task_table_slot + TASK_TABLE_SERIALIZE : 0,
     };
-    locks._memory = new Int32Array(new SharedArrayBuffer(Object.keys(locks).length * 4));
+    locks._memory = (task_table_slot >= 0) ? task_table :
+      new Int32Array(new SharedArrayBuffer(Object.keys(locks).length * 4));
 
     // Store for last task when wasm_serialize() returns in switch_to(). Needed for each task, both normal ones and each
     // CPUs idle tasks (first called init_task (PID 0), not to be confused with init (PID 1) which is a normal task).
-    const last_task = new Uint32Array(new SharedArrayBuffer(4));
+    const last_task = (task_table_slot >= 0) ?
+      new Uint32Array(task_table.buffer, (task_table_slot + TASK_TABLE_LAST_TASK) * 4, 1) :
+      new Uint32Array(new SharedArrayBuffer(4));
 
     worker.onerror = (error) => {
       throw error;
@@ -477,6 +511,11 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
       throw error;
     };
 
+    // Graphics requests go straight to the graphics host rather than through us.
+    const graphics_channel = new MessageChannel();
+    const graphics_connection = ++graphics_connection_id;
+    graphics_host.connect(graphics_connection, graphics_channel.port1);
+
     worker.postMessage({
       ...options,
       method: "init",
@@ -484,13 +523,20 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
       memory: memory,
       locks: locks,
       last_task: last_task,
+      task_table: task_table,
+      gl_names: graphics ? graphics.names : null,
+      gl_vblank: graphics ? graphics.vblank : null,
+      graphics_port: graphics_channel.port2,
+      module_cache: module_cache,
       runner_name: name,
-    });
+    }, [graphics_channel.port2]);
 
     return {
       worker: worker,
       locks: locks,
       last_task: last_task,
+      task_table_slot: task_table_slot,
+      graphics_connection: graphics_connection,
     };
   };
 
@@ -501,10 +547,18 @@ const linux = async (worker_url, vmlinux, boot_cmdline, initrd, log, console_wri
     key_input: (data) => {
       const key_buffer = text_encoder.encode(data);  // Possibly UTF-8 (up to 16 bits).
 
-      // Append key_buffer to the end of input_buffer.
+      // Append key_buffer to the end of input_buffer (normally empty, as it is emptied into the console input ring).
       const old_size = input_buffer.byteLength;
-      input_buffer = input_buffer.transfer(old_size + key_buffer.byteLength);
-      (new Uint8Array(input_buffer)).set(key_buffer, old_size);
+      if (!old_size) {
+        input_buffer = key_buffer.buffer;
+      } else {
+        input_buffer = input_buffer.transfer(old_size + key_buffer.byteLength);
+        (new Uint8Array(input_buffer)).set(key_buffer, old_size);
+      }
+
+      if (console_input && !console_input_retry) {
+        console_input_flush();
+      }
     }
   };
 };
@@ -10,7 +10,10 @@
 #ifndef WASM_GRAPHICS_H
 #define WASM_GRAPHICS_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 // EGL types
 typedef int32_t EGLint;
@@ -43,6 +46,8 @@ typedef void* EGLNativeWindowType;
 #define EGL_RENDERABLE_TYPE 0x3040
 #define EGL_OPENGL_ES2_BIT 0x0004
 #define EGL_CONTEXT_CLIENT_VERSION 0x3098
+#define EGL_HEIGHT 0x3056
+#define EGL_WIDTH 0x3057
 
 // OpenGL ES types
 typedef unsigned int GLenum;
@@ -57,7 +62,12 @@ typedef unsigned char GLubyte;
 typedef unsigned short GLushort;
 typedef float GLfloat;
 typedef float GLclampf;
+typedef char GLchar;
 typedef void GLvoid;
+typedef long GLintptr;
+typedef long GLsizeiptr;
+typedef uint64_t GLuint64;
+typedef struct __GLsync *GLsync;
 
 // OpenGL ES constants
 #define GL_COLOR_BUFFER_BIT 0x00004000
@@ -82,6 +92,11 @@ typedef void GLvoid;
 #define GL_ATTACHED_SHADERS 0x8B85
 #define GL_ACTIVE_UNIFORMS 0x8B86
 #define GL_ACTIVE_ATTRIBUTES 0x8B89
+#define GL_COMPLETION_STATUS_KHR 0x91B1  // KHR_parallel_shader_compile, see wasm_gl_program_ready()
+
+// State queries (glGetIntegerv)
+#define GL_VIEWPORT 0x0BA2
+#define GL_MAX_TEXTURE_SIZE 0x0D33
 
 // Buffer types
 #define GL_ARRAY_BUFFER 0x8892
@@ -92,6 +107,15 @@ typedef void GLvoid;
 #define GL_DYNAMIC_DRAW 0x88E8
 #define GL_STREAM_DRAW 0x88E0
 
+// Sync objects
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+
 // Data types
 #define GL_BYTE 0x1400
 #define GL_UNSIGNED_BYTE 0x1401
@@ -100,6 +124,10 @@ typedef void GLvoid;
 #define GL_INT 0x1404
 #define GL_UNSIGNED_INT 0x1405
 #define GL_FLOAT 0x1406
+#define GL_HALF_FLOAT_OES 0x8D61
+#define GL_UNSIGNED_SHORT_4_4_4_4 0x8033
+#define GL_UNSIGNED_SHORT_5_5_5_1 0x8034
+#define GL_UNSIGNED_SHORT_5_6_5 0x8363
 
 #define GL_FALSE 0
 #define GL_TRUE 1
@@ -121,6 +149,10 @@ typedef void GLvoid;
 #define GL_LUMINANCE_ALPHA 0x190A
 #define GL_ALPHA 0x1906
 
+// Pixel storage
+#define GL_UNPACK_ALIGNMENT 0x0CF5
+#define GL_PACK_ALIGNMENT 0x0D05
+
 // Texture parameters
 #define GL_TEXTURE_MIN_FILTER 0x2801
 #define GL_TEXTURE_MAG_FILTER 0x2800
@@ -135,6 +167,19 @@ typedef void GLvoid;
 #define GL_NEAREST_MIPMAP_LINEAR 0x2702
 #define GL_LINEAR_MIPMAP_LINEAR 0x2703
 
+// Compressed texture formats (only those listed in GL_COMPRESSED_TEXTURE_FORMATS are supported by the browser)
+#define GL_NUM_COMPRESSED_TEXTURE_FORMATS 0x86A2
+#define GL_COMPRESSED_TEXTURE_FORMATS 0x86A3
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_ETC1_RGB8_OES 0x8D64
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#define GL_COMPRESSED_RGBA_ASTC_8x8_KHR 0x93B7
+
 // Texture wrap modes
 #define GL_REPEAT 0x2901
 #define GL_CLAMP_TO_EDGE 0x812F
@@ -155,6 +200,27 @@ typedef void GLvoid;
 #define GL_CULL_FACE 0x0B44
 #define GL_BLEND 0x0BE2
 
+// Framebuffer and renderbuffer objects
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_RENDERBUFFER 0x8D41
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#define GL_RENDERBUFFER_BINDING 0x8CA7
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#define GL_STENCIL_ATTACHMENT 0x8D20
+#define GL_DEPTH_STENCIL_ATTACHMENT 0x821A
+#define GL_RGBA4 0x8056
+#define GL_RGB5_A1 0x8057
+#define GL_RGB565 0x8D62
+#define GL_DEPTH_COMPONENT16 0x81A5
+#define GL_STENCIL_INDEX8 0x8D48
+#define GL_DEPTH24_STENCIL8 0x88F0  // Also on WebGL1, where the host asks for GL_DEPTH_STENCIL instead
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT 0x8CD6
+#define GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT 0x8CD7
+#define GL_FRAMEBUFFER_INCOMPLETE_DIMENSIONS 0x8CD9
+#define GL_FRAMEBUFFER_UNSUPPORTED 0x8CDD
+
 // Host callback declarations (implemented in JavaScript runtime)
 __attribute__((import_module("env"), import_name("wasm_graphics_init")))
 int wasm_graphics_init(void);
@@ -175,15 +241,32 @@ EGLBoolean wasm_egl_choose_config(EGLDisplay dpy, const EGLint *attrib_list, EGL
 __attribute__((import_module("env"), import_name("wasm_egl_create_window_surface")))
 EGLSurface wasm_egl_create_window_surface(EGLDisplay dpy, EGLConfig config, EGLNativeWindowType win, const EGLint *attrib_list);
 
+// Offscreen surface of EGL_WIDTH by EGL_HEIGHT pixels
+__attribute__((import_module("env"), import_name("wasm_egl_create_pbuffer_surface")))
+EGLSurface wasm_egl_create_pbuffer_surface(EGLDisplay dpy, EGLConfig config, const EGLint *attrib_list);
+
+__attribute__((import_module("env"), import_name("wasm_egl_destroy_surface")))
+EGLBoolean wasm_egl_destroy_surface(EGLDisplay dpy, EGLSurface surface);
+
+// Each context has its own WebGL context and objects, so share_context must be EGL_NO_CONTEXT
 __attribute__((import_module("env"), import_name("wasm_egl_create_context")))
 EGLContext wasm_egl_create_context(EGLDisplay dpy, EGLConfig config, EGLContext share_context, const EGLint *attrib_list);
 
+__attribute__((import_module("env"), import_name("wasm_egl_destroy_context")))
+EGLBoolean wasm_egl_destroy_context(EGLDisplay dpy, EGLContext ctx);
+
+// A context renders to the surface it is first made current with, and can not be made current with another one
 __attribute__((import_module("env"), import_name("wasm_egl_make_current")))
 EGLBoolean wasm_egl_make_current(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx);
 
+// Presents the frame and blocks until the display refresh it is shown at (see eglSwapInterval)
 __attribute__((import_module("env"), import_name("wasm_egl_swap_buffers")))
 EGLBoolean wasm_egl_swap_buffers(EGLDisplay dpy, EGLSurface surface);
 
+// Display refreshes per eglSwapBuffers (default 1), 0 for unthrottled swaps
+__attribute__((import_module("env"), import_name("wasm_egl_swap_interval")))
+EGLBoolean wasm_egl_swap_interval(EGLDisplay dpy, EGLint interval);
+
 // OpenGL ES basic functions
 __attribute__((import_module("env"), import_name("wasm_gl_clear")))
 void wasm_gl_clear(GLbitfield mask);
@@ -194,6 +277,13 @@ void wasm_gl_clear_color(GLclampf red, GLclampf green, GLclampf blue, GLclampf a
 __attribute__((import_module("env"), import_name("wasm_gl_viewport")))
 void wasm_gl_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
 
+__attribute__((import_module("env"), import_name("wasm_gl_flush")))
+void wasm_gl_flush(void);
+
+// Block until the host has executed every command issued before it.
+__attribute__((import_module("env"), import_name("wasm_gl_finish")))
+void wasm_gl_finish(void);
+
 // Shader functions
 __attribute__((import_module("env"), import_name("wasm_gl_create_shader")))
 GLuint wasm_gl_create_shader(GLenum type);
@@ -201,6 +291,9 @@ GLuint wasm_gl_create_shader(GLenum type);
 __attribute__((import_module("env"), import_name("wasm_gl_shader_source")))
 void wasm_gl_shader_source(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
 
+__attribute__((import_module("env"), import_name("wasm_gl_delete_shader")))
+void wasm_gl_delete_shader(GLuint shader);
+
 __attribute__((import_module("env"), import_name("wasm_gl_compile_shader")))
 void wasm_gl_compile_shader(GLuint shader);
 
@@ -214,6 +307,9 @@ void wasm_gl_get_shader_info_log(GLuint shader, GLsizei max_length, GLsizei* len
 __attribute__((import_module("env"), import_name("wasm_gl_create_program")))
 GLuint wasm_gl_create_program(void);
 
+__attribute__((import_module("env"), import_name("wasm_gl_delete_program")))
+void wasm_gl_delete_program(GLuint program);
+
 __attribute__((import_module("env"), import_name("wasm_gl_attach_shader")))
 void wasm_gl_attach_shader(GLuint program, GLuint shader);
 
@@ -249,12 +345,37 @@ void wasm_gl_vertex_attrib_pointer(GLuint index, GLint size, GLenum type, GLbool
 __attribute__((import_module("env"), import_name("wasm_gl_gen_buffers")))
 void wasm_gl_gen_buffers(GLsizei n, GLuint* buffers);
 
+__attribute__((import_module("env"), import_name("wasm_gl_delete_buffers")))
+void wasm_gl_delete_buffers(GLsizei n, const GLuint* buffers);
+
 __attribute__((import_module("env"), import_name("wasm_gl_bind_buffer")))
 void wasm_gl_bind_buffer(GLenum target, GLuint buffer);
 
 __attribute__((import_module("env"), import_name("wasm_gl_buffer_data")))
 void wasm_gl_buffer_data(GLenum target, GLsizei size, const void* data, GLenum usage);
 
+__attribute__((import_module("env"), import_name("wasm_gl_buffer_sub_data")))
+void wasm_gl_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+
+// Zero-copy uploads: the host reads data directly from Wasm memory when it executes the command, which happens
+// asynchronously. The memory must not be modified or freed until a fence inserted after the call has been signaled.
+// (The plain glBufferData/glBufferSubData wait for that themselves, which costs a round trip to the host.)
+__attribute__((import_module("env"), import_name("wasm_gl_buffer_data_unsynchronized")))
+void wasm_gl_buffer_data_unsynchronized(GLenum target, GLsizei size, const void* data, GLenum usage);
+
+__attribute__((import_module("env"), import_name("wasm_gl_buffer_sub_data_unsynchronized")))
+void wasm_gl_buffer_sub_data_unsynchronized(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+
+// Sync functions (a fence is signaled once the host has executed all commands issued before it)
+__attribute__((import_module("env"), import_name("wasm_gl_fence_sync")))
+GLsync wasm_gl_fence_sync(GLenum condition, GLbitfield flags);
+
+__attribute__((import_module("env"), import_name("wasm_gl_client_wait_sync")))
+GLenum wasm_gl_client_wait_sync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+
+__attribute__((import_module("env"), import_name("wasm_gl_delete_sync")))
+void wasm_gl_delete_sync(GLsync sync);
+
 // Drawing functions
 __attribute__((import_module("env"), import_name("wasm_gl_draw_arrays")))
 void wasm_gl_draw_arrays(GLenum mode, GLint first, GLsizei count);
@@ -262,6 +383,81 @@ void wasm_gl_draw_arrays(GLenum mode, GLint first, GLsizei count);
 __attribute__((import_module("env"), import_name("wasm_gl_draw_elements")))
 void wasm_gl_draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices);
 
+// Instanced drawing (WebGL2, or ANGLE_instanced_arrays on WebGL1)
+__attribute__((import_module("env"), import_name("wasm_gl_draw_arrays_instanced")))
+void wasm_gl_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count);
+
+__attribute__((import_module("env"), import_name("wasm_gl_draw_elements_instanced")))
+void wasm_gl_draw_elements_instanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instance_count);
+
+__attribute__((import_module("env"), import_name("wasm_gl_vertex_attrib_divisor")))
+void wasm_gl_vertex_attrib_divisor(GLuint index, GLuint divisor);
+
+// State shadowing (not part of GL): redundant state changes (glUseProgram, glBindBuffer, glBindTexture,
+// glActiveTexture, glEnable/glDisable, glClearColor, glViewport, ...) with unchanged values are dropped before they
+// are sent to the host. On by default. The counts are of calls sent to the host and of calls dropped, since start.
+__attribute__((import_module("env"), import_name("wasm_gl_state_shadowing")))
+void wasm_gl_state_shadowing(GLboolean enabled);
+
+__attribute__((import_module("env"), import_name("wasm_gl_get_call_counts")))
+void wasm_gl_get_call_counts(GLuint* issued, GLuint* elided);
+
+// GL capture (not part of GL): records every GL call of this thread, with the data it uploads, until
+// wasm_gl_capture_end(), which offers the trace for download in the browser under the given file name. Play it back
+// with gl-replay.html. Begin before any GL objects are created. Returns GL_TRUE if a trace was saved.
+__attribute__((import_module("env"), import_name("wasm_gl_capture_begin")))
+void wasm_gl_capture_begin(void);
+
+__attribute__((import_module("env"), import_name("wasm_gl_capture_end")))
+GLboolean wasm_gl_capture_end(const char* name);
+
+// Vertex array objects (WebGL2, or OES_vertex_array_object on WebGL1)
+__attribute__((import_module("env"), import_name("wasm_gl_gen_vertex_arrays")))
+void wasm_gl_gen_vertex_arrays(GLsizei n, GLuint* arrays);
+
+__attribute__((import_module("env"), import_name("wasm_gl_bind_vertex_array")))
+void wasm_gl_bind_vertex_array(GLuint array);
+
+__attribute__((import_module("env"), import_name("wasm_gl_delete_vertex_arrays")))
+void wasm_gl_delete_vertex_arrays(GLsizei n, const GLuint* arrays);
+
+// State queries. glGetIntegerv waits for the host; it writes as many values as pname has (e.g. 4 for GL_VIEWPORT,
+// GL_NUM_COMPRESSED_TEXTURE_FORMATS for GL_COMPRESSED_TEXTURE_FORMATS).
+__attribute__((import_module("env"), import_name("wasm_gl_get_integerv")))
+void wasm_gl_get_integerv(GLenum pname, GLint* params);
+
+// Framebuffer and renderbuffer objects, to render to textures (and renderbuffers) rather than the canvas. Only
+// glCheckFramebufferStatus waits for the host.
+__attribute__((import_module("env"), import_name("wasm_gl_gen_framebuffers")))
+void wasm_gl_gen_framebuffers(GLsizei n, GLuint* framebuffers);
+
+__attribute__((import_module("env"), import_name("wasm_gl_bind_framebuffer")))
+void wasm_gl_bind_framebuffer(GLenum target, GLuint framebuffer);
+
+__attribute__((import_module("env"), import_name("wasm_gl_delete_framebuffers")))
+void wasm_gl_delete_framebuffers(GLsizei n, const GLuint* framebuffers);
+
+__attribute__((import_module("env"), import_name("wasm_gl_framebuffer_texture_2d")))
+void wasm_gl_framebuffer_texture_2d(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+
+__attribute__((import_module("env"), import_name("wasm_gl_framebuffer_renderbuffer")))
+void wasm_gl_framebuffer_renderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+
+__attribute__((import_module("env"), import_name("wasm_gl_check_framebuffer_status")))
+GLenum wasm_gl_check_framebuffer_status(GLenum target);
+
+__attribute__((import_module("env"), import_name("wasm_gl_gen_renderbuffers")))
+void wasm_gl_gen_renderbuffers(GLsizei n, GLuint* renderbuffers);
+
+__attribute__((import_module("env"), import_name("wasm_gl_bind_renderbuffer")))
+void wasm_gl_bind_renderbuffer(GLenum target, GLuint renderbuffer);
+
+__attribute__((import_module("env"), import_name("wasm_gl_delete_renderbuffers")))
+void wasm_gl_delete_renderbuffers(GLsizei n, const GLuint* renderbuffers);
+
+__attribute__((import_module("env"), import_name("wasm_gl_renderbuffer_storage")))
+void wasm_gl_renderbuffer_storage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+
 // Uniform functions
 __attribute__((import_module("env"), import_name("wasm_gl_uniform1f")))
 void wasm_gl_uniform1f(GLint location, GLfloat v0);
@@ -303,6 +499,47 @@ void wasm_gl_delete_textures(GLsizei n, const GLuint* textures);
 __attribute__((import_module("env"), import_name("wasm_gl_tex_image_2d")))
 void wasm_gl_tex_image_2d(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* data);
 
+__attribute__((import_module("env"), import_name("wasm_gl_tex_sub_image_2d")))
+void wasm_gl_tex_sub_image_2d(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* data);
+
+// Compressed textures, in the block formats listed by glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS) (the host enables the
+// S3TC, ETC and ASTC extensions that the browser has). Mipmap levels have to be uploaded one by one, glGenerateMipmap
+// only works for uncompressed textures.
+__attribute__((import_module("env"), import_name("wasm_gl_compressed_tex_image_2d")))
+void wasm_gl_compressed_tex_image_2d(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei image_size, const void* data);
+
+__attribute__((import_module("env"), import_name("wasm_gl_compressed_tex_sub_image_2d")))
+void wasm_gl_compressed_tex_sub_image_2d(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei image_size, const void* data);
+
+__attribute__((import_module("env"), import_name("wasm_gl_generate_mipmap")))
+void wasm_gl_generate_mipmap(GLenum target);
+
+// Zero-copy variants of the above that do not wait for the host to read data (see the buffer functions).
+__attribute__((import_module("env"), import_name("wasm_gl_tex_image_2d_unsynchronized")))
+GLboolean wasm_gl_tex_image_2d_unsynchronized(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* data);
+
+__attribute__((import_module("env"), import_name("wasm_gl_tex_sub_image_2d_unsynchronized")))
+GLboolean wasm_gl_tex_sub_image_2d_unsynchronized(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* data);
+
+__attribute__((import_module("env"), import_name("wasm_gl_pixel_storei")))
+void wasm_gl_pixel_storei(GLenum pname, GLint param);
+
+// Pixel readback. glReadPixels waits until the host has executed every command before it and written the pixels
+// (honoring GL_PACK_ALIGNMENT) straight into data.
+__attribute__((import_module("env"), import_name("wasm_gl_read_pixels")))
+void wasm_gl_read_pixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* data);
+
+// Asynchronous readback (not part of GL): returns right away after setting *done (which must be 4-byte aligned) to 0,
+// and the host sets it to 1 once the pixels have been written to data, which must stay valid until then. On WebGL2 the
+// pixels are copied into a pixel buffer object and fetched after a fence, so neither side waits for the GPU; elsewhere
+// they are read when the host gets to the call. Returns GL_FALSE (without touching *done) for an unsupported format.
+// Poll *done with wasm_gl_read_pixels_ready(), or block on it like glClientWaitSync with wasm_gl_read_pixels_wait().
+__attribute__((import_module("env"), import_name("wasm_gl_read_pixels_async")))
+GLboolean wasm_gl_read_pixels_async(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* data, GLint* done);
+
+__attribute__((import_module("env"), import_name("wasm_gl_read_pixels_wait")))
+GLenum wasm_gl_read_pixels_wait(const GLint* done, GLuint64 timeout);
+
 __attribute__((import_module("env"), import_name("wasm_gl_tex_parameteri")))
 void wasm_gl_tex_parameteri(GLenum target, GLenum pname, GLint param);
 
@@ -324,24 +561,32 @@ void wasm_gl_disable(GLenum cap);
 #define eglInitialize(d, ma, mi) wasm_egl_initialize(d, ma, mi)
 #define eglChooseConfig(d, a, c, s, n) wasm_egl_choose_config(d, a, c, s, n)
 #define eglCreateWindowSurface(d, c, w, a) wasm_egl_create_window_surface(d, c, w, a)
+#define eglCreatePbufferSurface(d, c, a) wasm_egl_create_pbuffer_surface(d, c, a)
+#define eglDestroySurface(d, s) wasm_egl_destroy_surface(d, s)
 #define eglCreateContext(d, c, s, a) wasm_egl_create_context(d, c, s, a)
+#define eglDestroyContext(d, c) wasm_egl_destroy_context(d, c)
 #define eglMakeCurrent(d, dr, r, c) wasm_egl_make_current(d, dr, r, c)
 #define eglSwapBuffers(d, s) wasm_egl_swap_buffers(d, s)
+#define eglSwapInterval(d, i) wasm_egl_swap_interval(d, i)
 
 // Convenience macros for OpenGL ES functions
 #define glClear(m) wasm_gl_clear(m)
 #define glClearColor(r, g, b, a) wasm_gl_clear_color(r, g, b, a)
 #define glViewport(x, y, w, h) wasm_gl_viewport(x, y, w, h)
+#define glFlush() wasm_gl_flush()
+#define glFinish() wasm_gl_finish()
 
 // Shader macros
 #define glCreateShader(t) wasm_gl_create_shader(t)
 #define glShaderSource(s, c, str, len) wasm_gl_shader_source(s, c, str, len)
+#define glDeleteShader(s) wasm_gl_delete_shader(s)
 #define glCompileShader(s) wasm_gl_compile_shader(s)
 #define glGetShaderiv(s, p, params) wasm_gl_get_shaderiv(s, p, params)
 #define glGetShaderInfoLog(s, ml, l, log) wasm_gl_get_shader_info_log(s, ml, l, log)
 
 // Program macros
 #define glCreateProgram() wasm_gl_create_program()
+#define glDeleteProgram(p) wasm_gl_delete_program(p)
 #define glAttachShader(p, s) wasm_gl_attach_shader(p, s)
 #define glLinkProgram(p) wasm_gl_link_program(p)
 #define glUseProgram(p) wasm_gl_use_program(p)
@@ -357,12 +602,39 @@ void wasm_gl_disable(GLenum cap);
 
 // Buffer macros
 #define glGenBuffers(n, b) wasm_gl_gen_buffers(n, b)
+#define glDeleteBuffers(n, b) wasm_gl_delete_buffers(n, b)
 #define glBindBuffer(t, b) wasm_gl_bind_buffer(t, b)
 #define glBufferData(t, s, d, u) wasm_gl_buffer_data(t, s, d, u)
+#define glBufferSubData(t, o, s, d) wasm_gl_buffer_sub_data(t, o, s, d)
+
+// Sync macros
+#define glFenceSync(c, f) wasm_gl_fence_sync(c, f)
+#define glClientWaitSync(s, f, t) wasm_gl_client_wait_sync(s, f, t)
+#define glDeleteSync(s) wasm_gl_delete_sync(s)
 
 // Drawing macros
 #define glDrawArrays(m, f, c) wasm_gl_draw_arrays(m, f, c)
 #define glDrawElements(m, c, t, i) wasm_gl_draw_elements(m, c, t, i)
+#define glDrawArraysInstanced(m, f, c, n) wasm_gl_draw_arrays_instanced(m, f, c, n)
+#define glDrawElementsInstanced(m, c, t, i, n) wasm_gl_draw_elements_instanced(m, c, t, i, n)
+#define glVertexAttribDivisor(i, d) wasm_gl_vertex_attrib_divisor(i, d)
+
+// Vertex array object macros
+#define glGenVertexArrays(n, a) wasm_gl_gen_vertex_arrays(n, a)
+#define glBindVertexArray(a) wasm_gl_bind_vertex_array(a)
+#define glDeleteVertexArrays(n, a) wasm_gl_delete_vertex_arrays(n, a)
+
+// Framebuffer and renderbuffer object macros
+#define glGenFramebuffers(n, f) wasm_gl_gen_framebuffers(n, f)
+#define glBindFramebuffer(t, f) wasm_gl_bind_framebuffer(t, f)
+#define glDeleteFramebuffers(n, f) wasm_gl_delete_framebuffers(n, f)
+#define glFramebufferTexture2D(t, a, tt, tx, l) wasm_gl_framebuffer_texture_2d(t, a, tt, tx, l)
+#define glFramebufferRenderbuffer(t, a, rt, r) wasm_gl_framebuffer_renderbuffer(t, a, rt, r)
+#define glCheckFramebufferStatus(t) wasm_gl_check_framebuffer_status(t)
+#define glGenRenderbuffers(n, r) wasm_gl_gen_renderbuffers(n, r)
+#define glBindRenderbuffer(t, r) wasm_gl_bind_renderbuffer(t, r)
+#define glDeleteRenderbuffers(n, r) wasm_gl_delete_renderbuffers(n, r)
+#define glRenderbufferStorage(t, f, w, h) wasm_gl_renderbuffer_storage(t, f, w, h)
 
 // Uniform macros
 #define glUniform1f(l, v) wasm_gl_uniform1f(l, v)
@@ -378,11 +650,172 @@ void wasm_gl_disable(GLenum cap);
 #define glBindTexture(tg, t) wasm_gl_bind_texture(tg, t)
 #define glDeleteTextures(n, t) wasm_gl_delete_textures(n, t)
 #define glTexImage2D(tg, l, i, w, h, b, f, ty, d) wasm_gl_tex_image_2d(tg, l, i, w, h, b, f, ty, d)
+#define glTexSubImage2D(tg, l, x, y, w, h, f, ty, d) wasm_gl_tex_sub_image_2d(tg, l, x, y, w, h, f, ty, d)
+#define glPixelStorei(p, v) wasm_gl_pixel_storei(p, v)
+#define glCompressedTexImage2D(tg, l, i, w, h, b, s, d) wasm_gl_compressed_tex_image_2d(tg, l, i, w, h, b, s, d)
+#define glCompressedTexSubImage2D(tg, l, x, y, w, h, f, s, d) wasm_gl_compressed_tex_sub_image_2d(tg, l, x, y, w, h, f, s, d)
+#define glGenerateMipmap(tg) wasm_gl_generate_mipmap(tg)
+#define glReadPixels(x, y, w, h, f, ty, d) wasm_gl_read_pixels(x, y, w, h, f, ty, d)
 #define glTexParameteri(tg, p, v) wasm_gl_tex_parameteri(tg, p, v)
 #define glTexParameterf(tg, p, v) wasm_gl_tex_parameterf(tg, p, v)
 #define glActiveTexture(t) wasm_gl_active_texture(t)
 #define glEnable(c) wasm_gl_enable(c)
 #define glDisable(c) wasm_gl_disable(c)
+#define glGetIntegerv(p, v) wasm_gl_get_integerv(p, v)
+
+// Streaming buffer helper
+//
+// For per-frame dynamic data (particles, UI vertices, ...): instead of reallocating a buffer with glBufferData every
+// frame, sub-allocate from one large GL buffer used as a ring. The ring is mirrored by a staging area in Wasm memory
+// that the caller writes into directly; the host uploads straight from it (zero-copy). The ring is split into
+// WASM_GL_STREAM_SEGMENTS segments, each fenced once it has been left, so reusing a segment only waits if the host
+// has not caught up with it yet (that is, if the application is a whole ring ahead).
+//
+//   void* data = wasm_gl_stream_map(&stream, size, &offset);
+//   ... write at most size bytes to data ...
+//   wasm_gl_stream_unmap(&stream);  // Binds stream.buffer to stream.target
+//   glVertexAttribPointer(..., (void*)offset);
+#define WASM_GL_STREAM_SEGMENTS 4
+#define WASM_GL_STREAM_ALIGNMENT 16
+
+typedef struct {
+    GLenum target;
+    GLuint buffer;
+    GLsizeiptr size;          // Ring size in bytes (a multiple of WASM_GL_STREAM_SEGMENTS * WASM_GL_STREAM_ALIGNMENT)
+    GLsizeiptr head;          // Next free byte
+    int segment;              // First segment that has been written to but not fenced yet
+    unsigned char* staging;   // Wasm memory mirror of the ring
+    GLintptr map_offset;      // Range handed out by the last wasm_gl_stream_map()
+    GLsizeiptr map_size;
+    GLsync fences[WASM_GL_STREAM_SEGMENTS];
+} WasmGLStreamBuffer;
+
+// Create a streaming buffer of (at least) size bytes for target. Returns 0 on success.
+static inline int wasm_gl_stream_init(WasmGLStreamBuffer* stream, GLenum target, GLsizeiptr size) {
+    const GLsizeiptr granularity = WASM_GL_STREAM_SEGMENTS * WASM_GL_STREAM_ALIGNMENT;
+    memset(stream, 0, sizeof(*stream));
+    stream->target = target;
+    stream->size = (size + granularity - 1) / granularity * granularity;
+    stream->staging = (unsigned char*)malloc(stream->size);
+    if (!stream->staging) {
+        return -1;
+    }
+
+    wasm_gl_gen_buffers(1, &stream->buffer);
+    wasm_gl_bind_buffer(target, stream->buffer);
+    wasm_gl_buffer_data(target, stream->size, NULL, GL_STREAM_DRAW);
+    return 0;
+}
+
+// Block until the host has executed everything before sync. Should the fence fail (GL_WAIT_FAILED), fall back to
+// wasm_gl_finish(), which waits for everything issued so far.
+static inline void wasm_gl_stream_wait(GLsync sync) {
+    GLenum status;
+    do {
+        status = wasm_gl_client_wait_sync(sync, 0, GL_TIMEOUT_IGNORED);
+    } while (status == GL_TIMEOUT_EXPIRED);
+
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        wasm_gl_finish();
+    }
+}
+
+// Reserve size bytes (at most a segment, size / WASM_GL_STREAM_SEGMENTS) and return where to write them, or NULL if
+// size is too large. *offset receives the offset of the range in the GL buffer. Must be followed by
+// wasm_gl_stream_unmap() before the next wasm_gl_stream_map().
+static inline void* wasm_gl_stream_map(WasmGLStreamBuffer* stream, GLsizeiptr size, GLintptr* offset) {
+    const GLsizeiptr segment_size = stream->size / WASM_GL_STREAM_SEGMENTS;
+    if (size <= 0 || size > segment_size) {
+        return NULL;
+    }
+
+    GLintptr start = (stream->head + WASM_GL_STREAM_ALIGNMENT - 1) & ~(GLintptr)(WASM_GL_STREAM_ALIGNMENT - 1);
+    if (start + size > stream->size) {
+        start = 0;
+    }
+
+    // Wait until the host is done with the previous contents of every segment we are about to enter. The segment we
+    // are in is ours already (it is only fenced once we leave it).
+    int last = (int)((start + size - 1) / segment_size);
+    for (int s = stream->segment; s != last; ) {
+        s = (s + 1) % WASM_GL_STREAM_SEGMENTS;
+        if (stream->fences[s]) {
+            wasm_gl_stream_wait(stream->fences[s]);
+            wasm_gl_delete_sync(stream->fences[s]);
+            stream->fences[s] = 0;
+        }
+    }
+
+    stream->map_offset = start;
+    stream->map_size = size;
+    stream->head = start + size;
+    *offset = start;
+    return stream->staging + start;
+}
+
+// Upload the range returned by the last wasm_gl_stream_map() and fence the segments left behind.
+static inline void wasm_gl_stream_unmap(WasmGLStreamBuffer* stream) {
+    const GLsizeiptr segment_size = stream->size / WASM_GL_STREAM_SEGMENTS;
+    wasm_gl_bind_buffer(stream->target, stream->buffer);
+    wasm_gl_buffer_sub_data_unsynchronized(stream->target, stream->map_offset, stream->map_size,
+                                           stream->staging + stream->map_offset);
+
+    int current = (int)((stream->head - 1) / segment_size);
+    while (stream->segment != current) {
+        stream->fences[stream->segment] = wasm_gl_fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        stream->segment = (stream->segment + 1) % WASM_GL_STREAM_SEGMENTS;
+    }
+}
+
+// Wait for all uploads, then free the staging area and delete the buffer.
+static inline void wasm_gl_stream_destroy(WasmGLStreamBuffer* stream) {
+    GLsync sync = wasm_gl_fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    wasm_gl_stream_wait(sync);
+    wasm_gl_delete_sync(sync);
+    for (int s = 0; s < WASM_GL_STREAM_SEGMENTS; s++) {
+        if (stream->fences[s]) {
+            wasm_gl_delete_sync(stream->fences[s]);
+        }
+    }
+
+    wasm_gl_delete_buffers(1, &stream->buffer);
+    free(stream->staging);
+    memset(stream, 0, sizeof(*stream));
+}
+
+// Whether a program has finished linking, asked without waiting for it (GL_COMPLETION_STATUS_KHR). Shaders are
+// compiled and linked in the background where the browser supports it, so a program can link all its shaders up front
+// and keep drawing (a loading screen, say) until they are ready, instead of stalling in glGetProgramiv(GL_LINK_STATUS).
+// Programs linked before from the same sources, e.g. by an earlier run of the program, are ready right away. Answered
+// from a word that the host updates as links complete, so it is cheap enough to call every frame.
+__attribute__((import_module("env"), import_name("wasm_gl_program_ready")))
+GLboolean wasm_gl_program_ready(GLuint program);
+
+// Whether a compressed texture format is supported, i.e. listed in GL_COMPRESSED_TEXTURE_FORMATS.
+static inline GLboolean wasm_gl_compressed_format_supported(GLenum format) {
+    GLint count = 0;
+    wasm_gl_get_integerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+    if (count <= 0) {
+        return GL_FALSE;
+    }
+    GLint* formats = (GLint*)malloc(count * sizeof(GLint));
+    GLboolean supported = GL_FALSE;
+    if (formats) {
+        wasm_gl_get_integerv(GL_COMPRESSED_TEXTURE_FORMATS, formats);
+        for (GLint i = 0; i < count; i++) {
+            if ((GLenum)formats[i] == format) {
+                supported = GL_TRUE;
+            }
+        }
+        free(formats);
+    }
+    return supported;
+}
+
+// Whether an asynchronous readback (wasm_gl_read_pixels_async()) has landed in memory, without waiting for it.
+static inline GLboolean wasm_gl_read_pixels_ready(const GLint* done) {
+    return __atomic_load_n(done, __ATOMIC_ACQUIRE) ? GL_TRUE : GL_FALSE;
+}
 
 // Initialization helper function
 static inline int graphics_initialize(EGLDisplay *out_display, EGLSurface *out_surface, EGLContext *out_context) {
@@ -0,0 +1,238 @@
+#!/usr/bin/env node
+// SPDX-License-Identifier: GPL-2.0-only
+//
+// Replay GL traces (recorded with wasm_gl_capture_begin/end, see wasm-graphics.h) headless on the software renderer
+// (runtime/linux-softgl.js), without a GPU or a browser. Reports frame times and draw-call and upload throughput, and
+// optionally writes the rendered frames as PNG files or compares them with golden images.
+//
+// Usage: tools/gl-replay.js [options] <trace.gltrace>...
+//
+//   --width N, --height N  Size of the canvas (default 800x600, as in index.html).
+//   --every N              Dump/compare every Nth frame (default 60), counting from the first.
+//   --dump DIR             Write frames to DIR/<trace>/frame-NNNN.png (use to create or update golden images).
+//   --golden DIR           Compare frames with DIR/<trace>/frame-NNNN.png, exit with 1 on any mismatch.
+//   --tolerance N          Largest difference per color channel (0-255) that still counts as a match (default 2).
+//   --relaunch             Replay each trace a second time, as its program started again, and exit with 1 unless the
+//                          second run compiles no shaders and links no programs (they are all in the program cache).
+//                          Its frames are not compared: uniform locations in a trace are those of the captured run.
+
+"use strict";
+
+const fs = require("fs");
+const path = require("path");
+const vm = require("vm");
+const zlib = require("zlib");
+
+const runtime = path.join(__dirname, "..", "runtime");
+for (const script of ["linux-graphics.js", "linux-softgl.js", "linux-gl-replay.js"]) {
+  vm.runInThisContext(fs.readFileSync(path.join(runtime, script), "utf8"), { filename: script });
+}
+
+const options = {
+  width: 800, height: 600, every: 60, dump: null, golden: null, tolerance: 2, relaunch: false, traces: [],
+};
+for (let i = 2; i < process.argv.length; i++) {
+  const arg = process.argv[i];
+  const value = () => {
+    if (i + 1 >= process.argv.length) throw new Error(arg + " needs a value");
+    return process.argv[++i];
+  };
+  switch (arg) {
+    case "--width": options.width = parseInt(value(), 10); break;
+    case "--height": options.height = parseInt(value(), 10); break;
+    case "--every": options.every = Math.max(1, parseInt(value(), 10)); break;
+    case "--dump": options.dump = value(); break;
+    case "--golden": options.golden = value(); break;
+    case "--tolerance": options.tolerance = parseInt(value(), 10); break;
+    case "--relaunch": options.relaunch = true; break;
+    default:
+      if (arg.startsWith("--")) {
+        console.error("Unknown option " + arg);
+        process.exit(2);
+      }
+      options.traces.push(arg);
+  }
+}
+if (options.traces.length == 0) {
+  console.error("Usage: " + path.basename(process.argv[1]) + " [options] <trace.gltrace>...");
+  process.exit(2);
+}
+
+const crc_table = Array.from({ length: 256 }, (_, n) => {
+  let c = n;
+  for (let k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >>> 1) : c >>> 1;
+  return c >>> 0;
+});
+
+const crc32 = (bytes) => {
+  let crc = 0xFFFFFFFF;
+  for (const byte of bytes) crc = crc_table[(crc ^ byte) & 0xFF] ^ (crc >>> 8);
+  return (crc ^ 0xFFFFFFFF) >>> 0;
+};
+
+/// Encode top-down RGBA rows (a Buffer) as a PNG (8-bit RGBA, no filtering).
+const png_encode = (width, height, rgba) => {
+  const raw = Buffer.alloc((width * 4 + 1) * height);
+  for (let y = 0; y < height; y++) {
+    rgba.copy(raw, y * (width * 4 + 1) + 1, y * width * 4, (y + 1) * width * 4);
+  }
+  const chunk = (type, data) => {
+    const body = Buffer.concat([Buffer.from(type, "latin1"), data]);
+    const length = Buffer.alloc(4);
+    length.writeUInt32BE(data.length);
+    const crc = Buffer.alloc(4);
+    crc.writeUInt32BE(crc32(body));
+    return Buffer.concat([length, body, crc]);
+  };
+  const header = Buffer.alloc(13);
+  header.writeUInt32BE(width, 0);
+  header.writeUInt32BE(height, 4);
+  header.set([8, 6, 0, 0, 0], 8);  // 8 bits, RGBA, deflate, adaptive filters, no interlace
+  return Buffer.concat([
+    Buffer.from([0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A]),
+    chunk("IHDR", header),
+    chunk("IDAT", zlib.deflateSync(raw)),
+    chunk("IEND", Buffer.alloc(0)),
+  ]);
+};
+
+/// Decode an 8-bit RGBA PNG (as written by png_encode, or by image tools that keep that format) to top-down rows.
+const png_decode = (file) => {
+  let pos = 8;
+  let width = 0;
+  let height = 0;
+  const data = [];
+  while (pos < file.length) {
+    const length = file.readUInt32BE(pos);
+    const type = file.toString("latin1", pos + 4, pos + 8);
+    const body = file.subarray(pos + 8, pos + 8 + length);
+    if (type == "IHDR") {
+      width = body.readUInt32BE(0);
+      height = body.readUInt32BE(4);
+      if (body[8] != 8 || body[9] != 6 || body[12] != 0) throw new Error("only 8-bit RGBA PNGs are supported");
+    } else if (type == "IDAT") {
+      data.push(body);
+    }
+    pos += 12 + length;
+  }
+
+  const raw = zlib.inflateSync(Buffer.concat(data));
+  const stride = width * 4;
+  const rgba = Buffer.alloc(stride * height);
+  for (let y = 0; y < height; y++) {
+    const filter = raw[y * (stride + 1)];
+    const line = raw.subarray(y * (stride + 1) + 1, (y + 1) * (stride + 1));
+    for (let x = 0; x < stride; x++) {
+      const a = x >= 4 ? rgba[y * stride + x - 4] : 0;
+      const b = y > 0 ? rgba[(y - 1) * stride + x] : 0;
+      const c = x >= 4 && y > 0 ? rgba[(y - 1) * stride + x - 4] : 0;
+      let predictor = 0;
+      switch (filter) {
+        case 1: predictor = a; break;
+        case 2: predictor = b; break;
+        case 3: predictor = (a + b) >> 1; break;
+        case 4: {
+          const p = a + b - c;
+          const pa = Math.abs(p - a);
+          const pb = Math.abs(p - b);
+          const pc = Math.abs(p - c);
+          predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+          break;
+        }
+      }
+      rgba[y * stride + x] = (line[x] + predictor) & 0xFF;
+    }
+  }
+  return { width: width, height: height, rgba: rgba };
+};
+
+/// Read the framebuffer as top-down RGBA rows (GL rows are bottom-up).
+const read_frame = (gl, width, height) => {
+  const pixels = new Uint8Array(width * height * 4);
+  gl.readPixels(0, 0, width, height, gl.RGBA, gl.UNSIGNED_BYTE, pixels);
+  const rgba = Buffer.alloc(pixels.length);
+  for (let y = 0; y < height; y++) {
+    rgba.set(pixels.subarray((height - 1 - y) * width * 4, (height - y) * width * 4), y * width * 4);
+  }
+  return rgba;
+};
+
+const main = async () => {
+  let failed = false;
+  for (const file of options.traces) {
+    const name = path.basename(file, ".gltrace");
+    const bytes = fs.readFileSync(file);
+    const trace = gl_trace_parse(bytes.buffer.slice(bytes.byteOffset, bytes.byteOffset + bytes.byteLength));
+    console.log("Replaying " + file + " (" + trace.records.length + " records)");
+
+    let compared = 0;
+    let mismatched = 0;
+    const on_frame = (index, gl) => {
+      if (!gl || index % options.every != 0) return;
+      const rgba = read_frame(gl, options.width, options.height);
+      const frame = "frame-" + String(index).padStart(4, "0") + ".png";
+
+      if (options.dump) {
+        fs.mkdirSync(path.join(options.dump, name), { recursive: true });
+        fs.writeFileSync(path.join(options.dump, name, frame), png_encode(options.width, options.height, rgba));
+      }
+      if (options.golden) {
+        const golden_file = path.join(options.golden, name, frame);
+        compared++;
+        if (!fs.existsSync(golden_file)) {
+          console.log("  " + frame + ": no golden image " + golden_file);
+          mismatched++;
+          return;
+        }
+        const golden = png_decode(fs.readFileSync(golden_file));
+        if (golden.width != options.width || golden.height != options.height) {
+          console.log("  " + frame + ": golden image is " + golden.width + "x" + golden.height);
+          mismatched++;
+          return;
+        }
+        let differing = 0;
+        let largest = 0;
+        for (let i = 0; i < rgba.length; i += 4) {
+          let difference = 0;
+          for (let c = 0; c < 4; c++) difference = Math.max(difference, Math.abs(rgba[i + c] - golden.rgba[i + c]));
+          largest = Math.max(largest, difference);
+          if (difference > options.tolerance) differing++;
+        }
+        if (differing) {
+          console.log("  " + frame + ": " + differing + " pixels differ (by up to " + largest + ")");
+          mismatched++;
+        }
+      }
+    };
+
+    const canvas = { width: options.width, height: options.height };
+    const host = gl_trace_host(canvas, { backend: "software" }, (text) => { });
+    const result = await gl_trace_replay(trace, canvas, { host: host, on_frame: on_frame }, (text) => { });
+    console.log(gl_trace_report(result));
+    if (options.golden) {
+      console.log("Golden images: " + (compared - mismatched) + " of " + compared + " frames match");
+      failed = failed || mismatched > 0 || compared == 0;
+    }
+
+    if (options.relaunch && host.graphics.gl) {
+      const gl = host.graphics.gl;
+      const counts = { compiles: 0, links: 0 };
+      const compile_shader = gl.compileShader;
+      const link_program = gl.linkProgram;
+      gl.compileShader = function (shader) { counts.compiles++; return compile_shader.call(this, shader); };
+      gl.linkProgram = function (program) { counts.links++; return link_program.call(this, program); };
+      await gl_trace_replay(trace, canvas, { host: host }, (text) => { });
+      gl.compileShader = compile_shader;
+      gl.linkProgram = link_program;
+      console.log("Relaunch: " + counts.compiles + " shader compiles, " + counts.links + " program links");
+      failed = failed || counts.compiles > 0 || counts.links > 0;
+    }
+  }
+  return failed ? 1 : 0;
+};
+
+// Exit explicitly: the graphics host keeps a display refresh timer going.
+main().then((code) => process.exit(code), (error) => {
+  console.error(error);
+  process.exit(1);
+});